@@ -0,0 +1,97 @@
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/vm.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Tunable from the environment:
+//   BENCH_MAX_THREADS  thread counts run are 1, 2, 4, ... up to this
+//   BENCH_ALLOCS       objects allocated per run, split between threads
+#define DEFAULT_MAX_THREADS 64
+#define DEFAULT_ALLOCS 2000000
+#define MAX_THREADS 1024
+
+typedef struct Worker {
+  vm_mutator_t *mutator;
+  pthread_barrier_t *start;
+  size_t allocs;
+} worker_t;
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void *worker_run(void *arg) {
+  worker_t *worker = arg;
+  vm_mutator_attach(worker->mutator);
+  vm_t *vm = worker->mutator->vm;
+  pthread_barrier_wait(worker->start);
+  for (size_t i = 0; i < worker->allocs; i++) {
+    new_snek_integer((int)i, vm);
+  }
+  vm_mutator_free(worker->mutator);
+  return NULL;
+}
+
+// Seconds for `threads` threads to allocate `allocs` objects between them
+static double run_threads(int threads, size_t allocs) {
+  vm_t *vm = vm_new();
+  pthread_barrier_t start;
+  pthread_barrier_init(&start, NULL, threads + 1);
+  pthread_t ids[MAX_THREADS];
+  worker_t workers[MAX_THREADS];
+  for (int i = 0; i < threads; i++) {
+    workers[i] = (worker_t){.mutator = vm_mutator_new(vm),
+                            .start = &start,
+                            .allocs = allocs / threads};
+    pthread_create(&ids[i], NULL, worker_run, &workers[i]);
+  }
+
+  // The main thread only waits, it must not hold up a safepoint
+  vm_blocking_enter(vm);
+  pthread_barrier_wait(&start);
+  double begin = now_s();
+  for (int i = 0; i < threads; i++) {
+    pthread_join(ids[i], NULL);
+  }
+  double seconds = now_s() - begin;
+  vm_blocking_leave(vm);
+
+  pthread_barrier_destroy(&start);
+  vm_free(vm);
+  return seconds;
+}
+
+int main(void) {
+  const char *max_env = getenv("BENCH_MAX_THREADS");
+  const char *allocs_env = getenv("BENCH_ALLOCS");
+  int max_threads = max_env ? atoi(max_env) : DEFAULT_MAX_THREADS;
+  size_t allocs = allocs_env ? (size_t)atol(allocs_env) : DEFAULT_ALLOCS;
+  if (max_threads < 1 || max_threads > MAX_THREADS || allocs == 0) {
+    fprintf(stderr, "BENCH_MAX_THREADS must be 1..%d, BENCH_ALLOCS > 0\n",
+            MAX_THREADS);
+    return 1;
+  }
+
+  double single_rate = 0.0;
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    size_t total = allocs / threads * threads;
+    double seconds = run_threads(threads, allocs);
+    double rate = total / seconds;
+    if (threads == 1) {
+      single_rate = rate;
+    }
+    printf("{\"bench\": \"alloc_threads\", \"threads\": %d, "
+           "\"allocations\": %zu, \"seconds\": %.3f, "
+           "\"allocations_per_s\": %.0f, \"speedup\": %.2f, "
+           "\"register_batch\": %d}\n",
+           threads, total, seconds, rate, rate / single_rate,
+           VM_REGISTER_BATCH);
+    fflush(stdout);
+  }
+  return 0;
+}
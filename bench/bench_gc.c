@@ -0,0 +1,230 @@
+#include "../src/bootmem.h"
+#include "../src/gcstats.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Collections start once the heap holds this many objects, and after that
+// whenever it has doubled since the last one
+#define GC_MIN_OBJECTS 100000
+
+#define TREE_MAX_DEPTH 16
+#define TREE_MIN_DEPTH 4
+#define LIST_LENGTH 200000
+#define LIST_ROUNDS 10
+#define VECTOR_ITERATIONS 2000000
+#define STRING_PIECES 50000
+#define CACHE_SIZE 100000
+#define CACHE_ITERATIONS 2000000
+// One young allocation in this many replaces a cache entry
+#define CACHE_REPLACE_EVERY 64
+
+typedef struct Bench {
+  const char *name;
+  vm_t *vm;
+  frame_t *frame;
+  // Single element array the workload keeps its current value in, so
+  // it stays rooted while the value changes
+  snek_object_t *root;
+  size_t next_gc;
+  uint64_t allocations;
+  double start;
+  // Workload specific result, printed so the work can't be optimized out
+  long long check;
+} bench_t;
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t objects_allocated(void) {
+  boot_mem_stats_t stats;
+  boot_mem_stats(BOOT_CATEGORY_OBJECT, &stats);
+  return stats.allocations;
+}
+
+static void bench_start(bench_t *bench, const char *name) {
+  bench->name = name;
+  bench->vm = vm_new();
+  vm_gc_stats_enable(bench->vm, true);
+  bench->frame = vm_new_frame(bench->vm);
+  bench->root = new_snek_array(1, bench->vm);
+  frame_reference_object(bench->frame, bench->root);
+  bench->next_gc = GC_MIN_OBJECTS;
+  bench->check = 0;
+  bench->allocations = objects_allocated();
+  bench->start = now_s();
+}
+
+// Called where everything live is reachable from the frame. Collects the
+// way an allocation-paced collector would.
+static void bench_safepoint(bench_t *bench) {
+  vm_t *vm = bench->vm;
+  if (registry_count(vm->objects) < bench->next_gc) {
+    return;
+  }
+  vm_collect_garbage(vm);
+  size_t next = registry_count(vm->objects) * 2;
+  bench->next_gc = next > GC_MIN_OBJECTS ? next : GC_MIN_OBJECTS;
+}
+
+static void bench_finish(bench_t *bench) {
+  double seconds = now_s() - bench->start;
+  uint64_t allocations = objects_allocated() - bench->allocations;
+  gc_stats_t stats;
+  vm_gc_stats(bench->vm, &stats);
+
+  printf("{\"bench\": \"%s\", \"seconds\": %.3f, \"allocations\": %llu, "
+         "\"allocations_per_s\": %.0f, \"collections\": %llu, "
+         "\"gc_ms\": %.3f, \"gc_fraction\": %.4f, \"max_pause_ms\": %.3f, "
+         "\"p99_pause_ms\": %.3f, \"check\": %lld}\n",
+         bench->name, seconds, (unsigned long long)allocations,
+         allocations / seconds, (unsigned long long)stats.collections,
+         stats.pause_total_ns / 1e6, stats.pause_total_ns / 1e9 / seconds,
+         stats.pause_max_ns / 1e6, stats.pause_p99_ns / 1e6, bench->check);
+  fflush(stdout);
+  vm_free(bench->vm);
+}
+
+// Binary trees: nodes are 2 element arrays, leaves are empty arrays
+static snek_object_t *tree_new(int depth, vm_t *vm) {
+  if (depth == 0) {
+    return new_snek_array(0, vm);
+  }
+  snek_object_t *node = new_snek_array(2, vm);
+  snek_array_set(node, 0, tree_new(depth - 1, vm));
+  snek_array_set(node, 1, tree_new(depth - 1, vm));
+  return node;
+}
+
+static long long tree_count(snek_object_t *node) {
+  if (node->data.v_array.size == 0) {
+    return 1;
+  }
+  return 1 + tree_count(snek_array_get(node, 0)) +
+         tree_count(snek_array_get(node, 1));
+}
+
+static void bench_binary_trees(void) {
+  bench_t bench;
+  bench_start(&bench, "binary_trees");
+
+  snek_object_t *long_lived = tree_new(TREE_MAX_DEPTH, bench.vm);
+  frame_reference_object(bench.frame, long_lived);
+  for (int depth = TREE_MIN_DEPTH; depth <= TREE_MAX_DEPTH; depth += 2) {
+    int iterations = 1 << (TREE_MAX_DEPTH - depth + TREE_MIN_DEPTH);
+    for (int i = 0; i < iterations; i++) {
+      snek_object_t *tree = tree_new(depth, bench.vm);
+      snek_array_set(bench.root, 0, tree);
+      bench.check += tree_count(tree);
+      bench_safepoint(&bench);
+    }
+  }
+  bench.check += tree_count(long_lived);
+  bench_finish(&bench);
+}
+
+// Linked list of [value, next] arrays, rebuilt from scratch each round
+static void bench_linked_list(void) {
+  bench_t bench;
+  bench_start(&bench, "linked_list");
+
+  for (int round = 0; round < LIST_ROUNDS; round++) {
+    snek_object_t *head = new_snek_array(0, bench.vm);
+    for (int i = 0; i < LIST_LENGTH; i++) {
+      snek_object_t *node = new_snek_array(2, bench.vm);
+      snek_array_set(node, 0, new_snek_integer(i, bench.vm));
+      snek_array_set(node, 1, head);
+      head = node;
+      snek_array_set(bench.root, 0, head);
+      bench_safepoint(&bench);
+    }
+    for (snek_object_t *node = head; node->data.v_array.size == 2;
+         node = snek_array_get(node, 1)) {
+      bench.check += snek_array_get(node, 0)->data.v_int;
+    }
+  }
+  bench_finish(&bench);
+}
+
+// Short-lived boxed vector3s summed into one accumulator
+static void bench_vector3_churn(void) {
+  bench_t bench;
+  bench_start(&bench, "vector3_churn");
+  vm_t *vm = bench.vm;
+
+  snek_object_t *zero = new_snek_integer(0, vm);
+  snek_object_t *sum = new_snek_vector3(zero, zero, zero, vm);
+  snek_array_set(bench.root, 0, sum);
+  for (int i = 0; i < VECTOR_ITERATIONS; i++) {
+    snek_object_t *step =
+        new_snek_vector3(new_snek_integer(1, vm), new_snek_integer(i & 7, vm),
+                         new_snek_integer(-1, vm), vm);
+    sum = snek_add(sum, step, vm);
+    snek_array_set(bench.root, 0, sum);
+    bench_safepoint(&bench);
+  }
+  bench.check = sum->data.v_vector3.y->data.v_int;
+  bench_finish(&bench);
+}
+
+// One large string grown by appending short pieces, read back at the end
+static void bench_string_concat(void) {
+  bench_t bench;
+  bench_start(&bench, "string_concat");
+  vm_t *vm = bench.vm;
+
+  static const char *pieces[] = {"alpha ", "beta ", "gamma delta ",
+                                 "a longer piece of text for the rope "};
+  snek_object_t *text = new_snek_string("", vm);
+  snek_array_set(bench.root, 0, text);
+  for (int i = 0; i < STRING_PIECES; i++) {
+    text = snek_add(text, new_snek_string((char *)pieces[i & 3], vm), vm);
+    snek_array_set(bench.root, 0, text);
+    bench_safepoint(&bench);
+  }
+  bench.check = (long long)snek_string_hash(text) & 0xffff;
+  bench_finish(&bench);
+}
+
+// Long-lived cache of boxed values, occasionally replaced, under a steady
+// stream of garbage
+static void bench_cache(void) {
+  bench_t bench;
+  bench_start(&bench, "cache_young_churn");
+  vm_t *vm = bench.vm;
+
+  snek_object_t *cache = new_snek_array(CACHE_SIZE, vm);
+  frame_reference_object(bench.frame, cache);
+  for (int i = 0; i < CACHE_SIZE; i++) {
+    snek_array_set(cache, i, new_snek_integer(i, vm));
+  }
+
+  unsigned seed = 12345;
+  for (int i = 0; i < CACHE_ITERATIONS; i++) {
+    seed = seed * 1103515245u + 12345u;
+    snek_object_t *young = new_snek_integer((int)(seed >> 16), vm);
+    snek_object_t *hit = snek_array_get(cache, seed % CACHE_SIZE);
+    snek_object_t *sum = snek_add(hit, young, vm);
+    if (i % CACHE_REPLACE_EVERY == 0) {
+      snek_array_set(cache, (seed >> 8) % CACHE_SIZE, sum);
+    }
+    bench.check += sum->data.v_int & 1;
+    bench_safepoint(&bench);
+  }
+  bench_finish(&bench);
+}
+
+int main(void) {
+  bench_binary_trees();
+  bench_linked_list();
+  bench_vector3_churn();
+  bench_string_concat();
+  bench_cache();
+  return 0;
+}
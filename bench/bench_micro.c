@@ -0,0 +1,239 @@
+#define _GNU_SOURCE
+#include "../src/bootmem.h"
+#include "../src/registry.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/stack.h"
+#include "../src/vm.h"
+#include <math.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Tunable from the environment, e.g. BENCH_CPU=2 BENCH_REPS=21 make bench
+#define DEFAULT_WARMUP 2
+#define DEFAULT_REPS 9
+#define MAX_REPS 101
+
+#define ALLOC_OPS 1000000
+#define TRACE_OPS 1000000
+#define SWEEP_OPS 1000000
+#define PUSH_OPS 10000000
+#define REGISTRY_ENTRIES 10000000
+// One registry slot in this many is NULL when stack_remove_nulls runs
+#define REGISTRY_NULL_EVERY 4
+
+// Only `run` is timed. `setup` builds fresh state for every repetition so
+// runs that consume their input (sweep, remove_nulls) measure the same work.
+typedef struct MicroBench {
+  const char *name;
+  size_t ops;
+  void *(*setup)(size_t ops);
+  void (*run)(void *state, size_t ops);
+  void (*teardown)(void *state);
+} micro_bench_t;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int env_int(const char *name, int fallback) {
+  const char *value = getenv(name);
+  return value != NULL && *value != '\0' ? atoi(value) : fallback;
+}
+
+static int compare_doubles(const void *a, const void *b) {
+  double left = *(const double *)a;
+  double right = *(const double *)b;
+  return left < right ? -1 : left > right;
+}
+
+static void micro_run(micro_bench_t *bench, int warmup, int reps, int cpu) {
+  double samples[MAX_REPS];
+  for (int i = -warmup; i < reps; i++) {
+    void *state = bench->setup(bench->ops);
+    uint64_t start = now_ns();
+    bench->run(state, bench->ops);
+    uint64_t elapsed = now_ns() - start;
+    bench->teardown(state);
+    if (i >= 0) {
+      samples[i] = (double)elapsed / bench->ops;
+    }
+  }
+
+  double mean = 0.0;
+  for (int i = 0; i < reps; i++) {
+    mean += samples[i];
+  }
+  mean /= reps;
+  double variance = 0.0;
+  for (int i = 0; i < reps; i++) {
+    variance += (samples[i] - mean) * (samples[i] - mean);
+  }
+  double stddev = reps > 1 ? sqrt(variance / (reps - 1)) : 0.0;
+  qsort(samples, reps, sizeof(double), compare_doubles);
+  double median = reps % 2 ? samples[reps / 2]
+                           : (samples[reps / 2 - 1] + samples[reps / 2]) / 2;
+
+  printf("{\"bench\": \"micro/%s\", \"ops\": %zu, \"reps\": %d, "
+         "\"median_ns\": %.3f, \"mean_ns\": %.3f, \"stddev_ns\": %.3f, "
+         "\"min_ns\": %.3f, \"max_ns\": %.3f, \"cpu\": %d}\n",
+         bench->name, bench->ops, reps, median, mean, stddev, samples[0],
+         samples[reps - 1], cpu);
+  fflush(stdout);
+}
+
+// new_snek_integer, ns per object
+
+static void *alloc_setup(size_t ops) {
+  (void)ops;
+  // Registry segments are fixed size, appends never copy old entries
+  return vm_new();
+}
+
+static void alloc_run(void *state, size_t ops) {
+  vm_t *vm = state;
+  for (size_t i = 0; i < ops; i++) {
+    new_snek_integer((int)i, vm);
+  }
+}
+
+static void vm_teardown(void *state) { vm_free(state); }
+
+// trace(), ns per object reached from one rooted array
+
+static void *trace_setup(size_t ops) {
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *array = new_snek_array(ops, vm);
+  for (size_t i = 0; i < ops; i++) {
+    snek_array_set(array, i, new_snek_integer((int)i, vm));
+  }
+  frame_reference_object(frame, array);
+  mark(vm);
+  return vm;
+}
+
+static void trace_run(void *state, size_t ops) {
+  (void)ops;
+  trace(state);
+}
+
+// sweep(), ns per freed object, nothing survives
+
+static void *sweep_setup(size_t ops) {
+  vm_t *vm = vm_new();
+  for (size_t i = 0; i < ops; i++) {
+    new_snek_integer((int)i, vm);
+  }
+  return vm;
+}
+
+static void sweep_run(void *state, size_t ops) {
+  (void)ops;
+  sweep(state);
+}
+
+// stack_push from capacity 1, so the cost includes every doubling
+
+static void *push_setup(size_t ops) {
+  (void)ops;
+  return stack_new(1);
+}
+
+static void push_run(void *state, size_t ops) {
+  for (size_t i = 0; i < ops; i++) {
+    stack_push(state, (void *)(i + 1));
+  }
+}
+
+static void *push_presized_setup(size_t ops) { return stack_new(ops); }
+
+static void stack_teardown(void *state) { stack_free(state); }
+
+// stack_remove_nulls over a registry sized like a large heap, ns per slot
+
+static void *remove_nulls_setup(size_t ops) {
+  stack_t *stack = stack_new(ops);
+  for (size_t i = 0; i < ops; i++) {
+    stack->data[i] = i % REGISTRY_NULL_EVERY == 0 ? NULL : (void *)(i + 1);
+  }
+  stack->count = ops;
+  return stack;
+}
+
+static void remove_nulls_run(void *state, size_t ops) {
+  (void)ops;
+  stack_remove_nulls(state);
+}
+
+// registry_add, segments installed as the registry grows
+
+static void *registry_setup(size_t ops) {
+  (void)ops;
+  return registry_new();
+}
+
+static void registry_run(void *state, size_t ops) {
+  for (size_t i = 0; i < ops; i++) {
+    registry_add(state, (snek_object_t *)(i + 1));
+  }
+}
+
+static void registry_exclusive_run(void *state, size_t ops) {
+  for (size_t i = 0; i < ops; i++) {
+    registry_add_exclusive(state, (snek_object_t *)(i + 1));
+  }
+}
+
+static void registry_teardown(void *state) { registry_free(state); }
+
+static micro_bench_t benches[] = {
+    {"new_snek_integer", ALLOC_OPS, alloc_setup, alloc_run, vm_teardown},
+    {"trace_per_object", TRACE_OPS, trace_setup, trace_run, vm_teardown},
+    {"sweep_per_freed_object", SWEEP_OPS, sweep_setup, sweep_run,
+     vm_teardown},
+    {"stack_push_growing", PUSH_OPS, push_setup, push_run, stack_teardown},
+    {"stack_push_presized", PUSH_OPS, push_presized_setup, push_run,
+     stack_teardown},
+    {"registry_add", PUSH_OPS, registry_setup, registry_run,
+     registry_teardown},
+    {"registry_add_exclusive", PUSH_OPS, registry_setup,
+     registry_exclusive_run, registry_teardown},
+    {"stack_remove_nulls_10m", REGISTRY_ENTRIES, remove_nulls_setup,
+     remove_nulls_run, stack_teardown},
+};
+
+int main(int argc, char *argv[]) {
+  int warmup = env_int("BENCH_WARMUP", DEFAULT_WARMUP);
+  int reps = env_int("BENCH_REPS", DEFAULT_REPS);
+  int cpu = env_int("BENCH_CPU", -1);
+  if (reps < 1 || reps > MAX_REPS || warmup < 0) {
+    fprintf(stderr, "BENCH_REPS must be 1..%d, BENCH_WARMUP >= 0\n",
+            MAX_REPS);
+    return 1;
+  }
+
+  // Pinning keeps the scheduler from migrating the run between cores
+  if (cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      perror("sched_setaffinity");
+      return 1;
+    }
+  }
+
+  // Benchmarks whose name contains argv[1] only
+  for (size_t i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+    if (argc < 2 || strstr(benches[i].name, argv[1]) != NULL) {
+      micro_run(&benches[i], warmup, reps, cpu);
+    }
+  }
+  return 0;
+}
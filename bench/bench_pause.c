@@ -0,0 +1,194 @@
+#include "../src/bootmem.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Tunable from the environment:
+//   BENCH_LIVE_MB     comma separated live set sizes, 1 to 8192
+//   BENCH_ALLOC_RATE  objects allocated per second by the mutator
+//   BENCH_SECONDS     mutator run time per live set size
+#define DEFAULT_LIVE_MB "1,64"
+#define DEFAULT_ALLOC_RATE 2000000
+#define DEFAULT_SECONDS 2.0
+
+#define CHUNK_OBJECTS 1024
+// Allocations between pacing checks and safepoints
+#define BATCH 32
+// One allocation in this many replaces a live object, so the live set
+// ages at a steady rate without growing
+#define REPLACE_EVERY 16
+// Batches finishing this late against their schedule count as stalls
+#define STALL_NS 100000
+#define GC_MIN_OBJECTS 100000
+
+typedef struct Samples {
+  uint64_t *values;
+  size_t count;
+  size_t capacity;
+} samples_t;
+
+// A collector to compare. Incremental or concurrent collectors are added
+// here with the same contract: called at safepoints, returns once the
+// mutator may continue.
+typedef struct PauseMode {
+  const char *name;
+  void (*collect)(vm_t *vm);
+} pause_mode_t;
+
+static pause_mode_t modes[] = {
+    {"stop_the_world", vm_collect_garbage},
+};
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void samples_add(samples_t *samples, uint64_t value) {
+  if (samples->count == samples->capacity) {
+    samples->capacity = samples->capacity ? samples->capacity * 2 : 1024;
+    samples->values =
+        realloc(samples->values, samples->capacity * sizeof(uint64_t));
+  }
+  samples->values[samples->count++] = value;
+}
+
+static int compare_u64(const void *a, const void *b) {
+  uint64_t left = *(const uint64_t *)a;
+  uint64_t right = *(const uint64_t *)b;
+  return left < right ? -1 : left > right;
+}
+
+// Nearest rank on sorted samples, exact rather than bucketed
+static double percentile_ms(samples_t *samples, double q) {
+  if (samples->count == 0) {
+    return 0.0;
+  }
+  size_t rank = (size_t)(q * samples->count + 0.999999);
+  rank = rank < 1 ? 1 : rank > samples->count ? samples->count : rank;
+  return samples->values[rank - 1] / 1e6;
+}
+
+static snek_object_t *chunk_new(vm_t *vm) {
+  snek_object_t *chunk = new_snek_array(CHUNK_OBJECTS, vm);
+  for (int i = 0; i < CHUNK_OBJECTS; i++) {
+    snek_array_set(chunk, i, new_snek_integer(i, vm));
+  }
+  return chunk;
+}
+
+static void run_pause(pause_mode_t *mode, size_t live_mb, double rate,
+                      double seconds) {
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+
+  // Size the live set from what one chunk really costs, headers included
+  size_t before = boot_current_bytes();
+  snek_object_t *probe = chunk_new(vm);
+  size_t chunk_bytes = boot_current_bytes() - before;
+  size_t chunks = (live_mb * 1024 * 1024 + chunk_bytes - 1) / chunk_bytes;
+  snek_object_t *live = new_snek_array(chunks, vm);
+  frame_reference_object(frame, live);
+  snek_array_set(live, 0, probe);
+  for (size_t i = 1; i < chunks; i++) {
+    snek_array_set(live, i, chunk_new(vm));
+  }
+  vm_collect_garbage(vm);
+
+  samples_t pauses = {0};
+  samples_t stalls = {0};
+  size_t next_gc = registry_count(vm->objects) * 2 > GC_MIN_OBJECTS
+                       ? registry_count(vm->objects) * 2
+                       : GC_MIN_OBJECTS;
+  unsigned seed = 12345;
+  uint64_t allocated = 0;
+  uint64_t start = now_ns();
+  uint64_t end = start + (uint64_t)(seconds * 1e9);
+  uint64_t now = start;
+  while (now < end) {
+    // Latency is taken against when the batch was due, so a pause also
+    // counts against every batch it held up
+    uint64_t due = start + (uint64_t)(allocated / rate * 1e9);
+    while (now < due) {
+      now = now_ns();
+    }
+
+    for (int i = 0; i < BATCH; i++) {
+      seed = seed * 1103515245u + 12345u;
+      snek_object_t *young = new_snek_integer((int)(seed >> 8), vm);
+      if (seed % REPLACE_EVERY == 0) {
+        snek_object_t *chunk = snek_array_get(live, (seed >> 4) % chunks);
+        snek_array_set(chunk, (seed >> 16) % CHUNK_OBJECTS, young);
+      }
+    }
+    allocated += BATCH;
+
+    if (registry_count(vm->objects) >= next_gc) {
+      uint64_t pause_start = now_ns();
+      mode->collect(vm);
+      samples_add(&pauses, now_ns() - pause_start);
+      next_gc = registry_count(vm->objects) * 2 > GC_MIN_OBJECTS
+                    ? registry_count(vm->objects) * 2
+                    : GC_MIN_OBJECTS;
+    }
+
+    now = now_ns();
+    if (now - due > STALL_NS) {
+      samples_add(&stalls, now - due);
+    }
+  }
+  double elapsed = (now - start) / 1e9;
+
+  qsort(pauses.values, pauses.count, sizeof(uint64_t), compare_u64);
+  qsort(stalls.values, stalls.count, sizeof(uint64_t), compare_u64);
+  printf("{\"bench\": \"pause\", \"mode\": \"%s\", \"live_mb\": %zu, "
+         "\"live_objects\": %zu, \"seconds\": %.3f, "
+         "\"target_alloc_per_s\": %.0f, \"alloc_per_s\": %.0f, "
+         "\"collections\": %zu, \"pause_p50_ms\": %.3f, "
+         "\"pause_p99_ms\": %.3f, \"pause_p999_ms\": %.3f, "
+         "\"pause_max_ms\": %.3f, \"stalls\": %zu, \"stall_p50_ms\": %.3f, "
+         "\"stall_p99_ms\": %.3f, \"stall_max_ms\": %.3f}\n",
+         mode->name, live_mb, chunks * (CHUNK_OBJECTS + 1) + 1, elapsed,
+         rate, allocated / elapsed, pauses.count,
+         percentile_ms(&pauses, 0.50), percentile_ms(&pauses, 0.99),
+         percentile_ms(&pauses, 0.999), percentile_ms(&pauses, 1.0),
+         stalls.count, percentile_ms(&stalls, 0.50),
+         percentile_ms(&stalls, 0.99), percentile_ms(&stalls, 1.0));
+  fflush(stdout);
+
+  free(pauses.values);
+  free(stalls.values);
+  vm_free(vm);
+}
+
+int main(void) {
+  const char *sizes = getenv("BENCH_LIVE_MB");
+  const char *rate_env = getenv("BENCH_ALLOC_RATE");
+  const char *seconds_env = getenv("BENCH_SECONDS");
+  double rate = rate_env ? atof(rate_env) : DEFAULT_ALLOC_RATE;
+  double seconds = seconds_env ? atof(seconds_env) : DEFAULT_SECONDS;
+  if (rate <= 0 || seconds <= 0) {
+    fprintf(stderr, "BENCH_ALLOC_RATE and BENCH_SECONDS must be positive\n");
+    return 1;
+  }
+
+  char list[256];
+  snprintf(list, sizeof(list), "%s", sizes ? sizes : DEFAULT_LIVE_MB);
+  for (char *size = strtok(list, ","); size != NULL;
+       size = strtok(NULL, ",")) {
+    long live_mb = atol(size);
+    if (live_mb < 1 || live_mb > 8192) {
+      fprintf(stderr, "live set sizes must be 1 to 8192 MB, got %s\n", size);
+      return 1;
+    }
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+      run_pause(&modes[i], (size_t)live_mb, rate, seconds);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,95 @@
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/vm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define ELEMENTS 1000000
+#define ADD_ROUNDS 20
+
+static double now_ms(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static snek_object_t *boxed_add(snek_object_t *a, snek_object_t *b, vm_t *vm) {
+  size_t size = a->data.v_array.size;
+  snek_object_t *sum = new_snek_array(size, vm);
+  for (size_t i = 0; i < size; i++) {
+    snek_array_set(sum, i,
+                   snek_add(snek_array_get(a, i), snek_array_get(b, i), vm));
+  }
+  return sum;
+}
+
+// Time one mark + trace over whatever the frame keeps alive
+static double mark_time_ms(vm_t *vm) {
+  double start = now_ms();
+  mark(vm);
+  trace(vm);
+  double elapsed = now_ms() - start;
+  sweep(vm);
+  return elapsed;
+}
+
+static void bench_boxed(void) {
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+
+  snek_object_t *a = new_snek_array(ELEMENTS, vm);
+  snek_object_t *b = new_snek_array(ELEMENTS, vm);
+  for (size_t i = 0; i < ELEMENTS; i++) {
+    snek_array_set(a, i, new_snek_float((float)i, vm));
+    snek_array_set(b, i, new_snek_float(1.0f, vm));
+  }
+  frame_reference_object(frame, a);
+  frame_reference_object(frame, b);
+
+  double start = now_ms();
+  for (int round = 0; round < ADD_ROUNDS; round++) {
+    boxed_add(a, b, vm);
+    vm_collect_garbage(vm);
+  }
+  double add_ms = now_ms() - start;
+
+  printf("{\"bench\": \"boxed_float_array\", \"elements\": %d, "
+         "\"add_melem_per_s\": %.2f, \"mark_ms\": %.3f}\n",
+         ELEMENTS, ELEMENTS * (double)ADD_ROUNDS / add_ms / 1e3,
+         mark_time_ms(vm));
+  vm_free(vm);
+}
+
+static void bench_unboxed(void) {
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+
+  snek_object_t *a = new_snek_float_array(ELEMENTS, vm);
+  snek_object_t *b = new_snek_float_array(ELEMENTS, vm);
+  for (size_t i = 0; i < ELEMENTS; i++) {
+    a->data.v_float_array.elements[i] = (float)i;
+    b->data.v_float_array.elements[i] = 1.0f;
+  }
+  frame_reference_object(frame, a);
+  frame_reference_object(frame, b);
+
+  double start = now_ms();
+  for (int round = 0; round < ADD_ROUNDS; round++) {
+    snek_add(a, b, vm);
+    vm_collect_garbage(vm);
+  }
+  double add_ms = now_ms() - start;
+
+  printf("{\"bench\": \"unboxed_float_array\", \"elements\": %d, "
+         "\"add_melem_per_s\": %.2f, \"mark_ms\": %.3f}\n",
+         ELEMENTS, ELEMENTS * (double)ADD_ROUNDS / add_ms / 1e3,
+         mark_time_ms(vm));
+  vm_free(vm);
+}
+
+int main(void) {
+  bench_boxed();
+  bench_unboxed();
+  return 0;
+}
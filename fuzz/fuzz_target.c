@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "snekfuzz.h"
+
+// libFuzzer entry point. AFL++ drives the same function through
+// afl-clang-fast, or through the stdin main below with plain afl-gcc.
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  char error[256];
+  if (!snek_fuzz_run(data, size, error, sizeof(error))) {
+    fprintf(stderr, "snek_fuzz: %s\n", error);
+    abort();
+  }
+  return 0;
+}
+
+#ifndef SNEK_LIBFUZZER
+// Runs each file argument, or stdin without arguments, as one program.
+// Useful for replaying crashes without a fuzzing engine.
+static int run_file(FILE *file) {
+  size_t capacity = 4096;
+  size_t size = 0;
+  uint8_t *data = malloc(capacity);
+  size_t read;
+  while ((read = fread(data + size, 1, capacity - size, file)) > 0) {
+    size += read;
+    if (size == capacity) {
+      capacity *= 2;
+      data = realloc(data, capacity);
+    }
+  }
+  LLVMFuzzerTestOneInput(data, size);
+  free(data);
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    return run_file(stdin);
+  }
+  for (int i = 1; i < argc; i++) {
+    FILE *file = fopen(argv[i], "rb");
+    if (file == NULL) {
+      perror(argv[i]);
+      return 1;
+    }
+    run_file(file);
+    fclose(file);
+  }
+  return 0;
+}
+#endif
@@ -0,0 +1,597 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/heapverify.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/snekpvec.h"
+#include "../src/vm.h"
+#include "snekfuzz.h"
+
+#define FUZZ_NONE SIZE_MAX
+
+typedef enum FuzzOp {
+  FUZZ_INTEGER,
+  FUZZ_FLOAT,
+  FUZZ_STRING,
+  FUZZ_ARRAY,
+  FUZZ_VECTOR3,
+  FUZZ_INT_ARRAY,
+  FUZZ_FLOAT_VECTOR3,
+  FUZZ_SLICE,
+  FUZZ_ROPE,
+  FUZZ_PVEC,
+  FUZZ_PVEC_PUSH,
+  FUZZ_ARRAY_SET,
+  FUZZ_ADD,
+  FUZZ_FRAME_PUSH,
+  FUZZ_FRAME_POP,
+  FUZZ_REFERENCE,
+  FUZZ_COLLECT,
+  FUZZ_OP_COUNT,
+} fuzz_op_t;
+
+// What the model knows about one object. Arrays, persistent vectors,
+// vector3s and ropes list the handles they reference in `elements`,
+// slices view `length` elements of `parent` from `offset`.
+typedef struct FuzzHandle {
+  snek_object_t *obj;
+  snek_object_kind_t kind;
+  // Cleared once a collection frees it, dead handles are never used
+  bool live;
+  bool reached;
+  int v_int;
+  float v_float;
+  size_t *elements;
+  size_t count;
+  size_t parent;
+  size_t offset;
+  size_t length;
+} fuzz_handle_t;
+
+typedef struct FuzzFrame {
+  frame_t *frame;
+  size_t *roots;
+  size_t count;
+} fuzz_frame_t;
+
+typedef struct FuzzState {
+  vm_t *vm;
+  const uint8_t *data;
+  size_t size;
+  size_t pos;
+  fuzz_handle_t *handles;
+  size_t handle_count;
+  // Ids of live handles, what operations pick their operands from
+  size_t *live;
+  size_t live_count;
+  fuzz_frame_t frames[SNEK_FUZZ_MAX_FRAMES];
+  size_t frame_count;
+  size_t *work;
+  bool failed;
+  char *error;
+  size_t error_size;
+} fuzz_state_t;
+
+static void fuzz_fail(fuzz_state_t *state, const char *format, ...) {
+  if (state->failed) {
+    return;
+  }
+  state->failed = true;
+  va_list args;
+  va_start(args, format);
+  vsnprintf(state->error, state->error_size, format, args);
+  va_end(args);
+}
+
+// Exhausted input reads as zeros, the run loop stops before that matters
+static uint8_t fuzz_byte(fuzz_state_t *state) {
+  return state->pos < state->size ? state->data[state->pos++] : 0;
+}
+
+static size_t fuzz_pick(fuzz_state_t *state) {
+  size_t index = fuzz_byte(state) | (size_t)fuzz_byte(state) << 8;
+  return state->live_count == 0 ? FUZZ_NONE
+                                : state->live[index % state->live_count];
+}
+
+static snek_object_t *fuzz_obj(fuzz_state_t *state, size_t id) {
+  return id == FUZZ_NONE ? NULL : state->handles[id].obj;
+}
+
+// Registers `obj` with the model, taking ownership of `elements`
+static fuzz_handle_t *fuzz_adopt(fuzz_state_t *state, snek_object_t *obj,
+                                 size_t *elements, size_t count) {
+  if (obj == NULL) {
+    free(elements);
+    fuzz_fail(state, "allocation failed");
+    return NULL;
+  }
+  size_t id = state->handle_count++;
+  fuzz_handle_t *handle = &state->handles[id];
+  *handle = (fuzz_handle_t){.obj = obj,
+                            .kind = obj->kind,
+                            .live = true,
+                            .elements = elements,
+                            .count = count,
+                            .parent = FUZZ_NONE};
+  state->live[state->live_count++] = id;
+  return handle;
+}
+
+static size_t *fuzz_ids(size_t count) {
+  size_t *ids = malloc((count ? count : 1) * sizeof(size_t));
+  for (size_t i = 0; i < count; i++) {
+    ids[i] = FUZZ_NONE;
+  }
+  return ids;
+}
+
+// Element ids an ARRAY or SLICE handle shows, NULL for other kinds
+static size_t *fuzz_view(fuzz_state_t *state, size_t id, size_t *count) {
+  fuzz_handle_t *handle = &state->handles[id];
+  if (handle->kind == ARRAY) {
+    *count = handle->count;
+    return handle->elements;
+  }
+  if (handle->kind == SLICE) {
+    *count = handle->length;
+    return state->handles[handle->parent].elements + handle->offset;
+  }
+  return NULL;
+}
+
+static void fuzz_alloc(fuzz_state_t *state, fuzz_op_t op) {
+  vm_t *vm = state->vm;
+  switch (op) {
+  case FUZZ_INTEGER: {
+    int value = (int8_t)fuzz_byte(state);
+    fuzz_handle_t *handle =
+        fuzz_adopt(state, new_snek_integer(value, vm), NULL, 0);
+    if (handle != NULL) {
+      handle->v_int = value;
+    }
+    break;
+  }
+  case FUZZ_FLOAT: {
+    float value = (int8_t)fuzz_byte(state) / 4.0f;
+    fuzz_handle_t *handle =
+        fuzz_adopt(state, new_snek_float(value, vm), NULL, 0);
+    if (handle != NULL) {
+      handle->v_float = value;
+    }
+    break;
+  }
+  case FUZZ_STRING: {
+    char chars[32];
+    size_t length = fuzz_byte(state) % sizeof(chars);
+    memset(chars, 'a' + (int)(length % 26), length);
+    fuzz_handle_t *handle = fuzz_adopt(
+        state, new_snek_string_len(chars, length, vm), NULL, 0);
+    if (handle != NULL) {
+      handle->length = length;
+    }
+    break;
+  }
+  case FUZZ_ARRAY: {
+    size_t size = fuzz_byte(state) % 9;
+    fuzz_adopt(state, new_snek_array(size, vm), fuzz_ids(size), size);
+    break;
+  }
+  case FUZZ_VECTOR3: {
+    size_t *ids = fuzz_ids(3);
+    for (int i = 0; i < 3; i++) {
+      ids[i] = fuzz_pick(state);
+    }
+    if (ids[0] == FUZZ_NONE) {
+      free(ids);
+      break;
+    }
+    fuzz_adopt(state,
+               new_snek_vector3(fuzz_obj(state, ids[0]),
+                                fuzz_obj(state, ids[1]),
+                                fuzz_obj(state, ids[2]), vm),
+               ids, 3);
+    break;
+  }
+  case FUZZ_INT_ARRAY: {
+    size_t size = fuzz_byte(state) % 9;
+    fuzz_handle_t *handle =
+        fuzz_adopt(state, new_snek_int_array(size, vm), NULL, 0);
+    if (handle != NULL) {
+      handle->length = size;
+    }
+    break;
+  }
+  case FUZZ_FLOAT_VECTOR3:
+    fuzz_adopt(state, new_snek_float_vector3(1.0f, 2.0f, 3.0f, vm), NULL, 0);
+    break;
+  case FUZZ_SLICE: {
+    size_t id = fuzz_pick(state);
+    size_t offset = fuzz_byte(state);
+    size_t length = fuzz_byte(state);
+    size_t count;
+    if (id == FUZZ_NONE || fuzz_view(state, id, &count) == NULL) {
+      break;
+    }
+    offset %= count + 1;
+    length %= count - offset + 1;
+    fuzz_handle_t *handle = fuzz_adopt(
+        state, new_snek_slice(fuzz_obj(state, id), offset, length, vm), NULL,
+        0);
+    if (handle != NULL) {
+      // Slices of slices view the underlying array
+      fuzz_handle_t *source = &state->handles[id];
+      bool nested = source->kind == SLICE;
+      handle->parent = nested ? source->parent : id;
+      handle->offset = offset + (nested ? source->offset : 0);
+      handle->length = length;
+    }
+    break;
+  }
+  case FUZZ_ROPE: {
+    size_t left = fuzz_pick(state);
+    size_t right = fuzz_pick(state);
+    if (left == FUZZ_NONE || state->handles[left].kind != STRING ||
+        state->handles[right].kind != STRING) {
+      break;
+    }
+    size_t *ids = fuzz_ids(2);
+    ids[0] = left;
+    ids[1] = right;
+    fuzz_handle_t *handle = fuzz_adopt(
+        state,
+        new_snek_rope(fuzz_obj(state, left), fuzz_obj(state, right), vm),
+        ids, 2);
+    if (handle != NULL) {
+      handle->length =
+          state->handles[left].length + state->handles[right].length;
+    }
+    break;
+  }
+  case FUZZ_PVEC:
+    fuzz_adopt(state, new_snek_pvec(vm), fuzz_ids(0), 0);
+    break;
+  case FUZZ_PVEC_PUSH: {
+    size_t id = fuzz_pick(state);
+    size_t value = fuzz_pick(state);
+    if (id == FUZZ_NONE || state->handles[id].kind != PVECTOR ||
+        state->handles[id].count >= SNEK_FUZZ_MAX_ELEMENTS) {
+      break;
+    }
+    fuzz_handle_t *vec = &state->handles[id];
+    size_t *ids = fuzz_ids(vec->count + 1);
+    memcpy(ids, vec->elements, vec->count * sizeof(size_t));
+    ids[vec->count] = value;
+    fuzz_adopt(state,
+               snek_pvec_push(vec->obj, fuzz_obj(state, value), state->vm),
+               ids, vec->count + 1);
+    break;
+  }
+  case FUZZ_ADD: {
+    size_t a = fuzz_pick(state);
+    size_t b = fuzz_pick(state);
+    if (a == FUZZ_NONE) {
+      break;
+    }
+    fuzz_handle_t *left = &state->handles[a];
+    fuzz_handle_t *right = &state->handles[b];
+    size_t count_a, count_b;
+    size_t *view_a = fuzz_view(state, a, &count_a);
+    size_t *view_b = fuzz_view(state, b, &count_b);
+    if (left->kind == INTEGER && right->kind == INTEGER) {
+      fuzz_handle_t *sum =
+          fuzz_adopt(state, snek_add(left->obj, right->obj, vm), NULL, 0);
+      if (sum != NULL) {
+        sum->v_int = state->handles[a].v_int + state->handles[b].v_int;
+      }
+    } else if (left->kind == FLOAT && right->kind == FLOAT) {
+      fuzz_handle_t *sum =
+          fuzz_adopt(state, snek_add(left->obj, right->obj, vm), NULL, 0);
+      if (sum != NULL) {
+        sum->v_float = state->handles[a].v_float + state->handles[b].v_float;
+      }
+    } else if (view_a != NULL && view_b != NULL &&
+               count_a + count_b <= SNEK_FUZZ_MAX_ELEMENTS) {
+      // Concatenation copies what both operands show right now
+      size_t *ids = fuzz_ids(count_a + count_b);
+      memcpy(ids, view_a, count_a * sizeof(size_t));
+      memcpy(ids + count_a, view_b, count_b * sizeof(size_t));
+      fuzz_adopt(state, snek_add(left->obj, right->obj, vm), ids,
+                 count_a + count_b);
+    } else if (left->kind == PVECTOR && right->kind == PVECTOR &&
+               left->count + right->count <= SNEK_FUZZ_MAX_ELEMENTS) {
+      size_t *ids = fuzz_ids(left->count + right->count);
+      memcpy(ids, left->elements, left->count * sizeof(size_t));
+      memcpy(ids + left->count, right->elements,
+             right->count * sizeof(size_t));
+      fuzz_adopt(state, snek_add(left->obj, right->obj, vm), ids,
+                 left->count + right->count);
+    }
+    break;
+  }
+  default:
+    break;
+  }
+}
+
+static void fuzz_array_set(fuzz_state_t *state) {
+  size_t id = fuzz_pick(state);
+  size_t index = fuzz_byte(state);
+  size_t value = fuzz_pick(state);
+  size_t count;
+  size_t *view = id == FUZZ_NONE ? NULL : fuzz_view(state, id, &count);
+  if (view == NULL || count == 0) {
+    return;
+  }
+  index %= count;
+  if (!snek_array_set(fuzz_obj(state, id), index, fuzz_obj(state, value))) {
+    fuzz_fail(state, "snek_array_set failed on handle %zu", id);
+    return;
+  }
+  view[index] = value;
+}
+
+static void fuzz_frame_push(fuzz_state_t *state) {
+  if (state->frame_count == SNEK_FUZZ_MAX_FRAMES) {
+    return;
+  }
+  fuzz_frame_t *frame = &state->frames[state->frame_count++];
+  frame->frame = vm_new_frame(state->vm);
+  frame->roots = malloc(SNEK_FUZZ_MAX_HANDLES * sizeof(size_t));
+  frame->count = 0;
+}
+
+static void fuzz_frame_pop(fuzz_state_t *state) {
+  if (state->frame_count == 0) {
+    return;
+  }
+  fuzz_frame_t *frame = &state->frames[--state->frame_count];
+  frame_free(vm_frame_pop(state->vm));
+  free(frame->roots);
+}
+
+static void fuzz_reference(fuzz_state_t *state) {
+  size_t id = fuzz_pick(state);
+  if (id == FUZZ_NONE || state->frame_count == 0) {
+    return;
+  }
+  fuzz_frame_t *frame = &state->frames[state->frame_count - 1];
+  if (frame->count == SNEK_FUZZ_MAX_HANDLES) {
+    return;
+  }
+  frame_reference_object(frame->frame, fuzz_obj(state, id));
+  frame->roots[frame->count++] = id;
+}
+
+static void fuzz_reach(fuzz_state_t *state, size_t *work, size_t *pending,
+                       size_t id) {
+  if (id != FUZZ_NONE && !state->handles[id].reached) {
+    state->handles[id].reached = true;
+    work[(*pending)++] = id;
+  }
+}
+
+// Marks every handle the model reaches from the frames
+static size_t fuzz_model_reach(fuzz_state_t *state) {
+  size_t *work = state->work;
+  size_t pending = 0;
+  size_t reached = 0;
+  for (size_t i = 0; i < state->live_count; i++) {
+    state->handles[state->live[i]].reached = false;
+  }
+  for (size_t i = 0; i < state->frame_count; i++) {
+    for (size_t j = 0; j < state->frames[i].count; j++) {
+      fuzz_reach(state, work, &pending, state->frames[i].roots[j]);
+    }
+  }
+  while (pending > 0) {
+    fuzz_handle_t *handle = &state->handles[work[--pending]];
+    reached++;
+    for (size_t i = 0; i < handle->count; i++) {
+      fuzz_reach(state, work, &pending, handle->elements[i]);
+    }
+    fuzz_reach(state, work, &pending, handle->parent);
+  }
+  return reached;
+}
+
+static int fuzz_compare_ptrs(const void *a, const void *b) {
+  uintptr_t left = (uintptr_t)*(void *const *)a;
+  uintptr_t right = (uintptr_t)*(void *const *)b;
+  return left < right ? -1 : left > right;
+}
+
+static bool fuzz_registered(void **sorted, size_t count, snek_object_t *obj) {
+  return bsearch(&obj, sorted, count, sizeof(void *), fuzz_compare_ptrs) !=
+         NULL;
+}
+
+static void fuzz_check_contents(fuzz_state_t *state, size_t id) {
+  fuzz_handle_t *handle = &state->handles[id];
+  snek_object_t *obj = handle->obj;
+  if (obj->kind != handle->kind) {
+    fuzz_fail(state, "handle %zu changed kind to %d", id, obj->kind);
+    return;
+  }
+
+  size_t count;
+  size_t *view = fuzz_view(state, id, &count);
+  switch (handle->kind) {
+  case INTEGER:
+    if (obj->data.v_int != handle->v_int) {
+      fuzz_fail(state, "integer %zu is %d, expected %d", id, obj->data.v_int,
+                handle->v_int);
+    }
+    break;
+  case FLOAT:
+    if (obj->data.v_float != handle->v_float) {
+      fuzz_fail(state, "float %zu changed", id);
+    }
+    break;
+  case STRING:
+    if (obj->data.v_string.length != handle->length) {
+      fuzz_fail(state, "string %zu has length %zu, expected %zu", id,
+                obj->data.v_string.length, handle->length);
+    } else if (handle->count == 2 &&
+               (obj->data.v_string.rope == NULL ||
+                obj->data.v_string.rope->left !=
+                    fuzz_obj(state, handle->elements[0]) ||
+                obj->data.v_string.rope->right !=
+                    fuzz_obj(state, handle->elements[1]))) {
+      fuzz_fail(state, "rope %zu lost its halves", id);
+    }
+    break;
+  case VECTOR3:
+    if (obj->data.v_vector3.x != fuzz_obj(state, handle->elements[0]) ||
+        obj->data.v_vector3.y != fuzz_obj(state, handle->elements[1]) ||
+        obj->data.v_vector3.z != fuzz_obj(state, handle->elements[2])) {
+      fuzz_fail(state, "vector3 %zu changed components", id);
+    }
+    break;
+  case INT_ARRAY:
+    if (obj->data.v_int_array.size != handle->length) {
+      fuzz_fail(state, "int array %zu changed size", id);
+    }
+    break;
+  case ARRAY:
+  case SLICE:
+    if ((size_t)snek_length(obj) != count) {
+      fuzz_fail(state, "array %zu has %d elements, expected %zu", id,
+                snek_length(obj), count);
+      return;
+    }
+    for (size_t i = 0; i < count; i++) {
+      if (snek_array_get(obj, i) != fuzz_obj(state, view[i])) {
+        fuzz_fail(state, "array %zu element %zu differs", id, i);
+        return;
+      }
+    }
+    break;
+  case PVECTOR:
+    if (obj->data.v_pvec.size != handle->count) {
+      fuzz_fail(state, "vector %zu has %zu elements, expected %zu", id,
+                obj->data.v_pvec.size, handle->count);
+      return;
+    }
+    for (size_t i = 0; i < handle->count; i++) {
+      if (snek_pvec_get(obj, i) != fuzz_obj(state, handle->elements[i])) {
+        fuzz_fail(state, "vector %zu element %zu differs", id, i);
+        return;
+      }
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+static void fuzz_collect(fuzz_state_t *state) {
+  vm_t *vm = state->vm;
+  vm_collect_garbage(vm);
+  size_t reached = fuzz_model_reach(state);
+
+  size_t counted = registry_count(vm->objects);
+  void **sorted = malloc((counted + 1) * sizeof(void *));
+  size_t registered =
+      registry_copy(vm->objects, (snek_object_t **)sorted, counted + 1);
+  qsort(sorted, registered, sizeof(void *), fuzz_compare_ptrs);
+
+  // Freed handles are only checked against the registry in the collection
+  // that freed them, later allocations may reuse their addresses
+  size_t kept = 0;
+  for (size_t i = 0; i < state->live_count; i++) {
+    size_t id = state->live[i];
+    fuzz_handle_t *handle = &state->handles[id];
+    bool present = fuzz_registered(sorted, registered, handle->obj);
+    if (handle->reached) {
+      if (!present) {
+        fuzz_fail(state, "reachable handle %zu was freed", id);
+      } else {
+        fuzz_check_contents(state, id);
+      }
+      state->live[kept++] = id;
+    } else {
+      if (present) {
+        fuzz_fail(state, "unreachable handle %zu survived", id);
+      }
+      handle->live = false;
+    }
+  }
+  state->live_count = kept;
+  free(sorted);
+
+  if (registered != reached) {
+    fuzz_fail(state, "registry holds %zu objects, model reaches %zu",
+              registered, reached);
+  }
+  heap_verify_report_t report;
+  if (!vm_verify_heap(vm, &report)) {
+    fuzz_fail(state, "heap verification: %s", report.first_error);
+  }
+}
+
+bool snek_fuzz_run(const uint8_t *data, size_t size, char *error,
+                   size_t error_size) {
+  fuzz_state_t state = {
+      .vm = vm_new(),
+      .data = data,
+      .size = size,
+      .handles = malloc(SNEK_FUZZ_MAX_HANDLES * sizeof(fuzz_handle_t)),
+      .live = malloc(SNEK_FUZZ_MAX_HANDLES * sizeof(size_t)),
+      .work = malloc(SNEK_FUZZ_MAX_HANDLES * sizeof(size_t)),
+      .error = error,
+      .error_size = error_size,
+  };
+  if (error_size > 0) {
+    error[0] = '\0';
+  }
+
+  while (state.pos < size && !state.failed) {
+    fuzz_op_t op = fuzz_byte(&state) % FUZZ_OP_COUNT;
+    switch (op) {
+    case FUZZ_ARRAY_SET:
+      fuzz_array_set(&state);
+      break;
+    case FUZZ_FRAME_PUSH:
+      fuzz_frame_push(&state);
+      break;
+    case FUZZ_FRAME_POP:
+      fuzz_frame_pop(&state);
+      break;
+    case FUZZ_REFERENCE:
+      fuzz_reference(&state);
+      break;
+    case FUZZ_COLLECT:
+      fuzz_collect(&state);
+      break;
+    default:
+      if (state.handle_count < SNEK_FUZZ_MAX_HANDLES) {
+        fuzz_alloc(&state, op);
+      }
+      break;
+    }
+  }
+
+  // Everything must go once no frame is left
+  if (!state.failed) {
+    fuzz_collect(&state);
+  }
+  while (state.frame_count > 0) {
+    fuzz_frame_pop(&state);
+  }
+  if (!state.failed) {
+    fuzz_collect(&state);
+  }
+
+  for (size_t i = 0; i < state.handle_count; i++) {
+    free(state.handles[i].elements);
+  }
+  free(state.handles);
+  free(state.live);
+  free(state.work);
+  vm_free(state.vm);
+  return !state.failed;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/// Differential fuzzing of the collector. A byte stream is read as a
+/// program of VM operations: allocating every kind, array sets, slices,
+/// ropes, persistent vector pushes, concatenation, frame pushes and pops,
+/// frame references and collections. The same program runs against a
+/// plain reference model of handles and edges. After every collection
+/// the registry must hold exactly the objects the model can reach from
+/// its frames, with the same contents, and `vm_verify_heap` must pass.
+///
+/// Every object the program creates gets a model handle, no operation
+/// used creates objects behind the model's back.
+
+/// Programs stop allocating once they hold this many handles
+#define SNEK_FUZZ_MAX_HANDLES 4096
+#define SNEK_FUZZ_MAX_FRAMES 16
+/// Arrays and vectors are kept below the slice compaction threshold
+#define SNEK_FUZZ_MAX_ELEMENTS 256
+
+/// Runs one program. Returns false and describes the first mismatch in
+/// `error` when the VM and the model disagree.
+bool snek_fuzz_run(const uint8_t *data, size_t size, char *error,
+                   size_t error_size);
@@ -1,46 +1,754 @@
 #define BOOTMEM_IMPLEMENTATION
+#define _GNU_SOURCE
+#include <dlfcn.h>
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 #include "bootmem.h"
+#include "heapsample.h"
+#include "largespace.h"
 
-static int allocation_count = 0;
+static atomic_int allocation_count = 0;
 
-void *boot_malloc(size_t size)
+/* Current and peak sizes are shared so the high-water mark is exact, the
+   last slot holds the sum over every category. Cumulative totals are per
+   thread like the site counters below. */
+static atomic_size_t boot_current[BOOT_CATEGORY_COUNT + 1];
+static atomic_size_t boot_peak[BOOT_CATEGORY_COUNT + 1];
+
+typedef struct BootCategoryCounters
+{
+  atomic_uint_fast64_t allocated_bytes;
+  atomic_uint_fast64_t freed_bytes;
+  atomic_uint_fast64_t allocations;
+  atomic_uint_fast64_t frees;
+} boot_category_counters_t;
+
+typedef struct BootThreadBytes
+{
+  struct BootThreadBytes *next;
+  atomic_bool in_use;
+  boot_category_counters_t categories[BOOT_CATEGORY_COUNT];
+} boot_thread_bytes_t;
+
+static _Atomic(boot_thread_bytes_t *) boot_all_thread_bytes;
+static _Thread_local boot_thread_bytes_t *boot_thread_bytes;
+
+/* Site table: open addressing, claimed with a CAS on the key and never
+   removed, so lookups are lock-free. File sites pack the line, tagged
+   with its top bit, into the unused top bits of the file pointer. Caller
+   sites are the bare return address. The last slot is charged when the
+   table is full. */
+#define BOOT_SITE_CAPACITY 4096
+#define BOOT_SITE_OVERFLOW BOOT_SITE_CAPACITY
+#define BOOT_SITE_NONE UINT32_MAX
+#define BOOT_SITE_LINE_SHIFT 48
+#define BOOT_SITE_LINE_TAG 0x8000
+#define BOOT_SITE_LINE_MASK 0x7fff
+
+static _Atomic uintptr_t boot_site_keys[BOOT_SITE_CAPACITY];
+static atomic_bool boot_profiling;
+static atomic_bool boot_poisoning;
+
+/* Counters are per thread so charging an allocation is a few plain adds.
+   A block freed on another thread is credited there, the report sums all
+   threads. When a thread exits its counters go back on the list unowned,
+   and the next new thread takes them over and keeps adding to them, so
+   the sums keep its history and there are never more tables than threads
+   running at once. */
+typedef struct BootSiteCounters
+{
+  atomic_uint_fast64_t allocations;
+  atomic_uint_fast64_t total_bytes;
+  atomic_int_fast64_t live_count;
+  atomic_int_fast64_t live_bytes;
+} boot_site_counters_t;
+
+typedef struct BootThreadSites
+{
+  struct BootThreadSites *next;
+  atomic_bool in_use;
+  boot_site_counters_t sites[BOOT_SITE_CAPACITY + 1];
+} boot_thread_sites_t;
+
+static _Atomic(boot_thread_sites_t *) boot_all_thread_sites;
+static _Thread_local boot_thread_sites_t *boot_thread_sites;
+/* Set inside a BOOT_SITE_SCOPE */
+static _Thread_local uint32_t boot_site_current = BOOT_SITE_NONE;
+
+/* Its destructor hands the exiting thread's counters back */
+static pthread_key_t boot_thread_key;
+static pthread_once_t boot_thread_once = PTHREAD_ONCE_INIT;
+
+/* Every block carries its size, category, site and heap sample id, which
+   keeps 16 byte alignment. Large blocks live in the large-object space. */
+typedef struct BootHeader
 {
-  allocation_count++;
-  return malloc(size);
+  uint32_t site;
+  uint32_t sample;
+  uint64_t size : 55;
+  uint64_t large : 1;
+  uint64_t category : 8;
+} boot_header_t;
+
+_Static_assert(sizeof(boot_header_t) == 16, "header must keep alignment");
+
+static uint32_t boot_site_lookup(uintptr_t key)
+{
+  size_t slot = (size_t)((key * 0x9e3779b97f4a7c15ull) >> 52);
+  for (size_t probe = 0; probe < BOOT_SITE_CAPACITY; probe++)
+  {
+    size_t index = (slot + probe) & (BOOT_SITE_CAPACITY - 1);
+    uintptr_t current =
+        atomic_load_explicit(&boot_site_keys[index], memory_order_acquire);
+    if (current == key)
+    {
+      return (uint32_t)index;
+    }
+    if (current == 0)
+    {
+      uintptr_t empty = 0;
+      if (atomic_compare_exchange_strong(&boot_site_keys[index], &empty,
+                                         key) ||
+          empty == key)
+      {
+        return (uint32_t)index;
+      }
+    }
+  }
+  return BOOT_SITE_OVERFLOW;
 }
 
-void *boot_calloc(size_t num, size_t size)
+/* `file` is NULL when called through the plain functions, those are
+   charged to their caller */
+static uint32_t boot_site_for(const char *file, int line, void *caller)
 {
-  allocation_count++;
-  return calloc(num, size);
+  if (!atomic_load_explicit(&boot_profiling, memory_order_relaxed))
+  {
+    return BOOT_SITE_NONE;
+  }
+  if (boot_site_current != BOOT_SITE_NONE)
+  {
+    return boot_site_current;
+  }
+  if (file == NULL)
+  {
+    return boot_site_lookup((uintptr_t)caller);
+  }
+  uintptr_t tag = BOOT_SITE_LINE_TAG | (line & BOOT_SITE_LINE_MASK);
+  return boot_site_lookup((uintptr_t)file | (tag << BOOT_SITE_LINE_SHIFT));
 }
 
-void *boot_realloc(void *ptr, size_t size)
+/* Runs on the exiting thread. Release pairs with the acquire in the
+   claims below, so the next owner sees every count this thread made. */
+static void boot_thread_exit(void *unused)
+{
+  (void)unused;
+  if (boot_thread_sites != NULL)
+  {
+    atomic_store_explicit(&boot_thread_sites->in_use, false,
+                          memory_order_release);
+    boot_thread_sites = NULL;
+  }
+  if (boot_thread_bytes != NULL)
+  {
+    atomic_store_explicit(&boot_thread_bytes->in_use, false,
+                          memory_order_release);
+    boot_thread_bytes = NULL;
+  }
+}
+
+static void boot_thread_key_create(void)
+{
+  pthread_key_create(&boot_thread_key, boot_thread_exit);
+}
+
+/* The value only has to be non-NULL for the destructor to run */
+static void boot_thread_register(void)
+{
+  pthread_once(&boot_thread_once, boot_thread_key_create);
+  pthread_setspecific(boot_thread_key, &boot_thread_key);
+}
+
+static bool boot_thread_claim(atomic_bool *in_use)
+{
+  bool expected = false;
+  return atomic_compare_exchange_strong_explicit(
+      in_use, &expected, true, memory_order_acquire, memory_order_relaxed);
+}
+
+static boot_thread_sites_t *boot_thread_sites_get(void)
+{
+  if (boot_thread_sites != NULL)
+  {
+    return boot_thread_sites;
+  }
+
+  for (boot_thread_sites_t *sites = atomic_load(&boot_all_thread_sites);
+       sites != NULL; sites = sites->next)
+  {
+    if (boot_thread_claim(&sites->in_use))
+    {
+      boot_thread_register();
+      boot_thread_sites = sites;
+      return sites;
+    }
+  }
+
+  boot_thread_sites_t *sites = calloc(1, sizeof(boot_thread_sites_t));
+  if (sites == NULL)
+  {
+    return NULL;
+  }
+  atomic_init(&sites->in_use, true);
+  sites->next = atomic_load(&boot_all_thread_sites);
+  while (!atomic_compare_exchange_weak(&boot_all_thread_sites, &sites->next,
+                                       sites))
+  {
+  }
+  boot_thread_register();
+  boot_thread_sites = sites;
+  return sites;
+}
+
+/* Only the owning thread writes its counters, relaxed load and store
+   keeps concurrent reports well defined without a locked add */
+#define BOOT_COUNTER_ADD(counter, delta)                                    \
+  atomic_store_explicit(                                                    \
+      &(counter),                                                           \
+      atomic_load_explicit(&(counter), memory_order_relaxed) + (delta),     \
+      memory_order_relaxed)
+
+static void boot_site_charge(uint32_t site, int64_t count, int64_t bytes)
+{
+  if (site == BOOT_SITE_NONE)
+  {
+    return;
+  }
+  boot_thread_sites_t *sites = boot_thread_sites_get();
+  if (sites == NULL)
+  {
+    return;
+  }
+
+  boot_site_counters_t *counters = &sites->sites[site];
+  if (count > 0)
+  {
+    BOOT_COUNTER_ADD(counters->allocations, 1);
+  }
+  if (bytes > 0)
+  {
+    BOOT_COUNTER_ADD(counters->total_bytes, bytes);
+  }
+  BOOT_COUNTER_ADD(counters->live_count, count);
+  BOOT_COUNTER_ADD(counters->live_bytes, bytes);
+}
+
+static boot_thread_bytes_t *boot_thread_bytes_get(void)
+{
+  if (boot_thread_bytes != NULL)
+  {
+    return boot_thread_bytes;
+  }
+
+  for (boot_thread_bytes_t *bytes = atomic_load(&boot_all_thread_bytes);
+       bytes != NULL; bytes = bytes->next)
+  {
+    if (boot_thread_claim(&bytes->in_use))
+    {
+      boot_thread_register();
+      boot_thread_bytes = bytes;
+      return bytes;
+    }
+  }
+
+  boot_thread_bytes_t *bytes = calloc(1, sizeof(boot_thread_bytes_t));
+  if (bytes == NULL)
+  {
+    return NULL;
+  }
+  atomic_init(&bytes->in_use, true);
+  bytes->next = atomic_load(&boot_all_thread_bytes);
+  while (!atomic_compare_exchange_weak(&boot_all_thread_bytes, &bytes->next,
+                                       bytes))
+  {
+  }
+  boot_thread_register();
+  boot_thread_bytes = bytes;
+  return bytes;
+}
+
+static void boot_raise_peak(atomic_size_t *peak, size_t current)
+{
+  size_t seen = atomic_load_explicit(peak, memory_order_relaxed);
+  while (current > seen &&
+         !atomic_compare_exchange_weak_explicit(peak, &seen, current,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed))
+  {
+  }
+}
+
+/* `count` is 1 for an allocation, -1 for a free and 0 for a resize */
+static void boot_account(unsigned category, int count, int64_t bytes)
+{
+  if (bytes >= 0)
+  {
+    size_t delta = (size_t)bytes;
+    boot_raise_peak(&boot_peak[category],
+                    atomic_fetch_add_explicit(&boot_current[category], delta,
+                                              memory_order_relaxed) +
+                        delta);
+    boot_raise_peak(&boot_peak[BOOT_CATEGORY_ALL],
+                    atomic_fetch_add_explicit(
+                        &boot_current[BOOT_CATEGORY_ALL], delta,
+                        memory_order_relaxed) +
+                        delta);
+  }
+  else
+  {
+    size_t delta = (size_t)-bytes;
+    atomic_fetch_sub_explicit(&boot_current[category], delta,
+                              memory_order_relaxed);
+    atomic_fetch_sub_explicit(&boot_current[BOOT_CATEGORY_ALL], delta,
+                              memory_order_relaxed);
+  }
+
+  boot_thread_bytes_t *thread = boot_thread_bytes_get();
+  if (thread == NULL)
+  {
+    return;
+  }
+  boot_category_counters_t *counters = &thread->categories[category];
+  if (count > 0)
+  {
+    BOOT_COUNTER_ADD(counters->allocations, 1);
+  }
+  else if (count < 0)
+  {
+    BOOT_COUNTER_ADD(counters->frees, 1);
+  }
+  if (bytes >= 0)
+  {
+    BOOT_COUNTER_ADD(counters->allocated_bytes, bytes);
+  }
+  else
+  {
+    BOOT_COUNTER_ADD(counters->freed_bytes, -bytes);
+  }
+}
+
+/* Object payloads big enough get a mapping of their own, see
+   largespace.h. Headers and stack buffers always stay in malloc. */
+static bool boot_is_large(size_t size, boot_category_t category)
+{
+  return size >= SNEK_LARGE_OBJECT_THRESHOLD &&
+         (category == BOOT_CATEGORY_STRING || category == BOOT_CATEGORY_ARRAY);
+}
+
+static void *boot_track(boot_header_t *header, size_t size,
+                        boot_category_t category, uint32_t site, bool large)
+{
+  if (header == NULL)
+  {
+    return NULL;
+  }
+  atomic_fetch_add_explicit(&allocation_count, 1, memory_order_relaxed);
+  header->site = site;
+  header->sample = heap_sample_on_alloc(size);
+  header->size = size;
+  header->large = large;
+  header->category = category;
+  boot_account(category, 1, (int64_t)size);
+  boot_site_charge(site, 1, (int64_t)size);
+  return header + 1;
+}
+
+static void *boot_malloc_site(size_t size, boot_category_t category,
+                              uint32_t site)
+{
+  if (size > SIZE_MAX - sizeof(boot_header_t))
+  {
+    return NULL;
+  }
+  if (boot_is_large(size, category))
+  {
+    return boot_track(large_space_map(sizeof(boot_header_t) + size), size,
+                      category, site, true);
+  }
+  return boot_track(malloc(sizeof(boot_header_t) + size), size, category,
+                    site, false);
+}
+
+static void *boot_calloc_site(size_t num, size_t size,
+                              boot_category_t category, uint32_t site)
+{
+  if (size != 0 && num > (SIZE_MAX - sizeof(boot_header_t)) / size)
+  {
+    return NULL;
+  }
+  /* Mappings start zeroed */
+  if (boot_is_large(num * size, category))
+  {
+    return boot_track(large_space_map(sizeof(boot_header_t) + num * size),
+                      num * size, category, site, true);
+  }
+  return boot_track(calloc(1, sizeof(boot_header_t) + num * size), num * size,
+                    category, site, false);
+}
+
+static void *boot_realloc_site(void *ptr, size_t size,
+                               boot_category_t category, const char *file,
+                               int line, void *caller)
 {
   if (ptr == NULL)
   {
-    allocation_count++;
+    return boot_malloc_site(size, category,
+                            boot_site_for(file, line, caller));
+  }
+
+  if (size > SIZE_MAX - sizeof(boot_header_t))
+  {
+    return NULL;
   }
-  return realloc(ptr, size);
+
+  /* The block stays charged to the site that first allocated it */
+  boot_header_t *header = (boot_header_t *)ptr - 1;
+  uint32_t site = header->site;
+  size_t old_size = header->size;
+  header = header->large
+               ? large_space_remap(header, sizeof(boot_header_t) + size)
+               : realloc(header, sizeof(boot_header_t) + size);
+  if (header == NULL)
+  {
+    return NULL;
+  }
+  header->size = size;
+  int64_t delta = (int64_t)size - (int64_t)old_size;
+  boot_account(header->category, 0, delta);
+  boot_site_charge(site, 0, delta);
+  return header + 1;
+}
+
+void *boot_malloc_at(size_t size, boot_category_t category, const char *file,
+                     int line)
+{
+  return boot_malloc_site(size, category, boot_site_for(file, line, NULL));
+}
+
+void *boot_calloc_at(size_t num, size_t size, boot_category_t category,
+                     const char *file, int line)
+{
+  return boot_calloc_site(num, size, category,
+                          boot_site_for(file, line, NULL));
+}
+
+void *boot_realloc_at(void *ptr, size_t size, boot_category_t category,
+                      const char *file, int line)
+{
+  return boot_realloc_site(ptr, size, category, file, line, NULL);
+}
+
+void *boot_malloc(size_t size)
+{
+  return boot_malloc_site(
+      size, BOOT_CATEGORY_OTHER,
+      boot_site_for(NULL, 0, __builtin_return_address(0)));
+}
+
+void *boot_calloc(size_t num, size_t size)
+{
+  return boot_calloc_site(
+      num, size, BOOT_CATEGORY_OTHER,
+      boot_site_for(NULL, 0, __builtin_return_address(0)));
+}
+
+void *boot_realloc(void *ptr, size_t size)
+{
+  return boot_realloc_site(ptr, size, BOOT_CATEGORY_OTHER, NULL, 0,
+                           __builtin_return_address(0));
 }
 
 void boot_free(void *ptr)
 {
   if (ptr != NULL)
   {
-    allocation_count--;
-    free(ptr);
+    boot_header_t *header = (boot_header_t *)ptr - 1;
+    boot_account(header->category, -1, -(int64_t)header->size);
+    boot_site_charge(header->site, -1, -(int64_t)header->size);
+    heap_sample_on_free(header->sample);
+    atomic_fetch_sub_explicit(&allocation_count, 1, memory_order_relaxed);
+    /* Unmapped pages fault on any access, no need to poison them */
+    if (header->large)
+    {
+      large_space_unmap(header);
+      return;
+    }
+    if (atomic_load_explicit(&boot_poisoning, memory_order_relaxed))
+    {
+      memset(ptr, BOOT_POISON_BYTE, header->size);
+    }
+    free(header);
   }
 }
 
+bool boot_trim(void)
+{
+#ifdef __GLIBC__
+  /* Since glibc 2.8 this madvises every free page of every arena, not
+     just the top of the main heap */
+  return malloc_trim(0) != 0;
+#else
+  return false;
+#endif
+}
+
 int boot_all_freed(void)
 {
-  if (allocation_count != 0)
+  int count = atomic_load(&allocation_count);
+  if (count != 0)
+  {
+    printf("[bootmem]: %d unfreed allocations, %zu bytes\n", count,
+           boot_current_bytes());
+  }
+  return count == 0;
+}
+
+void boot_mem_stats(boot_category_t category, boot_mem_stats_t *out)
+{
+  memset(out, 0, sizeof(*out));
+  out->current_bytes = atomic_load(&boot_current[category]);
+  out->peak_bytes = atomic_load(&boot_peak[category]);
+
+  unsigned first = category == BOOT_CATEGORY_ALL ? 0 : category;
+  unsigned last = category == BOOT_CATEGORY_ALL ? BOOT_CATEGORY_COUNT - 1
+                                                : category;
+  for (boot_thread_bytes_t *thread = atomic_load(&boot_all_thread_bytes);
+       thread != NULL; thread = thread->next)
+  {
+    for (unsigned i = first; i <= last; i++)
+    {
+      boot_category_counters_t *counters = &thread->categories[i];
+      out->allocated_bytes += atomic_load_explicit(&counters->allocated_bytes,
+                                                   memory_order_relaxed);
+      out->freed_bytes +=
+          atomic_load_explicit(&counters->freed_bytes, memory_order_relaxed);
+      out->allocations +=
+          atomic_load_explicit(&counters->allocations, memory_order_relaxed);
+      out->frees +=
+          atomic_load_explicit(&counters->frees, memory_order_relaxed);
+    }
+  }
+}
+
+size_t boot_current_bytes(void)
+{
+  return atomic_load_explicit(&boot_current[BOOT_CATEGORY_ALL],
+                              memory_order_relaxed);
+}
+
+void boot_mem_reset_peak(void)
+{
+  for (size_t i = 0; i <= BOOT_CATEGORY_COUNT; i++)
+  {
+    atomic_store(&boot_peak[i], atomic_load(&boot_current[i]));
+  }
+}
+
+const char *boot_category_name(boot_category_t category)
+{
+  static const char *names[] = {"other", "object", "string", "array",
+                                "stack", "all"};
+  return category <= BOOT_CATEGORY_ALL ? names[category] : "unknown";
+}
+
+void boot_poison_enable(bool enabled)
+{
+  atomic_store(&boot_poisoning, enabled);
+}
+
+bool boot_poison_enabled(void)
+{
+  return atomic_load(&boot_poisoning);
+}
+
+void boot_profile_enable(bool enabled)
+{
+  atomic_store(&boot_profiling, enabled);
+}
+
+bool boot_profile_enabled(void)
+{
+  return atomic_load_explicit(&boot_profiling, memory_order_relaxed);
+}
+
+boot_site_scope_t boot_site_enter(void *caller)
+{
+  boot_site_scope_t scope = {false};
+  if (boot_site_current == BOOT_SITE_NONE &&
+      atomic_load_explicit(&boot_profiling, memory_order_relaxed))
+  {
+    boot_site_current = boot_site_lookup((uintptr_t)caller);
+    scope.active = true;
+  }
+  return scope;
+}
+
+void boot_site_leave(boot_site_scope_t *scope)
+{
+  if (scope->active)
+  {
+    boot_site_current = BOOT_SITE_NONE;
+  }
+}
+
+void boot_profile_reset(void)
+{
+  for (boot_thread_sites_t *thread = atomic_load(&boot_all_thread_sites);
+       thread != NULL; thread = thread->next)
+  {
+    for (size_t i = 0; i <= BOOT_SITE_CAPACITY; i++)
+    {
+      boot_site_counters_t *counters = &thread->sites[i];
+      atomic_store(&counters->allocations, 0);
+      atomic_store(&counters->total_bytes, 0);
+      atomic_store(&counters->live_count, 0);
+      atomic_store(&counters->live_bytes, 0);
+    }
+  }
+}
+
+static boot_site_stats_t boot_site_snapshot(size_t site)
+{
+  boot_site_stats_t stats = {0};
+  uintptr_t key =
+      site == BOOT_SITE_OVERFLOW ? 0 : atomic_load(&boot_site_keys[site]);
+  if (site == BOOT_SITE_OVERFLOW)
+  {
+    stats.file = "(other sites)";
+  }
+  else if (key >> BOOT_SITE_LINE_SHIFT)
+  {
+    stats.file =
+        (const char *)(key & (((uintptr_t)1 << BOOT_SITE_LINE_SHIFT) - 1));
+    stats.line = (int)(key >> BOOT_SITE_LINE_SHIFT) & BOOT_SITE_LINE_MASK;
+  }
+  else
+  {
+    stats.caller = (void *)key;
+  }
+
+  for (boot_thread_sites_t *thread = atomic_load(&boot_all_thread_sites);
+       thread != NULL; thread = thread->next)
+  {
+    boot_site_counters_t *counters = &thread->sites[site];
+    stats.allocations += atomic_load_explicit(&counters->allocations,
+                                              memory_order_relaxed);
+    stats.total_bytes += atomic_load_explicit(&counters->total_bytes,
+                                              memory_order_relaxed);
+    stats.live_count +=
+        atomic_load_explicit(&counters->live_count, memory_order_relaxed);
+    stats.live_bytes +=
+        atomic_load_explicit(&counters->live_bytes, memory_order_relaxed);
+  }
+  return stats;
+}
+
+static int boot_compare_live_bytes(const void *a, const void *b)
+{
+  int64_t left = ((const boot_site_stats_t *)a)->live_bytes;
+  int64_t right = ((const boot_site_stats_t *)b)->live_bytes;
+  return left < right ? 1 : left > right ? -1 : 0;
+}
+
+size_t boot_profile_sites(boot_site_stats_t *out, size_t max)
+{
+  boot_site_stats_t *all =
+      malloc((BOOT_SITE_CAPACITY + 1) * sizeof(boot_site_stats_t));
+  if (all == NULL)
+  {
+    return 0;
+  }
+
+  size_t count = 0;
+  for (size_t i = 0; i <= BOOT_SITE_CAPACITY; i++)
+  {
+    if (i == BOOT_SITE_OVERFLOW || atomic_load(&boot_site_keys[i]) != 0)
+    {
+      boot_site_stats_t stats = boot_site_snapshot(i);
+      if (stats.allocations > 0)
+      {
+        all[count++] = stats;
+      }
+    }
+  }
+
+  qsort(all, count, sizeof(boot_site_stats_t), boot_compare_live_bytes);
+  if (count > max)
+  {
+    count = max;
+  }
+  memcpy(out, all, count * sizeof(boot_site_stats_t));
+  free(all);
+  return count;
+}
+
+static void boot_describe_caller(void *caller, char *buffer, size_t size)
+{
+  Dl_info info;
+  if (dladdr(caller, &info) == 0 || info.dli_fname == NULL)
+  {
+    snprintf(buffer, size, "%p", caller);
+  }
+  else if (info.dli_sname != NULL)
+  {
+    snprintf(buffer, size, "%s+0x%lx", info.dli_sname,
+             (unsigned long)((char *)caller - (char *)info.dli_saddr));
+  }
+  else
+  {
+    /* Module offsets resolve with addr2line */
+    const char *name = strrchr(info.dli_fname, '/');
+    snprintf(buffer, size, "%s+0x%lx", name ? name + 1 : info.dli_fname,
+             (unsigned long)((char *)caller - (char *)info.dli_fbase));
+  }
+}
+
+void boot_profile_report(FILE *out, size_t top)
+{
+  boot_site_stats_t *sites = malloc(top * sizeof(boot_site_stats_t));
+  if (sites == NULL)
+  {
+    return;
+  }
+  size_t count = boot_profile_sites(sites, top);
+
+  fprintf(out, "%14s %10s %10s %14s  %s\n", "live bytes", "live", "allocs",
+          "total bytes", "site");
+  for (size_t i = 0; i < count; i++)
   {
-    printf("[bootmem]: %d unfreed allocations\n",
-           allocation_count);
+    char where[256];
+    if (sites[i].caller != NULL)
+    {
+      boot_describe_caller(sites[i].caller, where, sizeof(where));
+    }
+    else if (sites[i].line == 0)
+    {
+      snprintf(where, sizeof(where), "%s", sites[i].file);
+    }
+    else
+    {
+      snprintf(where, sizeof(where), "%s:%d", sites[i].file, sites[i].line);
+    }
+    fprintf(out, "%14lld %10lld %10llu %14llu  %s\n",
+            (long long)sites[i].live_bytes, (long long)sites[i].live_count,
+            (unsigned long long)sites[i].allocations,
+            (unsigned long long)sites[i].total_bytes, where);
   }
-  return allocation_count == 0;
+  free(sites);
 }
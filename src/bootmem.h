@@ -4,6 +4,8 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 
 /* Tracking allocation functions */
 void *boot_malloc(size_t size);
@@ -11,16 +13,131 @@ void *boot_calloc(size_t num, size_t size);
 void *boot_realloc(void *ptr, size_t size);
 void boot_free(void *ptr);
 
+/* Every block is accounted to one category. The plain functions charge
+   BOOT_CATEGORY_OTHER. STRING and ARRAY blocks of at least
+   SNEK_LARGE_OBJECT_THRESHOLD bytes are mapped by the large-object space
+   (largespace.h), and still accounted here. */
+typedef enum BootCategory
+{
+  BOOT_CATEGORY_OTHER,
+  /* Object headers */
+  BOOT_CATEGORY_OBJECT,
+  /* String characters */
+  BOOT_CATEGORY_STRING,
+  /* Array buffers, typed arrays and vector nodes */
+  BOOT_CATEGORY_ARRAY,
+  /* stack_t and its buffer */
+  BOOT_CATEGORY_STACK,
+  BOOT_CATEGORY_COUNT
+} boot_category_t;
+
+/* Selects the sum over every category in boot_mem_stats */
+#define BOOT_CATEGORY_ALL BOOT_CATEGORY_COUNT
+
+/* Same, charging `category` and attributing the allocation to
+   `file`:`line` while profiling. A reallocated block keeps the category
+   it was allocated with. */
+void *boot_malloc_at(size_t size, boot_category_t category, const char *file,
+                     int line);
+void *boot_calloc_at(size_t num, size_t size, boot_category_t category,
+                     const char *file, int line);
+void *boot_realloc_at(void *ptr, size_t size, boot_category_t category,
+                      const char *file, int line);
+
+/* Fills blocks with BOOT_POISON_BYTE as they are freed, so reads through
+   dangling pointers see garbage instead of the old contents */
+#define BOOT_POISON_BYTE 0xdb
+void boot_poison_enable(bool enabled);
+bool boot_poison_enabled(void);
+
+/* Hands whole free pages in malloc's arenas back to the OS, returns true
+   when any were released. Does nothing outside glibc. */
+bool boot_trim(void);
+
 /* Memory tracking check */
 int boot_all_freed(void);
 bool boot_is_freed(void *ptr);
 
-/* Macros to replace malloc/free in your code */
+/* Byte accounting, always on. Reallocating counts the growth as
+   allocated bytes and the shrinkage as freed bytes, so allocated minus
+   freed is always the current size. */
+typedef struct BootMemStats
+{
+  size_t current_bytes;
+  /* Highest current_bytes since start or the last peak reset */
+  size_t peak_bytes;
+  uint64_t allocated_bytes;
+  uint64_t freed_bytes;
+  uint64_t allocations;
+  uint64_t frees;
+} boot_mem_stats_t;
+
+/* `category` may be BOOT_CATEGORY_ALL */
+void boot_mem_stats(boot_category_t category, boot_mem_stats_t *out);
+/* Bytes currently allocated across every category */
+size_t boot_current_bytes(void);
+/* Restarts every high-water mark from the current size */
+void boot_mem_reset_peak(void);
+const char *boot_category_name(boot_category_t category);
+
+/* Allocation-site profiling. Sites are either a file and line, or the
+   caller of a function that opened a BOOT_SITE_SCOPE, so everything a
+   constructor allocates is charged to whoever called it. */
+typedef struct BootSiteStats
+{
+  /* Set for file sites */
+  const char *file;
+  int line;
+  /* Set for caller sites */
+  void *caller;
+  uint64_t allocations;
+  uint64_t total_bytes;
+  /* Allocations freed after a reset can take these below zero */
+  int64_t live_count;
+  int64_t live_bytes;
+} boot_site_stats_t;
+
+void boot_profile_enable(bool enabled);
+bool boot_profile_enabled(void);
+/* Zeroes every site's counters */
+void boot_profile_reset(void);
+/* Fills `out` with up to `max` sites, most live bytes first, and returns
+   how many were written */
+size_t boot_profile_sites(boot_site_stats_t *out, size_t max);
+void boot_profile_report(FILE *out, size_t top);
+
+typedef struct BootSiteScope
+{
+  bool active;
+} boot_site_scope_t;
+
+boot_site_scope_t boot_site_enter(void *caller);
+void boot_site_leave(boot_site_scope_t *scope);
+
+/* Charges allocations made until the enclosing function returns to its
+   caller. Nested scopes keep the outermost caller. */
+#define BOOT_SITE_SCOPE()                                                   \
+  boot_site_scope_t boot_site_scope                                         \
+      __attribute__((cleanup(boot_site_leave))) =                           \
+          boot_site_enter(__builtin_return_address(0))
+
+/* Macros to replace malloc/free in your code. Define BOOT_CATEGORY
+   before including this header to change what a file is charged to. */
 #ifndef BOOTMEM_IMPLEMENTATION
-#define malloc boot_malloc
-#define calloc boot_calloc
-#define realloc boot_realloc
+#ifndef BOOT_CATEGORY
+#define BOOT_CATEGORY BOOT_CATEGORY_OTHER
+#endif
+#define malloc(size) boot_malloc_at((size), BOOT_CATEGORY, __FILE__, __LINE__)
+#define calloc(num, size)                                                   \
+  boot_calloc_at((num), (size), BOOT_CATEGORY, __FILE__, __LINE__)
+#define realloc(ptr, size)                                                  \
+  boot_realloc_at((ptr), (size), BOOT_CATEGORY, __FILE__, __LINE__)
 #define free boot_free
+/* For allocations charged differently from the rest of their file */
+#define malloc_as(category, size)                                           \
+  boot_malloc_at((size), (category), __FILE__, __LINE__)
+#define calloc_as(category, num, size)                                      \
+  boot_calloc_at((num), (size), (category), __FILE__, __LINE__)
 #endif
 
 #endif
@@ -0,0 +1,50 @@
+#include <time.h>
+
+#include "gcstats.h"
+
+uint64_t gc_stats_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+int gc_stats_bucket(uint64_t pause_ns) {
+  int bucket = 63 - __builtin_clzll(pause_ns | 1);
+  return bucket < GC_PAUSE_BUCKETS ? bucket : GC_PAUSE_BUCKETS - 1;
+}
+
+void gc_stats_record_pause(gc_stats_t *stats, uint64_t pause_ns) {
+  stats->collections++;
+  stats->pause_total_ns += pause_ns;
+  stats->pause_last_ns = pause_ns;
+  if (pause_ns > stats->pause_max_ns) {
+    stats->pause_max_ns = pause_ns;
+  }
+  stats->pause_histogram[gc_stats_bucket(pause_ns)]++;
+}
+
+uint64_t gc_stats_percentile(const gc_stats_t *stats, double q) {
+  uint64_t total = 0;
+  for (int i = 0; i < GC_PAUSE_BUCKETS; i++) {
+    total += stats->pause_histogram[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+
+  // Smallest bucket holding the ceil(q * total)-th pause
+  uint64_t rank = (uint64_t)(q * (double)total);
+  if ((double)rank < q * (double)total || rank == 0) {
+    rank++;
+  }
+
+  uint64_t seen = 0;
+  for (int i = 0; i < GC_PAUSE_BUCKETS; i++) {
+    seen += stats->pause_histogram[i];
+    if (seen >= rank) {
+      uint64_t upper = i + 1 < 64 ? (uint64_t)1 << (i + 1) : UINT64_MAX;
+      return upper < stats->pause_max_ns ? upper : stats->pause_max_ns;
+    }
+  }
+  return stats->pause_max_ns;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/// Pause histogram bucket `i` counts collections that took
+/// [2^i, 2^(i+1)) nanoseconds, the last bucket also takes anything longer
+#define GC_PAUSE_BUCKETS 48
+
+typedef struct GcStats {
+  uint64_t collections;
+
+  /// Cumulative time spent in each phase
+  uint64_t mark_ns;
+  uint64_t trace_ns;
+  uint64_t sweep_ns;
+  uint64_t pause_total_ns;
+  uint64_t pause_last_ns;
+  /// Time from a shared VM requesting a stop until every other mutator
+  /// had parked, not included in the pauses above
+  uint64_t safepoint_total_ns;
+  uint64_t safepoint_max_ns;
+  /// Scavenger runs, see `vm_scavenge`. One that follows a sweep is part
+  /// of that collection's pause, the phase times above leave it out.
+  uint64_t scavenges;
+  uint64_t scavenge_ns;
+  /// Stack buffer bytes the scavenger gave back
+  uint64_t scavenged_bytes;
+
+  /// Cumulative over all collections
+  uint64_t objects_freed;
+  uint64_t bytes_freed;
+  /// Left alive by the last collection
+  uint64_t objects_survived;
+  uint64_t bytes_survived;
+
+  /// Filled in by `vm_gc_stats` from the live objects
+  uint64_t heap_objects;
+  uint64_t heap_bytes;
+
+  /// Filled in by `vm_gc_stats` from the histogram, percentiles are
+  /// bucket upper bounds capped at the max
+  uint64_t pause_p50_ns;
+  uint64_t pause_p99_ns;
+  uint64_t pause_max_ns;
+  uint64_t pause_histogram[GC_PAUSE_BUCKETS];
+} gc_stats_t;
+
+/// Monotonic clock in nanoseconds
+uint64_t gc_stats_now_ns(void);
+
+void gc_stats_record_pause(gc_stats_t *stats, uint64_t pause_ns);
+int gc_stats_bucket(uint64_t pause_ns);
+/// Pause at quantile `q` in [0, 1], 0 before the first collection
+uint64_t gc_stats_percentile(const gc_stats_t *stats, double q);
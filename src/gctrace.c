@@ -0,0 +1,147 @@
+#include "bootmem.h"
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "gcstats.h"
+#include "gctrace.h"
+
+// Bounded multi-producer queue after Vyukov. A slot whose sequence equals
+// the head position is free to write; once written its sequence becomes
+// position + 1, which is what the consumer waits for, and reading it sets
+// the sequence a whole lap ahead for the next producer.
+
+static _Thread_local uint32_t gc_trace_tid;
+
+static uint32_t gc_tracer_tid(void) {
+  if (gc_trace_tid == 0) {
+    gc_trace_tid = (uint32_t)syscall(SYS_gettid);
+  }
+  return gc_trace_tid;
+}
+
+gc_tracer_t *gc_tracer_new(const char *path, size_t capacity) {
+  size_t size = 2;
+  while (size < capacity) {
+    size <<= 1;
+  }
+
+  gc_tracer_t *tracer = calloc(1, sizeof(gc_tracer_t));
+  if (tracer == NULL) {
+    return NULL;
+  }
+  tracer->slots = calloc(size, sizeof(gc_trace_slot_t));
+  if (tracer->slots == NULL) {
+    free(tracer);
+    return NULL;
+  }
+  tracer->out = fopen(path, "w");
+  if (tracer->out == NULL) {
+    free(tracer->slots);
+    free(tracer);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < size; i++) {
+    atomic_init(&tracer->slots[i].sequence, i);
+  }
+  tracer->mask = size - 1;
+  tracer->pid = getpid();
+  tracer->first = true;
+  fputs("[\n", tracer->out);
+  return tracer;
+}
+
+void gc_tracer_free(gc_tracer_t *tracer) {
+  if (tracer == NULL) {
+    return;
+  }
+
+  gc_tracer_flush(tracer);
+  fputs("\n]\n", tracer->out);
+  fclose(tracer->out);
+  free(tracer->slots);
+  free(tracer);
+}
+
+static void gc_tracer_record(gc_tracer_t *tracer, char phase, const char *name,
+                             int64_t value) {
+  size_t pos = atomic_load_explicit(&tracer->head, memory_order_relaxed);
+  gc_trace_slot_t *slot;
+  for (;;) {
+    slot = &tracer->slots[pos & tracer->mask];
+    size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&tracer->head, &pos, pos + 1,
+                                                memory_order_relaxed,
+                                                memory_order_relaxed)) {
+        break;
+      }
+    } else if (diff < 0) {
+      atomic_fetch_add_explicit(&tracer->dropped, 1, memory_order_relaxed);
+      return;
+    } else {
+      pos = atomic_load_explicit(&tracer->head, memory_order_relaxed);
+    }
+  }
+
+  slot->ts_ns = gc_stats_now_ns();
+  slot->tid = gc_tracer_tid();
+  slot->phase = phase;
+  slot->name = name;
+  slot->value = value;
+  atomic_store_explicit(&slot->sequence, pos + 1, memory_order_release);
+}
+
+void gc_tracer_begin(gc_tracer_t *tracer, const char *name) {
+  gc_tracer_record(tracer, 'B', name, 0);
+}
+
+void gc_tracer_end(gc_tracer_t *tracer, const char *name) {
+  gc_tracer_record(tracer, 'E', name, 0);
+}
+
+void gc_tracer_counter(gc_tracer_t *tracer, const char *name, int64_t value) {
+  gc_tracer_record(tracer, 'C', name, value);
+}
+
+static void gc_tracer_write(gc_tracer_t *tracer, gc_trace_slot_t *slot) {
+  if (!tracer->first) {
+    fputs(",\n", tracer->out);
+  }
+  tracer->first = false;
+
+  // Trace event timestamps are in microseconds
+  fprintf(tracer->out,
+          "{\"name\":\"%s\",\"cat\":\"gc\",\"ph\":\"%c\",\"ts\":%.3f,"
+          "\"pid\":%d,\"tid\":%u",
+          slot->name, slot->phase, (double)slot->ts_ns / 1000.0, tracer->pid,
+          slot->tid);
+  if (slot->phase == 'C') {
+    fprintf(tracer->out, ",\"args\":{\"value\":%lld}", (long long)slot->value);
+  }
+  fputc('}', tracer->out);
+}
+
+bool gc_tracer_flush(gc_tracer_t *tracer) {
+  size_t pos = atomic_load_explicit(&tracer->tail, memory_order_relaxed);
+  for (;;) {
+    gc_trace_slot_t *slot = &tracer->slots[pos & tracer->mask];
+    size_t seq = atomic_load_explicit(&slot->sequence, memory_order_acquire);
+    if (seq != pos + 1) {
+      // Empty, or the producer that claimed this slot is still writing it
+      break;
+    }
+
+    gc_tracer_write(tracer, slot);
+    atomic_store_explicit(&slot->sequence, pos + tracer->mask + 1,
+                          memory_order_release);
+    pos++;
+  }
+  atomic_store_explicit(&tracer->tail, pos, memory_order_relaxed);
+  return fflush(tracer->out) == 0;
+}
+
+uint64_t gc_tracer_dropped(gc_tracer_t *tracer) {
+  return atomic_load_explicit(&tracer->dropped, memory_order_relaxed);
+}
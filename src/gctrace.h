@@ -0,0 +1,55 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/// Chrome/Perfetto trace events for collector phases. Events are written
+/// into a bounded lock-free ring by any thread and only formatted as JSON
+/// when the ring is flushed, so recording costs a few stores per event.
+/// When the ring is full new events are dropped and counted.
+
+typedef struct GcTraceSlot {
+  // Ring position this slot is ready for, see gctrace.c
+  atomic_size_t sequence;
+  uint64_t ts_ns;
+  uint32_t tid;
+  // 'B' begin, 'E' end, 'C' counter
+  char phase;
+  // Must be a string literal or otherwise outlive the tracer
+  const char *name;
+  int64_t value;
+} gc_trace_slot_t;
+
+typedef struct GcTracer {
+  FILE *out;
+  bool first;
+  int pid;
+  size_t mask;
+  gc_trace_slot_t *slots;
+  // Producers and the flushing consumer each get their own cache line.
+  // Padded a line apart rather than aligned, the tracer comes from malloc
+  // which only guarantees 16 bytes.
+  atomic_size_t head;
+  char head_pad[64 - sizeof(atomic_size_t)];
+  atomic_size_t tail;
+  char tail_pad[64 - sizeof(atomic_size_t)];
+  atomic_uint_fast64_t dropped;
+} gc_tracer_t;
+
+/// Opens `path` for writing and sets up a ring of `capacity` events,
+/// rounded up to a power of two
+gc_tracer_t *gc_tracer_new(const char *path, size_t capacity);
+/// Flushes, terminates the JSON array and closes the file
+void gc_tracer_free(gc_tracer_t *tracer);
+
+void gc_tracer_begin(gc_tracer_t *tracer, const char *name);
+void gc_tracer_end(gc_tracer_t *tracer, const char *name);
+void gc_tracer_counter(gc_tracer_t *tracer, const char *name, int64_t value);
+
+/// Writes every buffered event to the file. Recording may continue on
+/// other threads, but only one thread may flush at a time.
+bool gc_tracer_flush(gc_tracer_t *tracer);
+uint64_t gc_tracer_dropped(gc_tracer_t *tracer);
@@ -0,0 +1,377 @@
+#include <execinfo.h>
+#include <math.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "heapsample.h"
+
+// Sample ids are serial numbers that keep counting across sessions, a
+// session's samples start after `heap_sample_base`. Blocks sampled in an
+// earlier session fall outside that range and are ignored when freed.
+#define HEAP_SAMPLE_MAX ((1u << 24) - 1)
+#define HEAP_SAMPLE_LIVE UINT64_MAX
+// Samples a thread took that no heap has claimed yet
+#define HEAP_SAMPLE_PENDING 8
+// Frames of the profiler itself at the top of every backtrace
+#define HEAP_SAMPLE_SKIP 2
+
+typedef struct HeapSample {
+  size_t size;
+  double weight;
+  // Owner whose collections `born` and `died` count, NULL until claimed
+  const void *heap;
+  // Collections completed when the block was allocated and freed
+  uint64_t born;
+  uint64_t died;
+  int depth;
+  void *frames[HEAP_SAMPLE_DEPTH];
+} heap_sample_t;
+
+typedef struct HeapSampleHeap {
+  const void *heap;
+  uint64_t collections;
+} heap_sample_heap_t;
+
+static atomic_bool heap_sampling;
+static atomic_uint heap_sample_session;
+static _Atomic uint64_t heap_sample_seed_value;
+static size_t heap_sample_mean = 512 * 1024;
+
+static pthread_mutex_t heap_sample_lock = PTHREAD_MUTEX_INITIALIZER;
+static heap_sample_t *heap_samples;
+static size_t heap_sample_count;
+static size_t heap_sample_capacity;
+static uint32_t heap_sample_base;
+// Collections of every heap, for samples no heap claimed
+static uint64_t heap_sample_collections;
+static heap_sample_heap_t *heap_sample_heaps;
+static size_t heap_sample_heap_count;
+static size_t heap_sample_heap_capacity;
+
+static _Thread_local int64_t heap_sample_countdown;
+static _Thread_local unsigned heap_sample_thread_session;
+static _Thread_local uint64_t heap_sample_rng;
+static _Thread_local uint32_t heap_sample_pending[HEAP_SAMPLE_PENDING];
+static _Thread_local size_t heap_sample_pending_count;
+
+static double heap_sample_uniform(void) {
+  if (heap_sample_rng == 0) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    heap_sample_rng = ((uint64_t)ts.tv_nsec << 20) ^
+                      (uint64_t)(uintptr_t)&heap_sample_rng ^
+                      0x9e3779b97f4a7c15ull;
+  }
+  // xorshift64*, top 53 bits into (0, 1]
+  heap_sample_rng ^= heap_sample_rng >> 12;
+  heap_sample_rng ^= heap_sample_rng << 25;
+  heap_sample_rng ^= heap_sample_rng >> 27;
+  uint64_t bits = (heap_sample_rng * 0x2545f4914f6cdd1dull) >> 11;
+  return (double)(bits + 1) / 9007199254740992.0;
+}
+
+// Exponential gaps between sampled bytes make sampling a Poisson process
+static int64_t heap_sample_interval(void) {
+  double gap = -log(heap_sample_uniform()) * (double)heap_sample_mean;
+  return gap < 1.0 ? 1 : (int64_t)gap;
+}
+
+void heap_sample_start(size_t mean_bytes) {
+  pthread_mutex_lock(&heap_sample_lock);
+  heap_sample_mean = mean_bytes > 0 ? mean_bytes : 1;
+  // One past the last id, so a session without samples still moves it
+  heap_sample_base += (uint32_t)heap_sample_count + 1;
+  heap_sample_count = 0;
+  heap_sample_heap_count = 0;
+  atomic_fetch_add(&heap_sample_session, 1);
+  pthread_mutex_unlock(&heap_sample_lock);
+  atomic_store(&heap_sampling, true);
+}
+
+void heap_sample_seed(uint64_t seed) {
+  atomic_store(&heap_sample_seed_value, seed);
+}
+
+void heap_sample_stop(void) { atomic_store(&heap_sampling, false); }
+
+bool heap_sample_enabled(void) {
+  return atomic_load_explicit(&heap_sampling, memory_order_relaxed);
+}
+
+// Called with the lock held
+static heap_sample_heap_t *heap_sample_find_heap(const void *heap) {
+  for (size_t i = 0; i < heap_sample_heap_count; i++) {
+    if (heap_sample_heaps[i].heap == heap) {
+      return &heap_sample_heaps[i];
+    }
+  }
+  return NULL;
+}
+
+// Collections `heap` has completed, called with the lock held
+static uint64_t heap_sample_clock(const void *heap) {
+  heap_sample_heap_t *entry = heap == NULL ? NULL : heap_sample_find_heap(heap);
+  return entry != NULL ? entry->collections : heap_sample_collections;
+}
+
+// Index of the sample `id` names in the current session, called with the
+// lock held
+static bool heap_sample_index(uint32_t id, size_t *index) {
+  uint32_t offset = id - heap_sample_base - 1;
+  if (id == 0 || offset >= heap_sample_count) {
+    return false;
+  }
+  *index = offset;
+  return true;
+}
+
+void heap_sample_collection(const void *heap) {
+  pthread_mutex_lock(&heap_sample_lock);
+  heap_sample_collections++;
+  heap_sample_heap_t *entry = heap_sample_find_heap(heap);
+  if (entry != NULL) {
+    entry->collections++;
+  }
+  pthread_mutex_unlock(&heap_sample_lock);
+}
+
+void heap_sample_claim(const void *heap) {
+  if (heap_sample_pending_count == 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&heap_sample_lock);
+  heap_sample_heap_t *entry = heap_sample_find_heap(heap);
+  if (entry == NULL &&
+      heap_sample_heap_count == heap_sample_heap_capacity) {
+    size_t capacity =
+        heap_sample_heap_capacity ? heap_sample_heap_capacity * 2 : 8;
+    heap_sample_heap_t *grown =
+        realloc(heap_sample_heaps, capacity * sizeof(heap_sample_heap_t));
+    if (grown != NULL) {
+      heap_sample_heaps = grown;
+      heap_sample_heap_capacity = capacity;
+    }
+  }
+  if (entry == NULL && heap_sample_heap_count < heap_sample_heap_capacity) {
+    entry = &heap_sample_heaps[heap_sample_heap_count++];
+    *entry = (heap_sample_heap_t){.heap = heap};
+  }
+
+  // Samples already freed keep the clock they died by
+  for (size_t i = 0; entry != NULL && i < heap_sample_pending_count; i++) {
+    size_t index;
+    if (heap_sample_index(heap_sample_pending[i], &index) &&
+        heap_samples[index].died == HEAP_SAMPLE_LIVE) {
+      heap_samples[index].heap = heap;
+      heap_samples[index].born = entry->collections;
+    }
+  }
+  pthread_mutex_unlock(&heap_sample_lock);
+  heap_sample_pending_count = 0;
+}
+
+__attribute__((noinline)) static uint32_t heap_sample_record(size_t size,
+                                                              unsigned session) {
+  heap_sample_t sample = {.size = size, .died = HEAP_SAMPLE_LIVE};
+  void *frames[HEAP_SAMPLE_DEPTH + HEAP_SAMPLE_SKIP];
+  int depth = backtrace(frames, HEAP_SAMPLE_DEPTH + HEAP_SAMPLE_SKIP);
+  if (depth > HEAP_SAMPLE_SKIP) {
+    sample.depth = depth - HEAP_SAMPLE_SKIP;
+    memcpy(sample.frames, frames + HEAP_SAMPLE_SKIP,
+           sample.depth * sizeof(void *));
+  }
+
+  pthread_mutex_lock(&heap_sample_lock);
+  if (session != atomic_load(&heap_sample_session) ||
+      heap_sample_count == HEAP_SAMPLE_MAX) {
+    pthread_mutex_unlock(&heap_sample_lock);
+    return 0;
+  }
+  if (heap_sample_count == heap_sample_capacity) {
+    size_t capacity = heap_sample_capacity ? heap_sample_capacity * 2 : 256;
+    heap_sample_t *grown =
+        realloc(heap_samples, capacity * sizeof(heap_sample_t));
+    if (grown == NULL) {
+      pthread_mutex_unlock(&heap_sample_lock);
+      return 0;
+    }
+    heap_samples = grown;
+    heap_sample_capacity = capacity;
+  }
+
+  double mean = (double)heap_sample_mean;
+  sample.weight = (double)size / -expm1(-(double)size / mean);
+  sample.born = heap_sample_collections;
+  uint32_t id = heap_sample_base + (uint32_t)heap_sample_count + 1;
+  if (id == 0) {
+    // The serial wrapped, 0 means not sampled
+    pthread_mutex_unlock(&heap_sample_lock);
+    return 0;
+  }
+  heap_samples[heap_sample_count++] = sample;
+  pthread_mutex_unlock(&heap_sample_lock);
+
+  if (heap_sample_pending_count < HEAP_SAMPLE_PENDING) {
+    heap_sample_pending[heap_sample_pending_count++] = id;
+  }
+  return id;
+}
+
+uint32_t heap_sample_on_alloc(size_t size) {
+  if (!atomic_load_explicit(&heap_sampling, memory_order_relaxed)) {
+    return 0;
+  }
+
+  unsigned session =
+      atomic_load_explicit(&heap_sample_session, memory_order_relaxed);
+  if (heap_sample_thread_session != session) {
+    heap_sample_thread_session = session;
+    uint64_t seed = atomic_load_explicit(&heap_sample_seed_value,
+                                         memory_order_relaxed);
+    if (seed != 0) {
+      heap_sample_rng = seed;
+    }
+    heap_sample_countdown = heap_sample_interval();
+  }
+
+  heap_sample_countdown -= (int64_t)size;
+  if (heap_sample_countdown > 0) {
+    return 0;
+  }
+  heap_sample_countdown = heap_sample_interval();
+  return heap_sample_record(size, session);
+}
+
+void heap_sample_on_free(uint32_t id) {
+  if (id == 0) {
+    return;
+  }
+
+  pthread_mutex_lock(&heap_sample_lock);
+  size_t index;
+  if (heap_sample_index(id, &index)) {
+    heap_samples[index].died = heap_sample_clock(heap_samples[index].heap);
+  }
+  pthread_mutex_unlock(&heap_sample_lock);
+}
+
+void heap_sample_stats(heap_sample_stats_t *out) {
+  memset(out, 0, sizeof(*out));
+
+  pthread_mutex_lock(&heap_sample_lock);
+  out->samples = heap_sample_count;
+  for (size_t i = 0; i < heap_sample_count; i++) {
+    heap_sample_t *sample = &heap_samples[i];
+    bool live = sample->died == HEAP_SAMPLE_LIVE;
+    uint64_t end = live ? heap_sample_clock(sample->heap) : sample->died;
+    out->allocated_bytes += sample->weight;
+    if (live) {
+      out->live_samples++;
+      out->live_bytes += sample->weight;
+    }
+    if (end > sample->born) {
+      out->survived_bytes += sample->weight;
+    } else if (!live) {
+      out->churned_bytes += sample->weight;
+    }
+  }
+  pthread_mutex_unlock(&heap_sample_lock);
+}
+
+typedef struct HeapSampleGroup {
+  size_t first;
+  size_t samples;
+  double allocated_bytes;
+  double live_bytes;
+  double survived_bytes;
+  uint64_t collections_survived;
+} heap_sample_group_t;
+
+static int heap_sample_compare_stacks(const void *a, const void *b) {
+  const heap_sample_t *left = a;
+  const heap_sample_t *right = b;
+  if (left->depth != right->depth) {
+    return left->depth < right->depth ? -1 : 1;
+  }
+  return memcmp(left->frames, right->frames, left->depth * sizeof(void *));
+}
+
+static int heap_sample_compare_groups(const void *a, const void *b) {
+  double left = ((const heap_sample_group_t *)a)->live_bytes;
+  double right = ((const heap_sample_group_t *)b)->live_bytes;
+  return left < right ? 1 : left > right ? -1 : 0;
+}
+
+void heap_sample_report(FILE *out, size_t top) {
+  // Work on a copy so allocation isn't blocked while symbolizing
+  pthread_mutex_lock(&heap_sample_lock);
+  size_t count = heap_sample_count;
+  heap_sample_t *samples = malloc((count + 1) * sizeof(heap_sample_t));
+  if (samples != NULL) {
+    memcpy(samples, heap_samples, count * sizeof(heap_sample_t));
+  }
+  pthread_mutex_unlock(&heap_sample_lock);
+
+  heap_sample_group_t *groups = malloc((count + 1) * sizeof(*groups));
+  if (samples == NULL || groups == NULL) {
+    free(samples);
+    free(groups);
+    return;
+  }
+
+  qsort(samples, count, sizeof(heap_sample_t), heap_sample_compare_stacks);
+  size_t group_count = 0;
+  // Only held for the clocks of live samples
+  pthread_mutex_lock(&heap_sample_lock);
+  for (size_t i = 0; i < count; i++) {
+    heap_sample_t *sample = &samples[i];
+    if (i == 0 || heap_sample_compare_stacks(&samples[i - 1], sample) != 0) {
+      groups[group_count++] = (heap_sample_group_t){.first = i};
+    }
+    heap_sample_group_t *group = &groups[group_count - 1];
+    bool live = sample->died == HEAP_SAMPLE_LIVE;
+    uint64_t end = live ? heap_sample_clock(sample->heap) : sample->died;
+    group->samples++;
+    group->allocated_bytes += sample->weight;
+    group->collections_survived += end - sample->born;
+    if (live) {
+      group->live_bytes += sample->weight;
+    }
+    if (end > sample->born) {
+      group->survived_bytes += sample->weight;
+    }
+  }
+  pthread_mutex_unlock(&heap_sample_lock);
+  qsort(groups, group_count, sizeof(*groups), heap_sample_compare_groups);
+
+  fprintf(out, "%zu samples, 1 per %zu bytes on average\n", count,
+          heap_sample_mean);
+  for (size_t i = 0; i < group_count && i < top; i++) {
+    heap_sample_group_t *group = &groups[i];
+    heap_sample_t *sample = &samples[group->first];
+    fprintf(out,
+            "\nlive ~%.0f bytes, allocated ~%.0f bytes, %.0f%% survived a "
+            "collection, %.1f collections on average (%zu samples)\n",
+            group->live_bytes, group->allocated_bytes,
+            100.0 * group->survived_bytes / group->allocated_bytes,
+            (double)group->collections_survived / group->samples,
+            group->samples);
+
+    char **symbols = backtrace_symbols(sample->frames, sample->depth);
+    for (int frame = 0; frame < sample->depth; frame++) {
+      if (symbols != NULL) {
+        fprintf(out, "    %s\n", symbols[frame]);
+      } else {
+        fprintf(out, "    %p\n", sample->frames[frame]);
+      }
+    }
+    free(symbols);
+  }
+
+  free(groups);
+  free(samples);
+}
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/// Sampling heap profiler. Allocated bytes are sampled as a Poisson
+/// process: one allocation roughly every `mean_bytes`, at randomized
+/// geometric intervals, so a block of `size` bytes is picked with
+/// probability 1 - exp(-size / mean_bytes) and weighted by the inverse.
+/// Each sample keeps a backtrace and the collections it lived through,
+/// which gives unbiased estimates of what is live and what churns.
+///
+/// Samples are taken in bootmem, so they cover `_new_snek_object` and
+/// every payload allocation a constructor makes.
+
+#define HEAP_SAMPLE_DEPTH 16
+
+typedef struct HeapSampleStats {
+  uint64_t samples;
+  uint64_t live_samples;
+  /// Estimates, in bytes, over the whole sampling session
+  double allocated_bytes;
+  double live_bytes;
+  /// Freed without surviving a single collection
+  double churned_bytes;
+  /// Alive after at least one collection
+  double survived_bytes;
+} heap_sample_stats_t;
+
+/// Starts a new session, dropping any previous samples
+void heap_sample_start(size_t mean_bytes);
+/// Seeds every thread's sampling intervals from the next session on, for
+/// reproducible tests. 0, the default, seeds them from the clock.
+void heap_sample_seed(uint64_t seed);
+void heap_sample_stop(void);
+bool heap_sample_enabled(void);
+
+void heap_sample_stats(heap_sample_stats_t *out);
+/// Groups samples by backtrace, largest estimated live bytes first
+void heap_sample_report(FILE *out, size_t top);
+
+/// Called by the collector after every sweep of `heap`
+void heap_sample_collection(const void *heap);
+/// Hands the samples the calling thread took since its last claim to
+/// `heap`, whose collections they count from then on. Samples nobody
+/// claims count the collections of every heap.
+void heap_sample_claim(const void *heap);
+
+/// Allocator hooks. `on_alloc` returns a non-zero id when the block was
+/// sampled, which must be handed to `on_free` when it is released.
+uint32_t heap_sample_on_alloc(size_t size);
+void heap_sample_on_free(uint32_t id);
@@ -0,0 +1,519 @@
+#include "bootmem.h"
+#include <stdio.h>
+#include <string.h>
+
+#include "heapsnapshot.h"
+#include "snekobject.h"
+#include "snekpvec.h"
+
+#define HEAP_SNAPSHOT_NONE UINT32_MAX
+
+// Pointer -> node index, open addressing over a power of two table.
+// Nodes are numbered by their place in a snapshot of the registry.
+typedef struct HeapIndex {
+  size_t mask;
+  snek_object_t **keys;
+  uint32_t *values;
+  snek_object_t **nodes;
+  uint32_t node_count;
+} heap_index_t;
+
+static size_t heap_index_slot(heap_index_t *index, snek_object_t *obj) {
+  uint64_t hash = ((uintptr_t)obj >> 4) * 0x9e3779b97f4a7c15ull;
+  size_t slot = (size_t)(hash >> 32) & index->mask;
+  while (index->keys[slot] != NULL && index->keys[slot] != obj) {
+    slot = (slot + 1) & index->mask;
+  }
+  return slot;
+}
+
+static bool heap_index_init(heap_index_t *index, registry_t *objects) {
+  size_t count = registry_count(objects);
+  size_t capacity = 16;
+  while (capacity < count * 2) {
+    capacity <<= 1;
+  }
+  index->mask = capacity - 1;
+  index->keys = calloc(capacity, sizeof(snek_object_t *));
+  index->values = malloc(capacity * sizeof(uint32_t));
+  index->nodes = malloc((count + 1) * sizeof(snek_object_t *));
+  if (index->keys == NULL || index->values == NULL || index->nodes == NULL) {
+    free(index->keys);
+    free(index->values);
+    free(index->nodes);
+    return false;
+  }
+
+  index->node_count = (uint32_t)registry_copy(objects, index->nodes, count);
+  for (uint32_t i = 0; i < index->node_count; i++) {
+    size_t slot = heap_index_slot(index, index->nodes[i]);
+    index->keys[slot] = index->nodes[i];
+    index->values[slot] = i;
+  }
+  return true;
+}
+
+static uint32_t heap_index_get(heap_index_t *index, snek_object_t *obj) {
+  if (obj == NULL) {
+    return HEAP_SNAPSHOT_NONE;
+  }
+  size_t slot = heap_index_slot(index, obj);
+  return index->keys[slot] == NULL ? HEAP_SNAPSHOT_NONE : index->values[slot];
+}
+
+static size_t heap_child_count(snek_object_t *obj) {
+  switch (obj->kind) {
+  case STRING:
+    return obj->data.v_string.rope != NULL ? 2 : 0;
+  case VECTOR3:
+    return 3;
+  case SLICE:
+    return 1;
+  case ARRAY:
+    return obj->data.v_array.size;
+  case PVECTOR:
+    return obj->data.v_pvec.size;
+  default:
+    return 0;
+  }
+}
+
+static snek_object_t *heap_child(snek_object_t *obj, size_t i) {
+  switch (obj->kind) {
+  case STRING:
+    return i == 0 ? obj->data.v_string.rope->left
+                  : obj->data.v_string.rope->right;
+  case VECTOR3:
+    return i == 0   ? obj->data.v_vector3.x
+           : i == 1 ? obj->data.v_vector3.y
+                    : obj->data.v_vector3.z;
+  case SLICE:
+    return obj->data.v_slice.parent;
+  case ARRAY:
+    return snek_array_get(obj, i);
+  case PVECTOR:
+    return snek_pvec_get(obj, i);
+  default:
+    return NULL;
+  }
+}
+
+static bool heap_snapshot_write(vm_t *vm, heap_index_t *index, FILE *out) {
+  uint32_t node_count = index->node_count;
+  uint32_t *degrees = calloc(node_count + 1, sizeof(uint32_t));
+  if (degrees == NULL) {
+    return false;
+  }
+
+  uint64_t edge_count = 0;
+  for (uint32_t i = 0; i < node_count; i++) {
+    snek_object_t *obj = index->nodes[i];
+    size_t count = heap_child_count(obj);
+    for (size_t j = 0; j < count; j++) {
+      if (heap_index_get(index, heap_child(obj, j)) != HEAP_SNAPSHOT_NONE) {
+        degrees[i]++;
+      }
+    }
+    edge_count += degrees[i];
+  }
+
+  uint64_t root_count = 0;
+  stack_t *frames;
+  for (size_t s = 0; (frames = vm_frame_stack(vm, s)) != NULL; s++) {
+    for (size_t i = 0; i < frames->count; i++) {
+      frame_t *frame = frames->data[i];
+      root_count += frame->references->count;
+    }
+  }
+
+  heap_snapshot_header_t header = {.version = HEAP_SNAPSHOT_VERSION,
+                                   .node_count = node_count,
+                                   .edge_count = edge_count,
+                                   .root_count = root_count};
+  memcpy(header.magic, HEAP_SNAPSHOT_MAGIC, sizeof(header.magic));
+  bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+
+  for (uint32_t i = 0; ok && i < node_count; i++) {
+    snek_object_t *obj = index->nodes[i];
+    heap_snapshot_node_t node = {.kind = (uint8_t)obj->kind,
+                                 .out_degree = degrees[i],
+                                 .self_size = snek_object_size(obj)};
+    ok = fwrite(&node, sizeof(node), 1, out) == 1;
+  }
+  free(degrees);
+
+  for (uint32_t i = 0; ok && i < node_count; i++) {
+    snek_object_t *obj = index->nodes[i];
+    size_t count = heap_child_count(obj);
+    for (size_t j = 0; ok && j < count; j++) {
+      uint32_t target = heap_index_get(index, heap_child(obj, j));
+      if (target != HEAP_SNAPSHOT_NONE) {
+        ok = fwrite(&target, sizeof(target), 1, out) == 1;
+      }
+    }
+  }
+
+  // Frames are numbered across every thread's stack
+  uint32_t frame_index = 0;
+  for (size_t s = 0; ok && (frames = vm_frame_stack(vm, s)) != NULL; s++) {
+    for (size_t i = 0; ok && i < frames->count; i++, frame_index++) {
+      frame_t *frame = frames->data[i];
+      for (size_t j = 0; ok && j < frame->references->count; j++) {
+        heap_snapshot_root_t root = {
+            .frame = frame_index,
+            .node = heap_index_get(index, frame->references->data[j])};
+        ok = fwrite(&root, sizeof(root), 1, out) == 1;
+      }
+    }
+  }
+  return ok;
+}
+
+static bool heap_snapshot_take(vm_t *vm, const char *path) {
+  if (registry_count(vm->objects) >= HEAP_SNAPSHOT_UNREACHABLE) {
+    return false;
+  }
+
+  heap_index_t index;
+  if (!heap_index_init(&index, vm->objects)) {
+    return false;
+  }
+
+  FILE *out = fopen(path, "wb");
+  bool ok = out != NULL && heap_snapshot_write(vm, &index, out);
+  if (out != NULL && fclose(out) != 0) {
+    ok = false;
+  }
+
+  free(index.keys);
+  free(index.values);
+  free(index.nodes);
+  return ok;
+}
+
+bool vm_heap_snapshot(vm_t *vm, const char *path) {
+  if (vm == NULL) {
+    return false;
+  }
+  vm_world_stop(vm);
+  bool ok = heap_snapshot_take(vm, path);
+  vm_world_resume(vm);
+  return ok;
+}
+
+heap_snapshot_t *heap_snapshot_load(const char *path) {
+  FILE *in = fopen(path, "rb");
+  if (in == NULL) {
+    return NULL;
+  }
+
+  heap_snapshot_header_t header;
+  if (fread(&header, sizeof(header), 1, in) != 1 ||
+      memcmp(header.magic, HEAP_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0 ||
+      header.version != HEAP_SNAPSHOT_VERSION ||
+      header.node_count >= HEAP_SNAPSHOT_UNREACHABLE) {
+    fclose(in);
+    return NULL;
+  }
+
+  heap_snapshot_t *snapshot = calloc(1, sizeof(heap_snapshot_t));
+  if (snapshot == NULL) {
+    fclose(in);
+    return NULL;
+  }
+  snapshot->node_count = header.node_count;
+  snapshot->edge_count = header.edge_count;
+  snapshot->root_count = header.root_count;
+  snapshot->nodes = malloc((header.node_count + 1) * sizeof(*snapshot->nodes));
+  snapshot->edge_offsets =
+      malloc((header.node_count + 1) * sizeof(*snapshot->edge_offsets));
+  snapshot->edges = malloc((header.edge_count + 1) * sizeof(uint32_t));
+  snapshot->roots = malloc((header.root_count + 1) * sizeof(*snapshot->roots));
+
+  bool ok = snapshot->nodes != NULL && snapshot->edge_offsets != NULL &&
+            snapshot->edges != NULL && snapshot->roots != NULL;
+  ok = ok && fread(snapshot->nodes, sizeof(*snapshot->nodes),
+                   header.node_count, in) == header.node_count;
+
+  uint64_t offset = 0;
+  for (uint32_t i = 0; ok && i < header.node_count; i++) {
+    snapshot->edge_offsets[i] = offset;
+    offset += snapshot->nodes[i].out_degree;
+  }
+  if (ok) {
+    snapshot->edge_offsets[header.node_count] = offset;
+    ok = offset == header.edge_count;
+  }
+
+  ok = ok && fread(snapshot->edges, sizeof(uint32_t), header.edge_count, in) ==
+                 header.edge_count;
+  ok = ok && fread(snapshot->roots, sizeof(*snapshot->roots),
+                   header.root_count, in) == header.root_count;
+  fclose(in);
+
+  // Indices are trusted from here on
+  for (uint64_t i = 0; ok && i < header.edge_count; i++) {
+    ok = snapshot->edges[i] < header.node_count;
+  }
+  for (uint64_t i = 0; ok && i < header.root_count; i++) {
+    ok = snapshot->roots[i].node < header.node_count ||
+         snapshot->roots[i].node == HEAP_SNAPSHOT_NONE;
+  }
+
+  if (!ok) {
+    heap_snapshot_free(snapshot);
+    return NULL;
+  }
+  return snapshot;
+}
+
+void heap_snapshot_free(heap_snapshot_t *snapshot) {
+  if (snapshot == NULL) {
+    return;
+  }
+  free(snapshot->nodes);
+  free(snapshot->edge_offsets);
+  free(snapshot->edges);
+  free(snapshot->roots);
+  free(snapshot);
+}
+
+void heap_dominators_free(heap_dominators_t *dominators) {
+  if (dominators == NULL) {
+    return;
+  }
+  free(dominators->idom);
+  free(dominators->retained);
+  free(dominators);
+}
+
+// Successors of a graph where node `node_count` is a virtual root pointing
+// at every frame reference
+static uint64_t heap_successor_count(heap_snapshot_t *snapshot, uint32_t v) {
+  if (v == snapshot->node_count) {
+    return snapshot->root_count;
+  }
+  return snapshot->edge_offsets[v + 1] - snapshot->edge_offsets[v];
+}
+
+static uint32_t heap_successor(heap_snapshot_t *snapshot, uint32_t v,
+                               uint64_t i) {
+  if (v == snapshot->node_count) {
+    return snapshot->roots[i].node;
+  }
+  return snapshot->edges[snapshot->edge_offsets[v] + i];
+}
+
+// Everything below works on preorder numbers. Returns how many nodes the
+// virtual root reaches, `dfn` maps nodes to numbers and `vertex` back.
+static uint32_t heap_dfs(heap_snapshot_t *snapshot, uint32_t *dfn,
+                         uint32_t *vertex, uint32_t *parent,
+                         uint64_t *cursor) {
+  uint32_t root = snapshot->node_count;
+  for (uint32_t i = 0; i <= root; i++) {
+    dfn[i] = HEAP_SNAPSHOT_NONE;
+  }
+
+  // The explicit DFS stack lives after `parent` and holds preorder
+  // numbers, `cursor` is the next successor of each to look at
+  uint32_t *stack = parent + root + 1;
+  size_t depth = 0;
+  uint32_t count = 0;
+
+  dfn[root] = count;
+  vertex[count] = root;
+  parent[count] = HEAP_SNAPSHOT_NONE;
+  cursor[count] = 0;
+  stack[depth++] = count++;
+
+  while (depth > 0) {
+    uint32_t v = stack[depth - 1];
+    uint32_t node = vertex[v];
+    if (cursor[v] == heap_successor_count(snapshot, node)) {
+      depth--;
+      continue;
+    }
+
+    uint32_t w = heap_successor(snapshot, node, cursor[v]++);
+    if (w == HEAP_SNAPSHOT_NONE || dfn[w] != HEAP_SNAPSHOT_NONE) {
+      continue;
+    }
+    dfn[w] = count;
+    vertex[count] = w;
+    parent[count] = v;
+    cursor[count] = 0;
+    stack[depth++] = count++;
+  }
+  return count;
+}
+
+// Per preorder number state of Lengauer-Tarjan, kept together because
+// eval() touches all of it for nodes scattered across the heap
+typedef struct HeapLtNode {
+  uint32_t semi;
+  uint32_t label;
+  uint32_t ancestor;
+  uint32_t idom;
+} heap_lt_node_t;
+
+// Path compression of the LT forest, iterative version of the usual
+// recursive compress(v)
+static void heap_compress(heap_lt_node_t *lt, uint32_t *path, uint32_t v) {
+  size_t length = 0;
+  while (lt[lt[v].ancestor].ancestor != HEAP_SNAPSHOT_NONE) {
+    path[length++] = v;
+    v = lt[v].ancestor;
+  }
+  while (length > 0) {
+    heap_lt_node_t *u = &lt[path[--length]];
+    heap_lt_node_t *a = &lt[u->ancestor];
+    if (lt[a->label].semi < lt[u->label].semi) {
+      u->label = a->label;
+    }
+    u->ancestor = a->ancestor;
+  }
+}
+
+static uint32_t heap_eval(heap_lt_node_t *lt, uint32_t *path, uint32_t v) {
+  if (lt[v].ancestor == HEAP_SNAPSHOT_NONE) {
+    return v;
+  }
+  heap_compress(lt, path, v);
+  return lt[v].label;
+}
+
+heap_dominators_t *heap_snapshot_dominators(heap_snapshot_t *snapshot) {
+  uint32_t total = snapshot->node_count + 1;
+  heap_dominators_t *result = calloc(1, sizeof(heap_dominators_t));
+  uint32_t *dfn = malloc(total * sizeof(uint32_t));
+  uint32_t *vertex = malloc(total * sizeof(uint32_t));
+  // parent[] followed by the DFS stack
+  uint32_t *parent = malloc(2 * (size_t)total * sizeof(uint32_t));
+  // Reused for the n + 1 predecessor offsets afterwards
+  uint64_t *cursor = malloc(((size_t)total + 1) * sizeof(uint64_t));
+  if (result == NULL || dfn == NULL || vertex == NULL || parent == NULL ||
+      cursor == NULL) {
+    free(result);
+    free(dfn);
+    free(vertex);
+    free(parent);
+    free(cursor);
+    return NULL;
+  }
+
+  uint32_t n = heap_dfs(snapshot, dfn, vertex, parent, cursor);
+
+  // Predecessors among reachable nodes, as CSR over preorder numbers. The
+  // DFS cursors are no longer needed and hold the offsets.
+  uint64_t *pred_offsets = cursor;
+  memset(pred_offsets, 0, (n + 1) * sizeof(uint64_t));
+  for (uint32_t v = 0; v < n; v++) {
+    uint64_t count = heap_successor_count(snapshot, vertex[v]);
+    for (uint64_t i = 0; i < count; i++) {
+      uint32_t w = heap_successor(snapshot, vertex[v], i);
+      if (w != HEAP_SNAPSHOT_NONE) {
+        pred_offsets[dfn[w] + 1]++;
+      }
+    }
+  }
+  for (uint32_t v = 0; v < n; v++) {
+    pred_offsets[v + 1] += pred_offsets[v];
+  }
+  uint32_t *preds = malloc((pred_offsets[n] + 1) * sizeof(uint32_t));
+  uint32_t *fill = malloc((size_t)n * sizeof(uint32_t));
+  heap_lt_node_t *lt = malloc((size_t)n * sizeof(heap_lt_node_t));
+  uint32_t *bucket = malloc((size_t)n * sizeof(uint32_t));
+  uint32_t *bucket_next = malloc((size_t)n * sizeof(uint32_t));
+  result->idom = malloc(total * sizeof(uint32_t));
+  result->retained = calloc(total, sizeof(uint64_t));
+
+  bool ok = preds != NULL && fill != NULL && lt != NULL && bucket != NULL &&
+            bucket_next != NULL && result->idom != NULL &&
+            result->retained != NULL;
+  if (ok) {
+    for (uint32_t v = 0; v < n; v++) {
+      fill[v] = 0;
+    }
+    for (uint32_t v = 0; v < n; v++) {
+      uint64_t count = heap_successor_count(snapshot, vertex[v]);
+      for (uint64_t i = 0; i < count; i++) {
+        uint32_t w = heap_successor(snapshot, vertex[v], i);
+        if (w != HEAP_SNAPSHOT_NONE) {
+          uint32_t target = dfn[w];
+          preds[pred_offsets[target] + fill[target]++] = v;
+        }
+      }
+    }
+
+    for (uint32_t v = 0; v < n; v++) {
+      lt[v] = (heap_lt_node_t){.semi = v,
+                               .label = v,
+                               .ancestor = HEAP_SNAPSHOT_NONE,
+                               .idom = 0};
+      bucket[v] = HEAP_SNAPSHOT_NONE;
+    }
+
+    // `fill` is done and becomes the compression path
+    uint32_t *path = fill;
+    for (uint32_t w = n - 1; w > 0; w--) {
+      for (uint64_t i = pred_offsets[w]; i < pred_offsets[w + 1]; i++) {
+        uint32_t u = heap_eval(lt, path, preds[i]);
+        if (lt[u].semi < lt[w].semi) {
+          lt[w].semi = lt[u].semi;
+        }
+      }
+      bucket_next[w] = bucket[lt[w].semi];
+      bucket[lt[w].semi] = w;
+
+      uint32_t p = parent[w];
+      lt[w].ancestor = p;
+      for (uint32_t v = bucket[p]; v != HEAP_SNAPSHOT_NONE;
+           v = bucket_next[v]) {
+        uint32_t u = heap_eval(lt, path, v);
+        lt[v].idom = lt[u].semi < lt[v].semi ? u : p;
+      }
+      bucket[p] = HEAP_SNAPSHOT_NONE;
+    }
+    for (uint32_t w = 1; w < n; w++) {
+      if (lt[w].idom != lt[w].semi) {
+        lt[w].idom = lt[lt[w].idom].idom;
+      }
+    }
+
+    // Children come after their dominator in preorder, so one backwards
+    // pass adds every subtree into its dominator
+    for (uint32_t w = 1; w < n; w++) {
+      result->retained[vertex[w]] = snapshot->nodes[vertex[w]].self_size;
+    }
+    for (uint32_t w = n - 1; w > 0; w--) {
+      if (lt[w].idom != 0) {
+        result->retained[vertex[lt[w].idom]] += result->retained[vertex[w]];
+      }
+    }
+
+    for (uint32_t i = 0; i < snapshot->node_count; i++) {
+      result->idom[i] = HEAP_SNAPSHOT_UNREACHABLE;
+    }
+    for (uint32_t w = 1; w < n; w++) {
+      result->idom[vertex[w]] =
+          lt[w].idom == 0 ? HEAP_SNAPSHOT_ROOT : vertex[lt[w].idom];
+    }
+    result->node_count = snapshot->node_count;
+    result->reachable = n - 1;
+  }
+
+  free(dfn);
+  free(vertex);
+  free(parent);
+  free(cursor);
+  free(preds);
+  free(fill);
+  free(lt);
+  free(bucket);
+  free(bucket_next);
+  if (!ok) {
+    heap_dominators_free(result);
+    return NULL;
+  }
+  return result;
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "vm.h"
+
+/// Binary heap snapshot, in native byte order:
+///
+///   header  "SNEKHEAP", u32 version, u32 node count, u64 edge count,
+///           u64 root count
+///   nodes   one `heap_snapshot_node_t` per object, in registry order
+///   edges   u32 target node per edge, grouped by source in node order
+///   roots   one `heap_snapshot_root_t` per frame reference
+///
+/// Edges follow what keeps objects alive: array and persistent vector
+/// elements, vector3 components, rope halves and slice parents.
+
+#define HEAP_SNAPSHOT_MAGIC "SNEKHEAP"
+#define HEAP_SNAPSHOT_VERSION 1
+
+typedef struct HeapSnapshotHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t node_count;
+  uint64_t edge_count;
+  uint64_t root_count;
+} heap_snapshot_header_t;
+
+typedef struct HeapSnapshotNode {
+  uint8_t kind;
+  uint8_t pad[3];
+  uint32_t out_degree;
+  /// `snek_object_size` at the time of the snapshot
+  uint64_t self_size;
+} heap_snapshot_node_t;
+
+typedef struct HeapSnapshotRoot {
+  uint32_t frame;
+  uint32_t node;
+} heap_snapshot_root_t;
+
+typedef struct HeapSnapshot {
+  uint32_t node_count;
+  uint64_t edge_count;
+  uint64_t root_count;
+  heap_snapshot_node_t *nodes;
+  /// Edges of node `i` are edges[edge_offsets[i] .. edge_offsets[i + 1])
+  uint64_t *edge_offsets;
+  uint32_t *edges;
+  heap_snapshot_root_t *roots;
+} heap_snapshot_t;
+
+/// `idom` value of nodes only dominated by the roots as a whole
+#define HEAP_SNAPSHOT_ROOT UINT32_MAX
+/// `idom` value of nodes no root reaches
+#define HEAP_SNAPSHOT_UNREACHABLE (UINT32_MAX - 1)
+
+typedef struct HeapDominators {
+  uint32_t node_count;
+  uint32_t reachable;
+  uint32_t *idom;
+  /// Bytes freed if the node became unreachable, 0 if unreachable already
+  uint64_t *retained;
+} heap_dominators_t;
+
+/// Writes the heap to `path`, a shared VM's world is stopped meanwhile
+bool vm_heap_snapshot(vm_t *vm, const char *path);
+
+heap_snapshot_t *heap_snapshot_load(const char *path);
+void heap_snapshot_free(heap_snapshot_t *snapshot);
+
+/// Lengauer-Tarjan dominators, iterative so it holds up on deep heaps
+heap_dominators_t *heap_snapshot_dominators(heap_snapshot_t *snapshot);
+void heap_dominators_free(heap_dominators_t *dominators);
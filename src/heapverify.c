@@ -0,0 +1,312 @@
+#include "bootmem.h"
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "heapverify.h"
+#include "snekobject.h"
+#include "snekpvec.h"
+
+// Registered objects, open addressing over a power of two table. Read
+// only once built, so the workers share it without locking.
+typedef struct HeapVerifySet {
+  size_t mask;
+  snek_object_t **keys;
+} heap_verify_set_t;
+
+typedef struct HeapVerifyWorker {
+  vm_t *vm;
+  heap_verify_set_t *set;
+  /// Registry snapshot, the worker checks `entries[begin..end)`
+  snek_object_t **entries;
+  size_t begin;
+  size_t end;
+  size_t edges;
+  size_t errors;
+  char first_error[160];
+} heap_verify_worker_t;
+
+static void heap_verify_fail(heap_verify_worker_t *worker, const char *format,
+                             ...) {
+  if (worker->errors++ == 0) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(worker->first_error, sizeof(worker->first_error), format, args);
+    va_end(args);
+  }
+}
+
+static size_t heap_verify_slot(heap_verify_set_t *set, snek_object_t *obj) {
+  uint64_t hash = ((uintptr_t)obj >> 4) * 0x9e3779b97f4a7c15ull;
+  size_t slot = (size_t)(hash >> 32) & set->mask;
+  while (set->keys[slot] != NULL && set->keys[slot] != obj) {
+    slot = (slot + 1) & set->mask;
+  }
+  return slot;
+}
+
+static bool heap_verify_contains(heap_verify_set_t *set, snek_object_t *obj) {
+  return set->keys[heap_verify_slot(set, obj)] == obj;
+}
+
+// Duplicate registry entries are reported here
+static bool heap_verify_set_init(heap_verify_set_t *set,
+                                 snek_object_t **entries, size_t count,
+                                 heap_verify_worker_t *errors) {
+  size_t capacity = 16;
+  while (capacity < count * 2) {
+    capacity <<= 1;
+  }
+  set->mask = capacity - 1;
+  set->keys = calloc(capacity, sizeof(snek_object_t *));
+  if (set->keys == NULL) {
+    return false;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    snek_object_t *obj = entries[i];
+    size_t slot = heap_verify_slot(set, obj);
+    if (set->keys[slot] == obj) {
+      heap_verify_fail(errors, "object %p is registered twice", (void *)obj);
+    }
+    set->keys[slot] = obj;
+  }
+  return true;
+}
+
+static void heap_verify_reference(heap_verify_worker_t *worker,
+                                  snek_object_t *from, snek_object_t *to) {
+  if (to == NULL) {
+    return;
+  }
+  worker->edges++;
+  if (!heap_verify_contains(worker->set, to)) {
+    heap_verify_fail(worker, "object %p (kind %d) references freed object %p",
+                     (void *)from, from->kind, (void *)to);
+  }
+}
+
+static void heap_verify_array(heap_verify_worker_t *worker,
+                              snek_object_t *obj) {
+  snek_array_t *array = &obj->data.v_array;
+  if (array->split > array->size || array->buffer == NULL ||
+      array->buffer->capacity < array->split) {
+    heap_verify_fail(worker, "array %p has a short head buffer", (void *)obj);
+    return;
+  }
+  if (array->size > array->split &&
+      (array->tail == NULL ||
+       array->tail->capacity < array->size - array->split)) {
+    heap_verify_fail(worker, "array %p has a short tail buffer", (void *)obj);
+    return;
+  }
+  for (size_t i = 0; i < array->size; i++) {
+    heap_verify_reference(worker, obj, snek_array_get(obj, i));
+  }
+}
+
+static void heap_verify_object(heap_verify_worker_t *worker,
+                               snek_object_t *obj) {
+  if (obj->is_marked) {
+    heap_verify_fail(worker, "object %p is still marked", (void *)obj);
+  }
+
+  switch (obj->kind) {
+  case INTEGER:
+  case FLOAT:
+  case FLOAT_VECTOR3:
+    break;
+  case INT_ARRAY:
+    if (obj->data.v_int_array.size > 0 &&
+        obj->data.v_int_array.elements == NULL) {
+      heap_verify_fail(worker, "int array %p has no elements", (void *)obj);
+    }
+    break;
+  case FLOAT_ARRAY:
+    if (obj->data.v_float_array.size > 0 &&
+        obj->data.v_float_array.elements == NULL) {
+      heap_verify_fail(worker, "float array %p has no elements", (void *)obj);
+    }
+    break;
+  case STRING: {
+    snek_rope_t *rope = obj->data.v_string.rope;
+    if (obj->data.v_string.chars == NULL &&
+        (rope == NULL || rope->left == NULL || rope->right == NULL)) {
+      heap_verify_fail(worker, "string %p has neither chars nor halves",
+                       (void *)obj);
+    }
+    if (rope != NULL) {
+      heap_verify_reference(worker, obj, rope->left);
+      heap_verify_reference(worker, obj, rope->right);
+    }
+    break;
+  }
+  case VECTOR3:
+    heap_verify_reference(worker, obj, obj->data.v_vector3.x);
+    heap_verify_reference(worker, obj, obj->data.v_vector3.y);
+    heap_verify_reference(worker, obj, obj->data.v_vector3.z);
+    break;
+  case SLICE: {
+    // The parent is only read once it is known to be registered
+    snek_slice_t *view = &obj->data.v_slice;
+    size_t errors = worker->errors;
+    if (view->parent == NULL) {
+      heap_verify_fail(worker, "slice %p has no parent", (void *)obj);
+      break;
+    }
+    heap_verify_reference(worker, obj, view->parent);
+    if (worker->errors != errors) {
+      break;
+    }
+    if (view->parent->kind != ARRAY ||
+        view->offset + view->length > view->parent->data.v_array.size) {
+      heap_verify_fail(worker, "slice %p is out of its parent's bounds",
+                       (void *)obj);
+    }
+    break;
+  }
+  case ARRAY:
+    heap_verify_array(worker, obj);
+    break;
+  case PVECTOR:
+    for (size_t i = 0; i < obj->data.v_pvec.size; i++) {
+      heap_verify_reference(worker, obj, snek_pvec_get(obj, i));
+    }
+    break;
+  default:
+    heap_verify_fail(worker, "object %p has unknown kind %d", (void *)obj,
+                     obj->kind);
+    break;
+  }
+}
+
+static void *heap_verify_range(void *arg) {
+  heap_verify_worker_t *worker = arg;
+  for (size_t i = worker->begin; i < worker->end; i++) {
+    heap_verify_object(worker, worker->entries[i]);
+  }
+  return NULL;
+}
+
+static size_t heap_verify_frames(vm_t *vm, heap_verify_set_t *set,
+                                 heap_verify_worker_t *errors) {
+  size_t roots = 0;
+  stack_t *frames;
+  // Frames are numbered across every thread's stack
+  size_t index = 0;
+  for (size_t s = 0; (frames = vm_frame_stack(vm, s)) != NULL; s++) {
+    for (size_t i = 0; i < frames->count; i++, index++) {
+      frame_t *frame = frames->data[i];
+      if (frame == NULL || frame->references == NULL) {
+        heap_verify_fail(errors, "frame %zu is missing its references",
+                         index);
+        continue;
+      }
+      for (size_t j = 0; j < frame->references->count; j++) {
+        snek_object_t *obj = frame->references->data[j];
+        roots++;
+        if (obj == NULL || !heap_verify_contains(set, obj)) {
+          heap_verify_fail(errors, "frame %zu root %zu is invalid (%p)",
+                           index, j, (void *)obj);
+        }
+      }
+    }
+  }
+  return roots;
+}
+
+static size_t heap_verify_thread_count(size_t objects) {
+  if (objects < HEAP_VERIFY_PARALLEL_MIN) {
+    return 1;
+  }
+  long online = sysconf(_SC_NPROCESSORS_ONLN);
+  if (online < 1) {
+    return 1;
+  }
+  return online < HEAP_VERIFY_MAX_THREADS ? (size_t)online
+                                          : HEAP_VERIFY_MAX_THREADS;
+}
+
+bool vm_verify_heap(vm_t *vm, heap_verify_report_t *report) {
+  vm_world_stop(vm);
+  bool ok = vm_verify_heap_stopped(vm, report);
+  vm_world_resume(vm);
+  return ok;
+}
+
+bool vm_verify_heap_stopped(vm_t *vm, heap_verify_report_t *report) {
+  heap_verify_report_t local;
+  if (report == NULL) {
+    report = &local;
+  }
+  memset(report, 0, sizeof(*report));
+
+  // Registry and frame problems are collected apart from the workers'
+  heap_verify_worker_t shared = {.vm = vm};
+  size_t counted = registry_count(vm->objects);
+  // Room for one more, so an entry the count misses is still walked
+  snek_object_t **entries = malloc((counted + 1) * sizeof(snek_object_t *));
+  heap_verify_set_t set;
+  set.keys = NULL;
+  size_t held = 0;
+  if (entries != NULL) {
+    held = registry_copy(vm->objects, entries, counted + 1);
+    if (held != counted) {
+      heap_verify_fail(&shared, "registry counts %zu objects but holds %s%zu",
+                       counted, held > counted ? "more than " : "", held);
+    }
+  }
+  if (entries == NULL || !heap_verify_set_init(&set, entries, held, &shared)) {
+    free(entries);
+    snprintf(report->first_error, sizeof(report->first_error),
+             "out of memory");
+    report->errors = 1;
+    return false;
+  }
+  shared.set = &set;
+  report->roots = heap_verify_frames(vm, &set, &shared);
+
+  heap_verify_worker_t workers[HEAP_VERIFY_MAX_THREADS];
+  pthread_t threads[HEAP_VERIFY_MAX_THREADS];
+  bool started[HEAP_VERIFY_MAX_THREADS] = {false};
+  size_t count = heap_verify_thread_count(held);
+  size_t chunk = (held + count - 1) / count;
+  for (size_t i = 0; i < count; i++) {
+    size_t begin = i * chunk < held ? i * chunk : held;
+    size_t end = begin + chunk < held ? begin + chunk : held;
+    workers[i] = (heap_verify_worker_t){.vm = vm,
+                                        .set = &set,
+                                        .entries = entries,
+                                        .begin = begin,
+                                        .end = end};
+    // The first range runs on this thread, as do ranges whose thread
+    // could not be started
+    started[i] = i > 0 && pthread_create(&threads[i], NULL, heap_verify_range,
+                                         &workers[i]) == 0;
+  }
+  for (size_t i = 0; i < count; i++) {
+    if (started[i]) {
+      pthread_join(threads[i], NULL);
+    } else {
+      heap_verify_range(&workers[i]);
+    }
+  }
+  free(set.keys);
+  free(entries);
+
+  report->objects = held;
+  report->errors = shared.errors;
+  memcpy(report->first_error, shared.first_error, sizeof(shared.first_error));
+  for (size_t i = 0; i < count; i++) {
+    report->edges += workers[i].edges;
+    if (report->errors == 0 && workers[i].errors > 0) {
+      memcpy(report->first_error, workers[i].first_error,
+             sizeof(workers[i].first_error));
+    }
+    report->errors += workers[i].errors;
+  }
+  return report->errors == 0;
+}
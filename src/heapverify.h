@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "vm.h"
+
+/// Heaps with at least this many objects are checked by several threads
+#define HEAP_VERIFY_PARALLEL_MIN 65536
+#define HEAP_VERIFY_MAX_THREADS 8
+
+typedef struct HeapVerifyReport {
+  size_t objects;
+  size_t edges;
+  size_t roots;
+  size_t errors;
+  /// First problem found, empty when there were none
+  char first_error[160];
+} heap_verify_report_t;
+
+/// Checks the invariants a finished collection leaves behind: every
+/// registered object appears once with its mark bit clear and a sane
+/// layout, every reference held by an object or a frame points at a
+/// registered object, and every frame is intact. References are only
+/// compared against the registry, never followed, so dangling ones are
+/// reported rather than crashing the check.
+///
+/// Returns true when nothing is wrong, `report` may be NULL. A shared VM's
+/// world is stopped for the check, see `vm_world_stop`.
+bool vm_verify_heap(vm_t *vm, heap_verify_report_t *report);
+/// The same check for a caller that has the world stopped already, such
+/// as the collector
+bool vm_verify_heap_stopped(vm_t *vm, heap_verify_report_t *report);
@@ -0,0 +1,115 @@
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "largespace.h"
+
+// Sits at the start of each mapping, the block follows it
+typedef struct LargeRegion {
+  struct LargeRegion *prev;
+  struct LargeRegion *next;
+  size_t mapped;
+  size_t pad;
+} large_region_t;
+
+_Static_assert(sizeof(large_region_t) % 16 == 0,
+               "region header must keep blocks 16 byte aligned");
+
+static pthread_mutex_t large_space_lock = PTHREAD_MUTEX_INITIALIZER;
+static large_region_t *large_space_regions;
+static large_space_stats_t large_space_totals;
+
+static size_t large_space_round(size_t size) {
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  return (size + sizeof(large_region_t) + page - 1) & ~(page - 1);
+}
+
+// Both called with the lock held
+static void large_space_link(large_region_t *region) {
+  region->prev = NULL;
+  region->next = large_space_regions;
+  if (large_space_regions != NULL) {
+    large_space_regions->prev = region;
+  }
+  large_space_regions = region;
+  large_space_totals.regions++;
+  large_space_totals.mapped_bytes += region->mapped;
+}
+
+static void large_space_unlink(large_region_t *region) {
+  if (region->prev != NULL) {
+    region->prev->next = region->next;
+  } else {
+    large_space_regions = region->next;
+  }
+  if (region->next != NULL) {
+    region->next->prev = region->prev;
+  }
+  large_space_totals.regions--;
+  large_space_totals.mapped_bytes -= region->mapped;
+}
+
+void *large_space_map(size_t size) {
+  if (size > SIZE_MAX / 2) {
+    return NULL;
+  }
+  size_t mapped = large_space_round(size);
+  large_region_t *region = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (region == MAP_FAILED) {
+    return NULL;
+  }
+  region->mapped = mapped;
+
+  pthread_mutex_lock(&large_space_lock);
+  large_space_link(region);
+  large_space_totals.maps++;
+  pthread_mutex_unlock(&large_space_lock);
+  return region + 1;
+}
+
+void *large_space_remap(void *block, size_t size) {
+  if (block == NULL) {
+    return large_space_map(size);
+  }
+  if (size > SIZE_MAX / 2) {
+    return NULL;
+  }
+  large_region_t *region = (large_region_t *)block - 1;
+  size_t mapped = large_space_round(size);
+
+  // Unlinked while the mapping may move, so nobody follows a stale link
+  pthread_mutex_lock(&large_space_lock);
+  large_space_unlink(region);
+  large_region_t *moved = mremap(region, region->mapped, mapped,
+                                 MREMAP_MAYMOVE);
+  bool ok = moved != MAP_FAILED;
+  if (ok) {
+    region = moved;
+    region->mapped = mapped;
+  }
+  large_space_link(region);
+  pthread_mutex_unlock(&large_space_lock);
+  return ok ? region + 1 : NULL;
+}
+
+void large_space_unmap(void *block) {
+  if (block == NULL) {
+    return;
+  }
+  large_region_t *region = (large_region_t *)block - 1;
+  pthread_mutex_lock(&large_space_lock);
+  large_space_unlink(region);
+  large_space_totals.unmaps++;
+  pthread_mutex_unlock(&large_space_lock);
+  munmap(region, region->mapped);
+}
+
+void large_space_stats(large_space_stats_t *out) {
+  pthread_mutex_lock(&large_space_lock);
+  *out = large_space_totals;
+  pthread_mutex_unlock(&large_space_lock);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Large-object space. Object payloads of at least
+/// SNEK_LARGE_OBJECT_THRESHOLD bytes (string characters, array buffers,
+/// typed arrays) each get their own anonymous mapping instead of a malloc
+/// block, so they never fragment the small-object arenas and their pages
+/// go back to the OS the moment the sweep frees them.
+///
+/// Regions sit on one list that is only ever linked and unlinked, a
+/// region's contents are never copied or moved except by an explicit
+/// realloc. bootmem routes payload allocations here by size and category.
+#ifndef SNEK_LARGE_OBJECT_THRESHOLD
+#define SNEK_LARGE_OBJECT_THRESHOLD (256 * 1024)
+#endif
+
+typedef struct LargeSpaceStats {
+  /// Regions mapped right now, and the bytes they span
+  size_t regions;
+  size_t mapped_bytes;
+  /// Totals since start
+  uint64_t maps;
+  uint64_t unmaps;
+} large_space_stats_t;
+
+/// A zero-filled block of `size` bytes in its own mapping, 16 byte
+/// aligned. NULL when the mapping fails.
+void *large_space_map(size_t size);
+/// Resizes a block from `large_space_map`, moving its pages rather than
+/// copying them. Returns NULL and keeps the old block on failure.
+void *large_space_remap(void *block, size_t size);
+/// Unmaps the block at once, NULL is ignored
+void large_space_unmap(void *block);
+
+void large_space_stats(large_space_stats_t *out);
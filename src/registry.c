@@ -0,0 +1,281 @@
+#define BOOT_CATEGORY BOOT_CATEGORY_STACK
+#include "bootmem.h"
+#include <stdint.h>
+#include <stdio.h>
+
+#include "registry.h"
+
+static registry_segment_t *registry_segment_new(void) {
+  registry_segment_t *segment = calloc(1, sizeof(registry_segment_t));
+  if (segment == NULL) {
+    // Same policy as stack_push, an object that can't be registered
+    // would never be freed
+    exit(1);
+  }
+  segment->packed = SIZE_MAX;
+  return segment;
+}
+
+// Slots of `segment` that may hold entries
+static size_t registry_segment_limit(registry_segment_t *segment) {
+  if (segment->packed != SIZE_MAX) {
+    return segment->packed;
+  }
+  size_t reserved = atomic_load_explicit(&segment->reserved,
+                                         memory_order_acquire);
+  return reserved < REGISTRY_SEGMENT_SLOTS ? reserved
+                                           : REGISTRY_SEGMENT_SLOTS;
+}
+
+registry_t *registry_new(void) {
+  registry_t *registry = malloc(sizeof(registry_t));
+  if (registry == NULL) {
+    return NULL;
+  }
+  registry->head = registry_segment_new();
+  atomic_init(&registry->tail, registry->head);
+  atomic_init(&registry->count, 0);
+  registry->retired = NULL;
+  return registry;
+}
+
+static void registry_free_retired(registry_t *registry) {
+  while (registry->retired != NULL) {
+    registry_segment_t *segment = registry->retired;
+    registry->retired = segment->retired_next;
+    free(segment);
+  }
+}
+
+void registry_free(registry_t *registry) {
+  if (registry == NULL) {
+    return;
+  }
+  registry_segment_t *segment = registry->head;
+  while (segment != NULL) {
+    registry_segment_t *next = atomic_load(&segment->next);
+    free(segment);
+    segment = next;
+  }
+  registry_free_retired(registry);
+  free(registry);
+}
+
+// Moves the tail past `full`, installing a new segment if nobody has yet.
+// Racing appenders all end up on the same next segment.
+static void registry_advance(registry_t *registry, registry_segment_t *full) {
+  registry_segment_t *next = atomic_load(&full->next);
+  if (next == NULL) {
+    registry_segment_t *fresh = registry_segment_new();
+    if (atomic_compare_exchange_strong(&full->next, &next, fresh)) {
+      next = fresh;
+    } else {
+      free(fresh);
+    }
+  }
+  atomic_compare_exchange_strong(&registry->tail, &full, next);
+}
+
+void registry_add_many(registry_t *registry, snek_object_t **objs,
+                       size_t count) {
+  while (count > 0) {
+    registry_segment_t *segment =
+        atomic_load_explicit(&registry->tail, memory_order_acquire);
+    size_t start = atomic_fetch_add(&segment->reserved, count);
+    if (start < REGISTRY_SEGMENT_SLOTS) {
+      size_t fits = REGISTRY_SEGMENT_SLOTS - start;
+      size_t n = count < fits ? count : fits;
+      for (size_t i = 0; i < n; i++) {
+        atomic_store_explicit(&segment->slots[start + i], objs[i],
+                              memory_order_release);
+      }
+      atomic_fetch_add(&registry->count, n);
+      atomic_fetch_add_explicit(&segment->published, n, memory_order_release);
+      objs += n;
+      count -= n;
+      if (count == 0) {
+        return;
+      }
+    }
+    registry_advance(registry, segment);
+  }
+}
+
+void registry_add(registry_t *registry, snek_object_t *obj) {
+  registry_add_many(registry, &obj, 1);
+}
+
+void registry_add_exclusive(registry_t *registry, snek_object_t *obj) {
+  registry_segment_t *segment =
+      atomic_load_explicit(&registry->tail, memory_order_relaxed);
+  size_t index =
+      atomic_load_explicit(&segment->reserved, memory_order_relaxed);
+  if (index >= REGISTRY_SEGMENT_SLOTS) {
+    registry_add(registry, obj);
+    return;
+  }
+  atomic_store_explicit(&segment->slots[index], obj, memory_order_relaxed);
+  atomic_store_explicit(&segment->reserved, index + 1, memory_order_relaxed);
+  atomic_store_explicit(&segment->published, index + 1,
+                        memory_order_relaxed);
+  atomic_store_explicit(&registry->count,
+                        atomic_load_explicit(&registry->count,
+                                             memory_order_relaxed) + 1,
+                        memory_order_relaxed);
+}
+
+size_t registry_count(registry_t *registry) {
+  return atomic_load(&registry->count);
+}
+
+registry_cursor_t registry_begin(registry_t *registry) {
+  return (registry_cursor_t){.segment = registry->head, .index = 0};
+}
+
+snek_object_t *registry_next(registry_cursor_t *cursor) {
+  while (cursor->segment != NULL) {
+    size_t limit = registry_segment_limit(cursor->segment);
+    while (cursor->index < limit) {
+      snek_object_t *obj = atomic_load_explicit(
+          &cursor->segment->slots[cursor->index++], memory_order_acquire);
+      if (obj != NULL) {
+        return obj;
+      }
+    }
+    registry_segment_t *next = atomic_load(&cursor->segment->next);
+    if (next == NULL) {
+      return NULL;
+    }
+    cursor->segment = next;
+    cursor->index = 0;
+  }
+  return NULL;
+}
+
+void registry_remove_current(registry_t *registry,
+                             registry_cursor_t *cursor) {
+  atomic_store_explicit(&cursor->segment->slots[cursor->index - 1], NULL,
+                        memory_order_relaxed);
+  atomic_fetch_sub(&registry->count, 1);
+}
+
+// Slides the entries of the segments from `first` up to, not including,
+// `end` towards `first`. Returns the segment the last entry went into,
+// with the number of entries it holds in `*filled`.
+static registry_segment_t *registry_pack(registry_segment_t *first,
+                                         registry_segment_t *end,
+                                         size_t *filled) {
+  registry_segment_t *write = first;
+  size_t w = 0;
+  for (registry_segment_t *read = first; read != end;
+       read = atomic_load(&read->next)) {
+    size_t limit = registry_segment_limit(read);
+    for (size_t i = 0; i < limit; i++) {
+      snek_object_t *obj = atomic_load_explicit(&read->slots[i],
+                                                memory_order_relaxed);
+      if (obj == NULL) {
+        continue;
+      }
+      if (w == REGISTRY_SEGMENT_SLOTS) {
+        write = atomic_load(&write->next);
+        w = 0;
+      }
+      // Never ahead of the read position, so nothing unread is overwritten
+      atomic_store_explicit(&write->slots[w++], obj, memory_order_relaxed);
+    }
+  }
+  for (size_t i = w; i < registry_segment_limit(write); i++) {
+    atomic_store_explicit(&write->slots[i], NULL, memory_order_relaxed);
+  }
+  *filled = w;
+  return write;
+}
+
+void registry_compact(registry_t *registry, bool exclusive) {
+  if (exclusive) {
+    size_t filled;
+    registry_segment_t *last = registry_pack(registry->head, NULL, &filled);
+    registry_segment_t *segment = atomic_load(&last->next);
+    while (segment != NULL) {
+      registry_segment_t *next = atomic_load(&segment->next);
+      free(segment);
+      segment = next;
+    }
+    for (segment = registry->head; segment != last;
+         segment = atomic_load(&segment->next)) {
+      segment->packed = SIZE_MAX;
+    }
+    // The last segment becomes the tail again, appends continue after
+    // its entries
+    atomic_store(&last->next, NULL);
+    last->packed = SIZE_MAX;
+    atomic_store(&last->reserved, filled);
+    atomic_store(&last->published, filled);
+    atomic_store(&registry->tail, last);
+    registry_free_retired(registry);
+    return;
+  }
+
+  // Only segments every appender has finished with: full, published
+  // and not the tail
+  registry_segment_t *tail = atomic_load(&registry->tail);
+  registry_segment_t *end = registry->head;
+  while (end != tail && atomic_load(&end->published) >=
+                            REGISTRY_SEGMENT_SLOTS) {
+    end = atomic_load(&end->next);
+  }
+  if (end == registry->head) {
+    return;
+  }
+
+  size_t filled;
+  registry_segment_t *last = registry_pack(registry->head, end, &filled);
+  for (registry_segment_t *segment = registry->head; segment != last;
+       segment = atomic_load(&segment->next)) {
+    segment->packed = REGISTRY_SEGMENT_SLOTS;
+  }
+  last->packed = filled;
+
+  // Emptied segments are unlinked, appenders never look at them again
+  registry_segment_t *segment = atomic_load(&last->next);
+  while (segment != end) {
+    registry_segment_t *next = atomic_load(&segment->next);
+    segment->retired_next = registry->retired;
+    registry->retired = segment;
+    segment = next;
+  }
+  atomic_store(&last->next, end);
+}
+
+snek_object_t *registry_get(registry_t *registry, size_t index) {
+  registry_cursor_t cursor = registry_begin(registry);
+  snek_object_t *obj;
+  while ((obj = registry_next(&cursor)) != NULL) {
+    if (index-- == 0) {
+      return obj;
+    }
+  }
+  return NULL;
+}
+
+bool registry_remove(registry_t *registry, snek_object_t *obj) {
+  registry_cursor_t cursor = registry_begin(registry);
+  snek_object_t *entry;
+  while ((entry = registry_next(&cursor)) != NULL) {
+    if (entry == obj) {
+      registry_remove_current(registry, &cursor);
+      return true;
+    }
+  }
+  return false;
+}
+
+size_t registry_copy(registry_t *registry, snek_object_t **out, size_t max) {
+  registry_cursor_t cursor = registry_begin(registry);
+  size_t count = 0;
+  snek_object_t *obj;
+  while (count < max && (obj = registry_next(&cursor)) != NULL) {
+    out[count++] = obj;
+  }
+  return count;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "snekobject.h"
+
+/// Every object a VM owns, kept in a linked list of fixed size segments.
+/// Appending is lock free: a thread reserves slots in the tail segment
+/// with one fetch-add and installs the next segment when the tail is
+/// full. Entries never move while appends may be running, so readers and
+/// the sweeper walk the segments without blocking appenders.
+///
+/// The sweeper removes entries by clearing their slot. `registry_compact`
+/// then packs the segments, either all of them when nothing can append
+/// (the world is stopped), or only the full segments appenders are done
+/// with while appends go on.
+#define REGISTRY_SEGMENT_SLOTS 4096
+
+typedef struct RegistrySegment {
+  _Atomic(struct RegistrySegment *) next;
+  /// Slots handed out by fetch-add, runs past the end once the segment
+  /// is full and appenders move on
+  atomic_size_t reserved;
+  /// Slots written, the segment is done with once this reaches the end
+  atomic_size_t published;
+  /// Set by a concurrent compaction: entries live in the first `packed`
+  /// slots. SIZE_MAX while the segment is still filled by appenders.
+  size_t packed;
+  /// Link in `retired`, `next` is left alone for stalled appenders
+  struct RegistrySegment *retired_next;
+  _Atomic(snek_object_t *) slots[REGISTRY_SEGMENT_SLOTS];
+} registry_segment_t;
+
+typedef struct Registry {
+  registry_segment_t *head;
+  _Atomic(registry_segment_t *) tail;
+  /// Entries currently registered
+  atomic_size_t count;
+  /// Segments unlinked by a concurrent compaction. A stalled appender may
+  /// still hold one, so they are freed by the next exclusive compaction.
+  registry_segment_t *retired;
+} registry_t;
+
+/// Position of a walk over the registry, start it with `registry_begin`
+typedef struct RegistryCursor {
+  registry_segment_t *segment;
+  size_t index;
+} registry_cursor_t;
+
+registry_t *registry_new(void);
+/// Frees the registry, not the objects in it
+void registry_free(registry_t *registry);
+
+/// Safe to call from any number of threads at once
+void registry_add(registry_t *registry, snek_object_t *obj);
+/// Appends `count` objects with one reservation per segment touched
+void registry_add_many(registry_t *registry, snek_object_t **objs,
+                       size_t count);
+/// `registry_add` without read-modify-writes, for when no other thread
+/// can append, e.g. a VM no mutator has attached to yet
+void registry_add_exclusive(registry_t *registry, snek_object_t *obj);
+size_t registry_count(registry_t *registry);
+
+registry_cursor_t registry_begin(registry_t *registry);
+/// Next entry of the walk, NULL once it is done. Entries appended while
+/// walking may or may not be seen.
+snek_object_t *registry_next(registry_cursor_t *cursor);
+/// Clears the slot of the entry `registry_next` returned last
+void registry_remove_current(registry_t *registry, registry_cursor_t *cursor);
+
+/// Packs entries towards the head and frees empty segments. With
+/// `exclusive` set nothing may append meanwhile, and every segment
+/// including the tail is packed. Without it only full segments before
+/// the tail are.
+void registry_compact(registry_t *registry, bool exclusive);
+
+/// The `index`-th entry in walk order, NULL past the end. Walks from the
+/// head, meant for tests and tools.
+snek_object_t *registry_get(registry_t *registry, size_t index);
+/// Removes the first entry equal to `obj`, returns false when not found
+bool registry_remove(registry_t *registry, snek_object_t *obj);
+/// Copies up to `max` entries in walk order into `out`, returns how many
+size_t registry_copy(registry_t *registry, snek_object_t **out, size_t max);
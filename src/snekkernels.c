@@ -0,0 +1,108 @@
+#include "snekkernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SNEK_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+void snek_kernel_add_i32_scalar(int32_t *dst, const int32_t *a,
+                                const int32_t *b, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    // Wrap on overflow like the hardware lanes do, instead of signed UB
+    dst[i] = (int32_t)((uint32_t)a[i] + (uint32_t)b[i]);
+  }
+}
+
+void snek_kernel_add_f32_scalar(float *dst, const float *a, const float *b,
+                                size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    dst[i] = a[i] + b[i];
+  }
+}
+
+#ifdef SNEK_KERNELS_X86
+
+__attribute__((target("avx2"))) static void
+add_i32_avx2(int32_t *dst, const int32_t *a, const int32_t *b, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i va = _mm256_loadu_si256((const __m256i *)(a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i *)(b + i));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_add_epi32(va, vb));
+  }
+  snek_kernel_add_i32_scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void
+add_f32_avx2(float *dst, const float *a, const float *b, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 va = _mm256_loadu_ps(a + i);
+    __m256 vb = _mm256_loadu_ps(b + i);
+    _mm256_storeu_ps(dst + i, _mm256_add_ps(va, vb));
+  }
+  snek_kernel_add_f32_scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void
+add_i32_sse2(int32_t *dst, const int32_t *a, const int32_t *b, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128i va = _mm_loadu_si128((const __m128i *)(a + i));
+    __m128i vb = _mm_loadu_si128((const __m128i *)(b + i));
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_add_epi32(va, vb));
+  }
+  snek_kernel_add_i32_scalar(dst + i, a + i, b + i, n - i);
+}
+
+__attribute__((target("sse2"))) static void
+add_f32_sse2(float *dst, const float *a, const float *b, size_t n) {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m128 va = _mm_loadu_ps(a + i);
+    __m128 vb = _mm_loadu_ps(b + i);
+    _mm_storeu_ps(dst + i, _mm_add_ps(va, vb));
+  }
+  snek_kernel_add_f32_scalar(dst + i, a + i, b + i, n - i);
+}
+
+#endif
+
+void snek_kernel_add_i32(int32_t *dst, const int32_t *a, const int32_t *b,
+                         size_t n) {
+#ifdef SNEK_KERNELS_X86
+  if (__builtin_cpu_supports("avx2")) {
+    add_i32_avx2(dst, a, b, n);
+    return;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    add_i32_sse2(dst, a, b, n);
+    return;
+  }
+#endif
+  snek_kernel_add_i32_scalar(dst, a, b, n);
+}
+
+void snek_kernel_add_f32(float *dst, const float *a, const float *b, size_t n) {
+#ifdef SNEK_KERNELS_X86
+  if (__builtin_cpu_supports("avx2")) {
+    add_f32_avx2(dst, a, b, n);
+    return;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    add_f32_sse2(dst, a, b, n);
+    return;
+  }
+#endif
+  snek_kernel_add_f32_scalar(dst, a, b, n);
+}
+
+void snek_kernel_add_f32x4(float *dst, const float *a, const float *b) {
+#ifdef __x86_64__
+  // SSE is part of the x86-64 baseline, so no dispatch is needed here.
+  // 32-bit x86 builds don't assume it and take the scalar loop.
+  _mm_storeu_ps(dst, _mm_add_ps(_mm_loadu_ps(a), _mm_loadu_ps(b)));
+#else
+  snek_kernel_add_f32_scalar(dst, a, b, 4);
+#endif
+}
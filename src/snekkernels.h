@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/// Elementwise `dst[i] = a[i] + b[i]` over unboxed buffers.
+/// Dispatches to AVX2 or SSE2 when available, scalar otherwise.
+void snek_kernel_add_i32(int32_t *dst, const int32_t *a, const int32_t *b,
+                         size_t n);
+void snek_kernel_add_f32(float *dst, const float *a, const float *b, size_t n);
+
+/// Adds two packed 4-float vectors with a single SIMD add
+void snek_kernel_add_f32x4(float *dst, const float *a, const float *b);
+
+/// Scalar reference versions, also used for the loop tails
+void snek_kernel_add_i32_scalar(int32_t *dst, const int32_t *a,
+                                const int32_t *b, size_t n);
+void snek_kernel_add_f32_scalar(float *dst, const float *a, const float *b,
+                                size_t n);
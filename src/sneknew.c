@@ -8,7 +8,15 @@
 #include "snekobject.h"
 
 snek_object_t *_new_snek_object(vm_t *vm) {
-  snek_object_t *obj = calloc(1, sizeof(snek_object_t));
+  BOOT_SITE_SCOPE();
+  if (atomic_load_explicit(&vm->safepoint_requested, memory_order_acquire)) {
+    vm_safepoint(vm);
+  }
+  if (vm->gc_stress_interval > 0) {
+    vm_gc_stress_step(vm);
+  }
+  snek_object_t *obj =
+      calloc_as(BOOT_CATEGORY_OBJECT, 1, sizeof(snek_object_t));
   if (obj == NULL) {
     return NULL;
   }
@@ -20,6 +28,7 @@ snek_object_t *_new_snek_object(vm_t *vm) {
 }
 
 snek_object_t *new_snek_integer(int value, vm_t *vm) {
+  BOOT_SITE_SCOPE();
   snek_object_t *obj = _new_snek_object(vm);
   if (obj == NULL) {
     return NULL;
@@ -31,6 +40,7 @@ snek_object_t *new_snek_integer(int value, vm_t *vm) {
 }
 
 snek_object_t *new_snek_float(float value, vm_t *vm) {
+  BOOT_SITE_SCOPE();
   snek_object_t *obj = _new_snek_object(vm);
   if (obj == NULL) {
     return NULL;
@@ -41,28 +51,77 @@ snek_object_t *new_snek_float(float value, vm_t *vm) {
   return obj;
 }
 
-snek_object_t *new_snek_string(char *value, vm_t *vm) {
+snek_object_t *_new_snek_string_owned(char *chars, size_t length, vm_t *vm) {
+  BOOT_SITE_SCOPE();
   snek_object_t *obj = _new_snek_object(vm);
   if (obj == NULL) {
     return NULL;
   }
 
-  size_t len = strlen(value);
-  char *dst = malloc(len + 1);
+  obj->kind = STRING;
+  obj->data.v_string = (snek_string_t){.chars = chars, .length = length};
+
+  return obj;
+}
+
+snek_object_t *new_snek_string_len(const char *value, size_t length,
+                                   vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  char *dst = malloc_as(BOOT_CATEGORY_STRING, length + 1);
   if (dst == NULL) {
-    free(obj);
     return NULL;
   }
-  strcpy(dst, value);
+  memcpy(dst, value, length);
+  dst[length] = '\0';
+
+  snek_object_t *obj = _new_snek_string_owned(dst, length, vm);
+  if (obj == NULL) {
+    free(dst);
+    return NULL;
+  }
+
+  return obj;
+}
+
+snek_object_t *new_snek_string(char *value, vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  return new_snek_string_len(value, strlen(value), vm);
+}
+
+snek_object_t *new_snek_rope(snek_object_t *left, snek_object_t *right,
+                             vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  if (left == NULL || right == NULL || left->kind != STRING ||
+      right->kind != STRING) {
+    return NULL;
+  }
+  size_t depth = snek_string_depth(left) > snek_string_depth(right)
+                     ? snek_string_depth(left)
+                     : snek_string_depth(right);
+  snek_rope_t *rope = malloc_as(BOOT_CATEGORY_STRING, sizeof(snek_rope_t));
+  if (rope == NULL) {
+    return NULL;
+  }
+  *rope = (snek_rope_t){.left = left, .right = right, .depth = depth + 1};
+
+  snek_object_t *obj = _new_snek_object(vm);
+  if (obj == NULL) {
+    free(rope);
+    return NULL;
+  }
 
   obj->kind = STRING;
-  obj->data.v_string = dst;
+  obj->data.v_string = (snek_string_t){
+      .rope = rope,
+      .length = left->data.v_string.length + right->data.v_string.length,
+  };
 
   return obj;
 }
 
 snek_object_t *new_snek_vector3(snek_object_t *x, snek_object_t *y,
                                 snek_object_t *z, vm_t *vm) {
+  BOOT_SITE_SCOPE();
   if (x == NULL || y == NULL || z == NULL)
     return NULL;
   snek_object_t *obj = _new_snek_object(vm);
@@ -77,19 +136,145 @@ snek_object_t *new_snek_vector3(snek_object_t *x, snek_object_t *y,
   return obj;
 }
 
+snek_object_t *new_snek_float_vector3(float x, float y, float z, vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  snek_object_t *obj = _new_snek_object(vm);
+  if (obj == NULL) {
+    return NULL;
+  }
+
+  obj->kind = FLOAT_VECTOR3;
+  obj->data.v_float_vector3 =
+      (snek_float_vector3_t){.x = x, .y = y, .z = z, .pad = 0.0f};
+
+  return obj;
+}
+
 snek_object_t *new_snek_array(size_t size, vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  snek_array_buffer_t *buffer = snek_array_buffer_new(size);
+  if (buffer == NULL) {
+    return NULL;
+  }
+
   snek_object_t *obj = _new_snek_object(vm);
   if (obj == NULL) {
+    snek_array_buffer_release(buffer);
     return NULL;
   }
 
-  snek_object_t **dst = calloc(size, sizeof(snek_object_t *));
-  if (dst == NULL) {
-    free(obj);
+  obj->kind = ARRAY;
+  obj->data.v_array = (snek_array_t){.size = size,
+                                     .elements = buffer->elements,
+                                     .buffer = buffer,
+                                     .split = size};
+  return obj;
+}
+
+snek_object_t *_new_snek_array_shared(snek_array_buffer_t *head,
+                                      size_t head_size,
+                                      snek_array_buffer_t *tail,
+                                      size_t tail_size, vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  snek_object_t *obj = _new_snek_object(vm);
+  if (obj == NULL) {
     return NULL;
   }
 
+  head->ref_count++;
+  if (tail_size > 0) {
+    tail->ref_count++;
+  } else {
+    tail = NULL;
+  }
+
   obj->kind = ARRAY;
-  obj->data.v_array = (snek_array_t){.size = size, .elements = dst};
+  obj->data.v_array = (snek_array_t){
+      .size = head_size + tail_size,
+      .elements = tail == NULL ? head->elements : NULL,
+      .buffer = head,
+      .tail = tail,
+      .split = head_size,
+  };
+  return obj;
+}
+
+snek_object_t *new_snek_int_array(size_t size, vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  // Payload first: once registered, the object can't simply be freed
+  int32_t *dst = calloc_as(BOOT_CATEGORY_ARRAY, size, sizeof(int32_t));
+  if (dst == NULL) {
+    return NULL;
+  }
+
+  snek_object_t *obj = _new_snek_object(vm);
+  if (obj == NULL) {
+    free(dst);
+    return NULL;
+  }
+
+  obj->kind = INT_ARRAY;
+  obj->data.v_int_array = (snek_int_array_t){.size = size, .elements = dst};
+  return obj;
+}
+
+snek_object_t *new_snek_float_array(size_t size, vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  float *dst = calloc_as(BOOT_CATEGORY_ARRAY, size, sizeof(float));
+  if (dst == NULL) {
+    return NULL;
+  }
+
+  snek_object_t *obj = _new_snek_object(vm);
+  if (obj == NULL) {
+    free(dst);
+    return NULL;
+  }
+
+  obj->kind = FLOAT_ARRAY;
+  obj->data.v_float_array = (snek_float_array_t){.size = size, .elements = dst};
+  return obj;
+}
+
+snek_object_t *new_snek_slice(snek_object_t *array, size_t offset,
+                              size_t length, vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  if (array == NULL) {
+    return NULL;
+  }
+
+  snek_object_t *parent = array;
+  if (array->kind == SLICE) {
+    parent = array->data.v_slice.parent;
+    if (offset > array->data.v_slice.length ||
+        length > array->data.v_slice.length - offset) {
+      return NULL;
+    }
+    offset += array->data.v_slice.offset;
+  } else if (array->kind != ARRAY || offset > array->data.v_array.size ||
+             length > array->data.v_array.size - offset) {
+    return NULL;
+  }
+
+  snek_object_t *obj = _new_snek_object(vm);
+  if (obj == NULL) {
+    return NULL;
+  }
+
+  obj->kind = SLICE;
+  obj->data.v_slice =
+      (snek_slice_t){.parent = parent, .offset = offset, .length = length};
+  return obj;
+}
+
+snek_object_t *new_snek_pvec(vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  snek_object_t *obj = _new_snek_object(vm);
+  if (obj == NULL) {
+    return NULL;
+  }
+
+  obj->kind = PVECTOR;
+  obj->data.v_pvec = (snek_pvec_t){.root = NULL, .size = 0};
   return obj;
 }
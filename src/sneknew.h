@@ -7,6 +7,24 @@ snek_object_t *_new_snek_object(vm_t *vm);
 snek_object_t *new_snek_integer(int value, vm_t *vm);
 snek_object_t *new_snek_float(float value, vm_t *vm);
 snek_object_t *new_snek_string(char *value, vm_t *vm);
+snek_object_t *new_snek_string_len(const char *value, size_t length,
+                                   vm_t *vm);
+/// Takes ownership of `chars`, which must hold `length` bytes plus a NUL
+snek_object_t *_new_snek_string_owned(char *chars, size_t length, vm_t *vm);
+snek_object_t *new_snek_rope(snek_object_t *left, snek_object_t *right,
+                             vm_t *vm);
 snek_object_t *new_snek_array(size_t size, vm_t *vm);
+/// Array over the first `head_size` elements of `head` followed by the
+/// first `tail_size` of `tail`, both buffers are retained
+snek_object_t *_new_snek_array_shared(snek_array_buffer_t *head,
+                                      size_t head_size,
+                                      snek_array_buffer_t *tail,
+                                      size_t tail_size, vm_t *vm);
+snek_object_t *new_snek_int_array(size_t size, vm_t *vm);
+snek_object_t *new_snek_float_array(size_t size, vm_t *vm);
 snek_object_t *new_snek_vector3(snek_object_t *x, snek_object_t *y,
-                                snek_object_t *z, vm_t *vm);
\ No newline at end of file
+                                snek_object_t *z, vm_t *vm);
+snek_object_t *new_snek_float_vector3(float x, float y, float z, vm_t *vm);
+snek_object_t *new_snek_slice(snek_object_t *array, size_t offset,
+                              size_t length, vm_t *vm);
+snek_object_t *new_snek_pvec(vm_t *vm);
@@ -3,7 +3,102 @@
 #include <stdio.h>
 #include <string.h>
 
+#include "snekkernels.h"
+#include "sneknew.h"
 #include "snekobject.h"
+#include "snekpvec.h"
+#include "stack.h"
+
+// Concats up to this many bytes are copied into a flat string, longer
+// ones become rope nodes
+#define SNEK_ROPE_FLAT_MAX 64
+// Ropes built by concatenation stay balanced, deeper ones can only come
+// from `new_snek_rope` and are rebuilt as balanced trees
+#define SNEK_ROPE_MAX_DEPTH 48
+
+snek_array_buffer_t *snek_array_buffer_new(size_t capacity)
+{
+  snek_array_buffer_t *buffer =
+      calloc_as(BOOT_CATEGORY_ARRAY, 1,
+                sizeof(snek_array_buffer_t) +
+                    capacity * sizeof(snek_object_t *));
+  if (buffer == NULL)
+  {
+    return NULL;
+  }
+
+  buffer->ref_count = 1;
+  buffer->capacity = capacity;
+  return buffer;
+}
+
+void snek_array_buffer_release(snek_array_buffer_t *buffer)
+{
+  if (buffer == NULL)
+  {
+    return;
+  }
+
+  buffer->ref_count--;
+  if (buffer->ref_count == 0)
+  {
+    free(buffer);
+  }
+}
+
+// Copies elements [start, start + count) of `array` into `dst`
+static void snek_array_copy_out(snek_array_t *array, size_t start, size_t count,
+                                snek_object_t **dst)
+{
+  if (start < array->split)
+  {
+    size_t head = array->split - start < count ? array->split - start : count;
+    memcpy(dst, array->buffer->elements + start,
+           head * sizeof(snek_object_t *));
+    dst += head;
+    start += head;
+    count -= head;
+  }
+  if (count > 0)
+  {
+    memcpy(dst, array->tail->elements + (start - array->split),
+           count * sizeof(snek_object_t *));
+  }
+}
+
+// Moves the elements into one buffer, which is also made private to this
+// array when `for_write` is set
+static bool snek_array_unshare(snek_array_t *array, bool for_write)
+{
+  if (array->tail == NULL && (!for_write || array->buffer->ref_count == 1))
+  {
+    return true;
+  }
+
+  snek_array_buffer_t *copy = snek_array_buffer_new(array->size);
+  if (copy == NULL)
+  {
+    return false;
+  }
+  snek_array_copy_out(array, 0, array->size, copy->elements);
+
+  snek_array_buffer_release(array->buffer);
+  snek_array_buffer_release(array->tail);
+  array->buffer = copy;
+  array->tail = NULL;
+  array->split = array->size;
+  array->elements = copy->elements;
+  return true;
+}
+
+bool snek_array_detach(snek_object_t *array)
+{
+  if (array == NULL || array->kind != ARRAY)
+  {
+    return false;
+  }
+  return snek_array_unshare(&array->data.v_array, true);
+}
 
 bool snek_array_set(snek_object_t *snek_obj, size_t index,
                     snek_object_t *value)
@@ -12,11 +107,24 @@ bool snek_array_set(snek_object_t *snek_obj, size_t index,
   {
     return false;
   }
+  if (snek_obj->kind == SLICE)
+  {
+    snek_slice_t *slice = &snek_obj->data.v_slice;
+    if (index >= slice->length)
+    {
+      return false;
+    }
+    return snek_array_set(slice->parent, slice->offset + index, value);
+  }
   if (snek_obj->kind != ARRAY)
   {
     return false;
   }
-  if (index >= snek_obj->data.v_array.size || index < 0)
+  if (index >= snek_obj->data.v_array.size)
+  {
+    return false;
+  }
+  if (!snek_array_unshare(&snek_obj->data.v_array, true))
   {
     return false;
   }
@@ -31,16 +139,30 @@ snek_object_t *snek_array_get(snek_object_t *snek_obj, size_t index)
   {
     return NULL;
   }
+  if (snek_obj->kind == SLICE)
+  {
+    snek_slice_t *slice = &snek_obj->data.v_slice;
+    if (index >= slice->length)
+    {
+      return NULL;
+    }
+    return snek_array_get(slice->parent, slice->offset + index);
+  }
   if (snek_obj->kind != ARRAY)
   {
     return NULL;
   }
-  if (index >= snek_obj->data.v_array.size || index < 0)
+
+  snek_array_t *array = &snek_obj->data.v_array;
+  if (index >= array->size)
   {
     return NULL;
   }
-
-  return snek_obj->data.v_array.elements[index];
+  if (index < array->split)
+  {
+    return array->buffer->elements[index];
+  }
+  return array->tail->elements[index - array->split];
 }
 
 int snek_length(snek_object_t *obj)
@@ -56,18 +178,444 @@ int snek_length(snek_object_t *obj)
   case FLOAT:
     return 1;
   case STRING:
-    return strlen(obj->data.v_string);
+    return obj->data.v_string.length;
   case VECTOR3:
+  case FLOAT_VECTOR3:
     return 3;
   case ARRAY:
     return obj->data.v_array.size;
+  case SLICE:
+    return obj->data.v_slice.length;
+  case PVECTOR:
+    return obj->data.v_pvec.size;
+  case INT_ARRAY:
+    return obj->data.v_int_array.size;
+  case FLOAT_ARRAY:
+    return obj->data.v_float_array.size;
   default:
     return -1;
   }
 }
 
-snek_object_t *snek_add(snek_object_t *a, snek_object_t *b)
+static size_t snek_array_buffer_bytes(snek_array_buffer_t *buffer)
+{
+  if (buffer == NULL)
+  {
+    return 0;
+  }
+  return (sizeof(snek_array_buffer_t) +
+          buffer->capacity * sizeof(snek_object_t *)) /
+         buffer->ref_count;
+}
+
+size_t snek_object_size(snek_object_t *obj)
+{
+  if (obj == NULL)
+  {
+    return 0;
+  }
+
+  size_t size = sizeof(snek_object_t);
+  switch (obj->kind)
+  {
+  case STRING:
+    if (obj->data.v_string.chars != NULL)
+    {
+      size += obj->data.v_string.length + 1;
+    }
+    else
+    {
+      size += sizeof(snek_rope_t);
+    }
+    break;
+  case ARRAY:
+    size += snek_array_buffer_bytes(obj->data.v_array.buffer);
+    size += snek_array_buffer_bytes(obj->data.v_array.tail);
+    break;
+  case PVECTOR:
+    size += snek_pvec_bytes(obj);
+    break;
+  case INT_ARRAY:
+    size += obj->data.v_int_array.size * sizeof(int32_t);
+    break;
+  case FLOAT_ARRAY:
+    size += obj->data.v_float_array.size * sizeof(float);
+    break;
+  default:
+    break;
+  }
+  return size;
+}
+
+static bool snek_string_flatten(snek_object_t *obj)
+{
+  snek_string_t *str = &obj->data.v_string;
+  if (str->chars != NULL)
+  {
+    return true;
+  }
+
+  char *dst = malloc_as(BOOT_CATEGORY_STRING, str->length + 1);
+  if (dst == NULL)
+  {
+    return false;
+  }
+
+  stack_t *pending = stack_new(str->rope->depth + 1);
+  if (pending == NULL)
+  {
+    free(dst);
+    return false;
+  }
+
+  // In-order walk over the leaves, right child pushed first
+  size_t offset = 0;
+  stack_push(pending, obj);
+  while (pending->count > 0)
+  {
+    snek_object_t *node = stack_pop(pending);
+    snek_string_t *part = &node->data.v_string;
+    if (part->chars != NULL)
+    {
+      memcpy(dst + offset, part->chars, part->length);
+      offset += part->length;
+      continue;
+    }
+    stack_push(pending, part->rope->right);
+    stack_push(pending, part->rope->left);
+  }
+  stack_free(pending);
+  dst[offset] = '\0';
+
+  // The children become garbage unless something else references them
+  str->chars = dst;
+  free(str->rope);
+  str->rope = NULL;
+  return true;
+}
+
+const char *snek_string_chars(snek_object_t *obj)
+{
+  if (obj == NULL || obj->kind != STRING)
+  {
+    return NULL;
+  }
+  if (!snek_string_flatten(obj))
+  {
+    return NULL;
+  }
+
+  return obj->data.v_string.chars;
+}
+
+size_t snek_string_depth(snek_object_t *obj)
+{
+  snek_rope_t *rope = obj->data.v_string.rope;
+  return rope == NULL ? 0 : rope->depth;
+}
+
+uint64_t snek_string_hash(snek_object_t *obj)
+{
+  const char *chars = snek_string_chars(obj);
+  if (chars == NULL)
+  {
+    return 0;
+  }
+
+  snek_string_t *str = &obj->data.v_string;
+  if (str->hash != 0)
+  {
+    return str->hash;
+  }
+
+  // FNV-1a over every byte, embedded NULs included
+  uint64_t hash = 0xcbf29ce484222325ULL;
+  for (size_t i = 0; i < str->length; i++)
+  {
+    hash ^= (unsigned char)chars[i];
+    hash *= 0x100000001b3ULL;
+  }
+  // 0 marks "not computed yet"
+  str->hash = hash != 0 ? hash : 1;
+  return str->hash;
+}
+
+bool snek_string_equal(snek_object_t *a, snek_object_t *b)
+{
+  if (a == NULL || b == NULL || a->kind != STRING || b->kind != STRING)
+  {
+    return false;
+  }
+  if (a == b)
+  {
+    return true;
+  }
+  if (a->data.v_string.length != b->data.v_string.length)
+  {
+    return false;
+  }
+  if (snek_string_hash(a) != snek_string_hash(b))
+  {
+    return false;
+  }
+
+  return memcmp(a->data.v_string.chars, b->data.v_string.chars,
+                a->data.v_string.length) == 0;
+}
+
+static snek_object_t *snek_string_join_flat(snek_object_t *a, snek_object_t *b,
+                                            vm_t *vm)
 {
+  const char *chars_a = snek_string_chars(a);
+  const char *chars_b = snek_string_chars(b);
+  if (chars_a == NULL || chars_b == NULL)
+  {
+    return NULL;
+  }
+
+  size_t len_a = a->data.v_string.length;
+  size_t len_b = b->data.v_string.length;
+  char *dst = malloc_as(BOOT_CATEGORY_STRING, len_a + len_b + 1);
+  if (dst == NULL)
+  {
+    return NULL;
+  }
+  memcpy(dst, chars_a, len_a);
+  memcpy(dst + len_a, chars_b, len_b);
+  dst[len_a + len_b] = '\0';
+
+  snek_object_t *joined = _new_snek_string_owned(dst, len_a + len_b, vm);
+  if (joined == NULL)
+  {
+    free(dst);
+  }
+  return joined;
+}
+
+static snek_object_t *snek_rope_build(stack_t *leaves, size_t lo, size_t hi,
+                                      vm_t *vm)
+{
+  if (hi - lo == 1)
+  {
+    return leaves->data[lo];
+  }
+
+  size_t mid = lo + (hi - lo) / 2;
+  snek_object_t *left = snek_rope_build(leaves, lo, mid, vm);
+  snek_object_t *right = snek_rope_build(leaves, mid, hi, vm);
+  return new_snek_rope(left, right, vm);
+}
+
+static snek_object_t *snek_rope_rebalance(snek_object_t *left,
+                                          snek_object_t *right, vm_t *vm)
+{
+  stack_t *leaves = stack_new(64);
+  stack_t *pending = stack_new(SNEK_ROPE_MAX_DEPTH * 2);
+  if (leaves == NULL || pending == NULL)
+  {
+    stack_free(leaves);
+    stack_free(pending);
+    return NULL;
+  }
+
+  stack_push(pending, right);
+  stack_push(pending, left);
+  while (pending->count > 0)
+  {
+    snek_object_t *node = stack_pop(pending);
+    if (node->data.v_string.chars != NULL)
+    {
+      stack_push(leaves, node);
+      continue;
+    }
+    stack_push(pending, node->data.v_string.rope->right);
+    stack_push(pending, node->data.v_string.rope->left);
+  }
+
+  snek_object_t *balanced = snek_rope_build(leaves, 0, leaves->count, vm);
+  stack_free(leaves);
+  stack_free(pending);
+  return balanced;
+}
+
+static size_t snek_rope_depth_max(snek_object_t *a, snek_object_t *b)
+{
+  size_t depth_a = snek_string_depth(a);
+  size_t depth_b = snek_string_depth(b);
+  return depth_a > depth_b ? depth_a : depth_b;
+}
+
+// AVL join: `left` is more than one level deeper than `right`, which is
+// attached along `left`'s right spine. Only the nodes on that path are
+// copied, so a join costs O(depth) and keeps the result balanced.
+static snek_object_t *snek_rope_join_right(snek_object_t *left,
+                                           snek_object_t *right, vm_t *vm)
+{
+  snek_object_t *outer = left->data.v_string.rope->left;
+  snek_object_t *inner = left->data.v_string.rope->right;
+  size_t depth_outer = snek_string_depth(outer);
+
+  if (snek_string_depth(inner) <= snek_string_depth(right) + 1)
+  {
+    if (snek_rope_depth_max(inner, right) <= depth_outer)
+    {
+      return new_snek_rope(outer, new_snek_rope(inner, right, vm), vm);
+    }
+    // `inner` is a level deeper than both neighbours, split it between them
+    snek_rope_t *split = inner->data.v_string.rope;
+    return new_snek_rope(new_snek_rope(outer, split->left, vm),
+                         new_snek_rope(split->right, right, vm), vm);
+  }
+
+  snek_object_t *joined = snek_rope_join_right(inner, right, vm);
+  if (joined == NULL || snek_string_depth(joined) <= depth_outer + 1)
+  {
+    return new_snek_rope(outer, joined, vm);
+  }
+  snek_rope_t *top = joined->data.v_string.rope;
+  return new_snek_rope(new_snek_rope(outer, top->left, vm), top->right, vm);
+}
+
+// Mirror of `snek_rope_join_right` for a `right` that is deeper
+static snek_object_t *snek_rope_join_left(snek_object_t *left,
+                                          snek_object_t *right, vm_t *vm)
+{
+  snek_object_t *outer = right->data.v_string.rope->right;
+  snek_object_t *inner = right->data.v_string.rope->left;
+  size_t depth_outer = snek_string_depth(outer);
+
+  if (snek_string_depth(inner) <= snek_string_depth(left) + 1)
+  {
+    if (snek_rope_depth_max(left, inner) <= depth_outer)
+    {
+      return new_snek_rope(new_snek_rope(left, inner, vm), outer, vm);
+    }
+    snek_rope_t *split = inner->data.v_string.rope;
+    return new_snek_rope(new_snek_rope(left, split->left, vm),
+                         new_snek_rope(split->right, outer, vm), vm);
+  }
+
+  snek_object_t *joined = snek_rope_join_left(left, inner, vm);
+  if (joined == NULL || snek_string_depth(joined) <= depth_outer + 1)
+  {
+    return new_snek_rope(joined, outer, vm);
+  }
+  snek_rope_t *top = joined->data.v_string.rope;
+  return new_snek_rope(top->left, new_snek_rope(top->right, outer, vm), vm);
+}
+
+// Copies the right spine of `rope` with its last leaf replaced by that
+// leaf followed by `tail`, which the caller checked fits in a flat string
+static snek_object_t *snek_rope_extend_last(snek_object_t *rope,
+                                            snek_object_t *tail, vm_t *vm)
+{
+  if (rope->data.v_string.chars != NULL)
+  {
+    return snek_string_join_flat(rope, tail, vm);
+  }
+  snek_rope_t *node = rope->data.v_string.rope;
+  snek_object_t *last = snek_rope_extend_last(node->right, tail, vm);
+  return last == NULL ? NULL : new_snek_rope(node->left, last, vm);
+}
+
+static snek_object_t *snek_string_concat(snek_object_t *a, snek_object_t *b,
+                                         vm_t *vm)
+{
+  snek_string_t *str_a = &a->data.v_string;
+  snek_string_t *str_b = &b->data.v_string;
+
+  if (str_a->length + str_b->length <= SNEK_ROPE_FLAT_MAX)
+  {
+    return snek_string_join_flat(a, b, vm);
+  }
+
+  // Appending a short piece to a rope: merge it into the rope's last leaf
+  // instead of growing the tree by one tiny leaf per append
+  if (str_a->chars == NULL && str_b->chars != NULL)
+  {
+    snek_object_t *last = str_a->rope->right;
+    while (last->data.v_string.chars == NULL)
+    {
+      last = last->data.v_string.rope->right;
+    }
+    if (last->data.v_string.length + str_b->length <= SNEK_ROPE_FLAT_MAX)
+    {
+      return snek_rope_extend_last(a, b, vm);
+    }
+  }
+
+  size_t depth_a = snek_string_depth(a);
+  size_t depth_b = snek_string_depth(b);
+  if (snek_rope_depth_max(a, b) + 1 > SNEK_ROPE_MAX_DEPTH)
+  {
+    return snek_rope_rebalance(a, b, vm);
+  }
+  if (depth_a > depth_b + 1)
+  {
+    return snek_rope_join_right(a, b, vm);
+  }
+  if (depth_b > depth_a + 1)
+  {
+    return snek_rope_join_left(a, b, vm);
+  }
+  return new_snek_rope(a, b, vm);
+}
+
+// Copies every element of an ARRAY or SLICE into `dst`
+static void snek_array_copy_to(snek_object_t *src, snek_object_t **dst)
+{
+  if (src->kind == SLICE)
+  {
+    snek_slice_t *slice = &src->data.v_slice;
+    snek_array_copy_out(&slice->parent->data.v_array, slice->offset,
+                        slice->length, dst);
+    return;
+  }
+  snek_array_copy_out(&src->data.v_array, 0, src->data.v_array.size, dst);
+}
+
+static snek_object_t *snek_array_concat(snek_object_t *a, snek_object_t *b,
+                                        vm_t *vm)
+{
+  if (a->kind == ARRAY && b->kind == ARRAY)
+  {
+    // Share both element buffers, nothing is copied until the result is
+    // written to. An operand that is itself a pending concat is collapsed
+    // into one buffer first so results never need more than two.
+    snek_array_t *array_a = &a->data.v_array;
+    snek_array_t *array_b = &b->data.v_array;
+    if (!snek_array_unshare(array_a, false) ||
+        !snek_array_unshare(array_b, false))
+    {
+      return NULL;
+    }
+    if (array_a->size == 0)
+    {
+      return _new_snek_array_shared(array_b->buffer, array_b->size, NULL, 0,
+                                    vm);
+    }
+    return _new_snek_array_shared(array_a->buffer, array_a->size,
+                                  array_b->buffer, array_b->size, vm);
+  }
+
+  // Slices view part of a buffer, copy them out in bulk
+  size_t len_a = snek_length(a);
+  size_t len_b = snek_length(b);
+  snek_object_t *new_array = new_snek_array(len_a + len_b, vm);
+  if (new_array == NULL)
+  {
+    return NULL;
+  }
+  snek_array_copy_to(a, new_array->data.v_array.elements);
+  snek_array_copy_to(b, new_array->data.v_array.elements + len_a);
+  return new_array;
+}
+
+snek_object_t *snek_add(snek_object_t *a, snek_object_t *b, vm_t *vm)
+{
+  BOOT_SITE_SCOPE();
+  // Vector3 sums and rope rebalancing hold new objects nothing roots yet
+  VM_GC_INHIBIT_SCOPE(vm);
   if (a == NULL || b == NULL)
   {
     return NULL;
@@ -79,9 +627,9 @@ snek_object_t *snek_add(snek_object_t *a, snek_object_t *b)
     switch (b->kind)
     {
     case INTEGER:
-      return new_snek_integer(a->data.v_int + b->data.v_int);
+      return new_snek_integer(a->data.v_int + b->data.v_int, vm);
     case FLOAT:
-      return new_snek_float(a->data.v_int + b->data.v_float);
+      return new_snek_float(a->data.v_int + b->data.v_float, vm);
     default:
       return NULL;
     }
@@ -89,9 +637,9 @@ snek_object_t *snek_add(snek_object_t *a, snek_object_t *b)
     switch (b->kind)
     {
     case INTEGER:
-      return new_snek_float(a->data.v_float + b->data.v_int);
+      return new_snek_float(a->data.v_float + b->data.v_int, vm);
     case FLOAT:
-      return new_snek_float(a->data.v_float + b->data.v_float);
+      return new_snek_float(a->data.v_float + b->data.v_float, vm);
     default:
       return NULL;
     }
@@ -99,14 +647,7 @@ snek_object_t *snek_add(snek_object_t *a, snek_object_t *b)
     switch (b->kind)
     {
     case STRING:
-      size_t new_len = strlen(a->data.v_string) + strlen(b->data.v_string) + 1;
-      char *dst = calloc(new_len, sizeof(char));
-      strcat(dst, a->data.v_string);
-      strcat(dst, b->data.v_string);
-      snek_object_t *new_str = new_snek_string(dst);
-
-      free(dst);
-      return new_str;
+      return snek_string_concat(a, b, vm);
 
     default:
       return NULL;
@@ -117,32 +658,99 @@ snek_object_t *snek_add(snek_object_t *a, snek_object_t *b)
     {
     case VECTOR3:
       return new_snek_vector3(
-          snek_add(a->data.v_vector3.x, b->data.v_vector3.x),
-          snek_add(a->data.v_vector3.y, b->data.v_vector3.y),
-          snek_add(a->data.v_vector3.z, b->data.v_vector3.z));
+          snek_add(a->data.v_vector3.x, b->data.v_vector3.x, vm),
+          snek_add(a->data.v_vector3.y, b->data.v_vector3.y, vm),
+          snek_add(a->data.v_vector3.z, b->data.v_vector3.z, vm), vm);
     default:
       return NULL;
     }
 
   case ARRAY:
+  case SLICE:
     switch (b->kind)
     {
     case ARRAY:
-      int len_a = snek_length(a);
-      int len_b = snek_length(b);
+    case SLICE:
+      return snek_array_concat(a, b, vm);
+    default:
+      return NULL;
+    }
+
+  case PVECTOR:
+    switch (b->kind)
+    {
+    case PVECTOR:
+      return snek_pvec_concat(a, b, vm);
+    default:
+      return NULL;
+    }
 
-      snek_object_t *new_array = new_snek_array(len_a + len_b);
+  case FLOAT_VECTOR3:
+    switch (b->kind)
+    {
+    case FLOAT_VECTOR3:
+    {
+      snek_object_t *vector_sum = new_snek_float_vector3(0.0f, 0.0f, 0.0f, vm);
+      if (vector_sum == NULL)
+      {
+        return NULL;
+      }
+      snek_kernel_add_f32x4(&vector_sum->data.v_float_vector3.x,
+                            &a->data.v_float_vector3.x,
+                            &b->data.v_float_vector3.x);
+      return vector_sum;
+    }
+    default:
+      return NULL;
+    }
 
-      for (int i = 0; i < len_a; i++)
+  case INT_ARRAY:
+    switch (b->kind)
+    {
+    case INT_ARRAY:
+    {
+      if (a->data.v_int_array.size != b->data.v_int_array.size)
       {
-        snek_array_set(new_array, i, snek_array_get(a, i));
+        return NULL;
       }
 
-      for (int i = 0; i < len_b; i++)
+      snek_object_t *int_sum = new_snek_int_array(a->data.v_int_array.size, vm);
+      if (int_sum == NULL)
       {
-        snek_array_set(new_array, i + len_a, snek_array_get(b, i));
+        return NULL;
       }
-      return new_array;
+      snek_kernel_add_i32(int_sum->data.v_int_array.elements,
+                          a->data.v_int_array.elements,
+                          b->data.v_int_array.elements,
+                          a->data.v_int_array.size);
+      return int_sum;
+    }
+    default:
+      return NULL;
+    }
+
+  case FLOAT_ARRAY:
+    switch (b->kind)
+    {
+    case FLOAT_ARRAY:
+    {
+      if (a->data.v_float_array.size != b->data.v_float_array.size)
+      {
+        return NULL;
+      }
+
+      snek_object_t *float_sum =
+          new_snek_float_array(a->data.v_float_array.size, vm);
+      if (float_sum == NULL)
+      {
+        return NULL;
+      }
+      snek_kernel_add_f32(float_sum->data.v_float_array.elements,
+                          a->data.v_float_array.elements,
+                          b->data.v_float_array.elements,
+                          a->data.v_float_array.size);
+      return float_sum;
+    }
     default:
       return NULL;
     }
@@ -159,13 +767,28 @@ void snek_object_free(snek_object_t *obj)
   case FLOAT:
     break;
   case STRING:
-    free(obj->data.v_string);
+    free(obj->data.v_string.chars);
+    free(obj->data.v_string.rope);
     break;
   case VECTOR3:
+  case FLOAT_VECTOR3:
+  case SLICE:
     break;
   case ARRAY:
+  {
     snek_array_t *array = &obj->data.v_array;
-    free(array->elements);
+    snek_array_buffer_release(array->buffer);
+    snek_array_buffer_release(array->tail);
+    break;
+  }
+  case PVECTOR:
+    snek_pvec_node_release(obj->data.v_pvec.root);
+    break;
+  case INT_ARRAY:
+    free(obj->data.v_int_array.elements);
+    break;
+  case FLOAT_ARRAY:
+    free(obj->data.v_float_array.elements);
     break;
   }
   free(obj);
@@ -1,15 +1,86 @@
 #pragma once
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 typedef struct SnekObject snek_object_t;
+typedef struct VirtualMachine vm_t;
 
+// Element storage, shared between arrays. An array copies a buffer with
+// ref_count > 1 before its first write.
+typedef struct SnekArrayBuffer
+{
+  size_t ref_count;
+  size_t capacity;
+  snek_object_t *elements[];
+} snek_array_buffer_t;
+
+// The first `split` elements live in `buffer`. A concat that hasn't been
+// written to yet keeps the remaining `size - split` in `tail`, and
+// `elements` is NULL until the halves are copied into one private buffer.
 typedef struct
 {
   size_t size;
   snek_object_t **elements;
+  snek_array_buffer_t *buffer;
+  snek_array_buffer_t *tail;
+  size_t split;
 } snek_array_t;
 
+// Concat node of a rope STRING: its contents are `left` followed by
+// `right`. Kept out of line so flat strings and every other object don't
+// carry the rope fields in their header.
+typedef struct SnekRope
+{
+  snek_object_t *left;
+  snek_object_t *right;
+  size_t depth;
+} snek_rope_t;
+
+// A STRING is either flat (`chars` set) or a rope (`rope` set). Ropes are
+// flattened in place the first time their contents are read.
+// `length` counts bytes and the contents may contain NULs, `chars` is
+// still NUL terminated for convenience. `hash` is 0 until first computed.
+typedef struct
+{
+  char *chars;
+  snek_rope_t *rope;
+  size_t length;
+  uint64_t hash;
+} snek_string_t;
+
+// A view of `length` elements of `parent` starting at `offset`. The parent
+// is always an ARRAY, slices of slices point at the underlying array.
+typedef struct
+{
+  snek_object_t *parent;
+  size_t offset;
+  size_t length;
+} snek_slice_t;
+
+typedef struct SnekPvecNode snek_pvec_node_t;
+
+// Persistent vector, see snekpvec.h. A transient is updated in place.
+typedef struct
+{
+  snek_pvec_node_t *root;
+  size_t size;
+  bool transient;
+} snek_pvec_t;
+
+// Unboxed numeric arrays, elements are stored inline and never traced
+typedef struct
+{
+  size_t size;
+  int32_t *elements;
+} snek_int_array_t;
+
+typedef struct
+{
+  size_t size;
+  float *elements;
+} snek_float_array_t;
+
 typedef struct
 {
   snek_object_t *x;
@@ -17,6 +88,16 @@ typedef struct
   snek_object_t *z;
 } snek_vector_t;
 
+// Unboxed vector3, padded to 16 bytes so it loads into one SIMD register.
+// Loads are unaligned, aligning it would round every object up to 16.
+typedef struct
+{
+  float x;
+  float y;
+  float z;
+  float pad;
+} snek_float_vector3_t;
+
 typedef enum SnekObjectKind
 {
   INTEGER,
@@ -24,15 +105,25 @@ typedef enum SnekObjectKind
   STRING,
   ARRAY,
   VECTOR3,
+  INT_ARRAY,
+  FLOAT_ARRAY,
+  FLOAT_VECTOR3,
+  SLICE,
+  PVECTOR,
 } snek_object_kind_t;
 
 typedef union SnekObjectData
 {
   int v_int;
   float v_float;
-  char *v_string;
+  snek_string_t v_string;
   snek_array_t v_array;
   snek_vector_t v_vector3;
+  snek_int_array_t v_int_array;
+  snek_float_array_t v_float_array;
+  snek_float_vector3_t v_float_vector3;
+  snek_slice_t v_slice;
+  snek_pvec_t v_pvec;
 } snek_object_data_t;
 
 typedef struct SnekObject
@@ -54,7 +145,22 @@ typedef struct SnekObject
 // snek_object_t *new_snek_vector3(snek_object_t *x, snek_object_t *y,
 //                                 snek_object_t *z);
 
+snek_array_buffer_t *snek_array_buffer_new(size_t capacity);
+void snek_array_buffer_release(snek_array_buffer_t *buffer);
+
+/// Gives an ARRAY a buffer of its own, copying it out of any buffer it
+/// shares with other arrays
+bool snek_array_detach(snek_object_t *array);
 bool snek_array_set(snek_object_t *array, size_t index, snek_object_t *value);
 snek_object_t *snek_array_get(snek_object_t *array, size_t index);
-snek_object_t *snek_add(snek_object_t *a, snek_object_t *b);
-void snek_object_free(snek_object_t *obj);
\ No newline at end of file
+int snek_length(snek_object_t *obj);
+/// Bytes owned by `obj`: its header plus payload, with buffers shared
+/// copy-on-write split evenly between their owners
+size_t snek_object_size(snek_object_t *obj);
+const char *snek_string_chars(snek_object_t *obj);
+/// Height of a rope, 0 for a flat string
+size_t snek_string_depth(snek_object_t *obj);
+uint64_t snek_string_hash(snek_object_t *obj);
+bool snek_string_equal(snek_object_t *a, snek_object_t *b);
+snek_object_t *snek_add(snek_object_t *a, snek_object_t *b, vm_t *vm);
+void snek_object_free(snek_object_t *obj);
@@ -0,0 +1,731 @@
+#include "bootmem.h"
+#include <string.h>
+
+#include "sneknew.h"
+#include "snekpvec.h"
+#include "vm.h"
+
+// Concat rebalancing: a node may hold one slot less than full before it
+// is merged, and a level may keep two nodes more than the optimum
+#define PVEC_INVARIANT 1
+#define PVEC_EXTRAS 2
+
+static snek_pvec_node_t *node_new(uint32_t height) {
+  size_t size = sizeof(snek_pvec_node_t);
+  if (height > 0) {
+    size += SNEK_PVEC_BRANCH * sizeof(size_t);
+  }
+
+  snek_pvec_node_t *node = calloc_as(BOOT_CATEGORY_ARRAY, 1, size);
+  if (node == NULL) {
+    return NULL;
+  }
+  node->ref_count = 1;
+  node->height = height;
+  return node;
+}
+
+static snek_pvec_node_t *node_retain(snek_pvec_node_t *node) {
+  node->ref_count++;
+  return node;
+}
+
+void snek_pvec_node_release(snek_pvec_node_t *node) {
+  if (node == NULL) {
+    return;
+  }
+  node->ref_count--;
+  if (node->ref_count > 0) {
+    return;
+  }
+
+  if (node->height > 0) {
+    for (uint32_t i = 0; i < node->count; i++) {
+      snek_pvec_node_release(node->slots[i]);
+    }
+  }
+  free(node);
+}
+
+snek_pvec_node_t *snek_pvec_tree_copy(snek_pvec_node_t *node,
+                                      snek_object_t *(*map)(void *ctx,
+                                                            snek_object_t *),
+                                      void *ctx) {
+  if (node == NULL) {
+    return NULL;
+  }
+  snek_pvec_node_t *copy = node_new(node->height);
+  if (copy == NULL) {
+    return NULL;
+  }
+
+  if (node->height == 0) {
+    for (uint32_t i = 0; i < node->count; i++) {
+      copy->slots[i] = map != NULL ? map(ctx, node->slots[i]) : node->slots[i];
+    }
+    copy->count = node->count;
+    return copy;
+  }
+  memcpy(copy->sizes, node->sizes, node->count * sizeof(size_t));
+  for (uint32_t i = 0; i < node->count; i++) {
+    copy->slots[i] = snek_pvec_tree_copy(node->slots[i], map, ctx);
+    if (copy->slots[i] == NULL) {
+      snek_pvec_node_release(copy);
+      return NULL;
+    }
+    // Counted as it goes so a failed copy releases only what it made
+    copy->count = i + 1;
+  }
+  return copy;
+}
+
+static size_t node_bytes(snek_pvec_node_t *node) {
+  size_t bytes = sizeof(snek_pvec_node_t);
+  if (node->height > 0) {
+    bytes += SNEK_PVEC_BRANCH * sizeof(size_t);
+    for (uint32_t i = 0; i < node->count; i++) {
+      bytes += node_bytes(node->slots[i]);
+    }
+  }
+  // Shared nodes are split evenly between their owners
+  return bytes / node->ref_count;
+}
+
+size_t snek_pvec_bytes(snek_object_t *vec) {
+  snek_pvec_node_t *root = vec->data.v_pvec.root;
+  return root == NULL ? 0 : node_bytes(root);
+}
+
+static size_t node_size(snek_pvec_node_t *node) {
+  if (node == NULL) {
+    return 0;
+  }
+  return node->height == 0 ? node->count : node->sizes[node->count - 1];
+}
+
+static void node_update_sizes(snek_pvec_node_t *node) {
+  size_t total = 0;
+  for (uint32_t i = 0; i < node->count; i++) {
+    total += node_size(node->slots[i]);
+    node->sizes[i] = total;
+  }
+}
+
+// Slot holding `*index` in an internal node, `*index` becomes the offset
+// into that child. The radix guess is exact for full nodes and a lower
+// bound for relaxed ones.
+static uint32_t node_find_slot(snek_pvec_node_t *node, size_t *index) {
+  uint32_t slot = (uint32_t)(*index >> (SNEK_PVEC_BITS * node->height));
+  if (slot >= node->count) {
+    slot = node->count - 1;
+  }
+  while (node->sizes[slot] <= *index) {
+    slot++;
+  }
+  if (slot > 0) {
+    *index -= node->sizes[slot - 1];
+  }
+  return slot;
+}
+
+static snek_pvec_node_t *node_copy(snek_pvec_node_t *node) {
+  snek_pvec_node_t *copy = node_new(node->height);
+  if (copy == NULL) {
+    return NULL;
+  }
+
+  copy->count = node->count;
+  memcpy(copy->slots, node->slots, node->count * sizeof(void *));
+  if (node->height > 0) {
+    memcpy(copy->sizes, node->sizes, node->count * sizeof(size_t));
+    for (uint32_t i = 0; i < node->count; i++) {
+      node_retain(copy->slots[i]);
+    }
+  }
+  return copy;
+}
+
+// Owned reference to a node that may be modified: `node` itself when a
+// transient holds the only reference, a copy otherwise
+static snek_pvec_node_t *node_edit(snek_pvec_node_t *node, bool in_place) {
+  if (in_place && node->ref_count == 1) {
+    return node_retain(node);
+  }
+  return node_copy(node);
+}
+
+// Stores an owned `child` into an internal node, dropping the old one
+static void node_replace(snek_pvec_node_t *node, uint32_t slot,
+                         snek_pvec_node_t *child) {
+  snek_pvec_node_release(node->slots[slot]);
+  node->slots[slot] = child;
+}
+
+static snek_object_t *pvec_wrap(snek_pvec_node_t *root, size_t size,
+                                vm_t *vm) {
+  snek_object_t *obj = new_snek_pvec(vm);
+  if (obj == NULL) {
+    snek_pvec_node_release(root);
+    return NULL;
+  }
+  obj->data.v_pvec.root = root;
+  obj->data.v_pvec.size = size;
+  return obj;
+}
+
+// Transients take the new root themselves, persistent vectors return a
+// new object for it
+static snek_object_t *pvec_update(snek_object_t *vec, snek_pvec_node_t *root,
+                                  size_t size, vm_t *vm) {
+  if (vec->data.v_pvec.transient) {
+    snek_pvec_node_release(vec->data.v_pvec.root);
+    vec->data.v_pvec.root = root;
+    vec->data.v_pvec.size = size;
+    return vec;
+  }
+  return pvec_wrap(root, size, vm);
+}
+
+snek_object_t *snek_pvec_get(snek_object_t *vec, size_t index) {
+  if (vec == NULL || vec->kind != PVECTOR || index >= vec->data.v_pvec.size) {
+    return NULL;
+  }
+
+  snek_pvec_node_t *node = vec->data.v_pvec.root;
+  while (node->height > 0) {
+    node = node->slots[node_find_slot(node, &index)];
+  }
+  return node->slots[index];
+}
+
+// Update -----------------------------------------------------------------
+
+static snek_pvec_node_t *set_rec(snek_pvec_node_t *node, size_t index,
+                                 snek_object_t *value, bool in_place) {
+  snek_pvec_node_t *edit = node_edit(node, in_place);
+  if (edit == NULL) {
+    return NULL;
+  }
+  if (node->height == 0) {
+    edit->slots[index] = value;
+    return edit;
+  }
+
+  uint32_t slot = node_find_slot(node, &index);
+  snek_pvec_node_t *child = set_rec(node->slots[slot], index, value, in_place);
+  if (child == NULL) {
+    snek_pvec_node_release(edit);
+    return NULL;
+  }
+  node_replace(edit, slot, child);
+  return edit;
+}
+
+snek_object_t *snek_pvec_set(snek_object_t *vec, size_t index,
+                             snek_object_t *value, vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  if (vec == NULL || vec->kind != PVECTOR || index >= vec->data.v_pvec.size) {
+    return NULL;
+  }
+
+  snek_pvec_node_t *root = set_rec(vec->data.v_pvec.root, index, value,
+                                   vec->data.v_pvec.transient);
+  if (root == NULL) {
+    return NULL;
+  }
+  return pvec_update(vec, root, vec->data.v_pvec.size, vm);
+}
+
+// Push -------------------------------------------------------------------
+
+// A path of single-slot nodes from `height` down to a leaf holding `value`
+static snek_pvec_node_t *path_new(uint32_t height, snek_object_t *value) {
+  snek_pvec_node_t *node = node_new(height);
+  if (node == NULL) {
+    return NULL;
+  }
+  if (height == 0) {
+    node->slots[0] = value;
+  } else {
+    node->slots[0] = path_new(height - 1, value);
+    if (node->slots[0] == NULL) {
+      free(node);
+      return NULL;
+    }
+    node->sizes[0] = 1;
+  }
+  node->count = 1;
+  return node;
+}
+
+// Appends along the rightmost path. A node with no room leaves the value
+// in `*overflow`, a new sibling path of the same height.
+static snek_pvec_node_t *push_rec(snek_pvec_node_t *node, snek_object_t *value,
+                                  bool in_place, snek_pvec_node_t **overflow) {
+  if (node->height == 0) {
+    if (node->count == SNEK_PVEC_BRANCH) {
+      *overflow = path_new(0, value);
+      return *overflow == NULL ? NULL : node_retain(node);
+    }
+    snek_pvec_node_t *edit = node_edit(node, in_place);
+    if (edit != NULL) {
+      edit->slots[edit->count++] = value;
+    }
+    return edit;
+  }
+
+  snek_pvec_node_t *child_overflow = NULL;
+  uint32_t last = node->count - 1;
+  snek_pvec_node_t *child =
+      push_rec(node->slots[last], value, in_place, &child_overflow);
+  if (child == NULL) {
+    return NULL;
+  }
+
+  if (child_overflow != NULL && node->count == SNEK_PVEC_BRANCH) {
+    // An overflowing child is unchanged, lift its new sibling one level
+    snek_pvec_node_release(child);
+    *overflow = node_new(node->height);
+    if (*overflow == NULL) {
+      snek_pvec_node_release(child_overflow);
+      return NULL;
+    }
+    (*overflow)->slots[0] = child_overflow;
+    (*overflow)->count = 1;
+    node_update_sizes(*overflow);
+    return node_retain(node);
+  }
+
+  snek_pvec_node_t *edit = node_edit(node, in_place);
+  if (edit == NULL) {
+    snek_pvec_node_release(child);
+    snek_pvec_node_release(child_overflow);
+    return NULL;
+  }
+  node_replace(edit, last, child);
+  if (child_overflow != NULL) {
+    edit->slots[edit->count++] = child_overflow;
+  }
+  node_update_sizes(edit);
+  return edit;
+}
+
+snek_object_t *snek_pvec_push(snek_object_t *vec, snek_object_t *value,
+                              vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  if (vec == NULL || vec->kind != PVECTOR) {
+    return NULL;
+  }
+
+  snek_pvec_t *pvec = &vec->data.v_pvec;
+  snek_pvec_node_t *root;
+  if (pvec->root == NULL) {
+    root = path_new(0, value);
+  } else {
+    snek_pvec_node_t *overflow = NULL;
+    root = push_rec(pvec->root, value, pvec->transient, &overflow);
+    if (root != NULL && overflow != NULL) {
+      // The whole tree is full, grow by one level
+      snek_pvec_node_t *top = node_new(root->height + 1);
+      if (top == NULL) {
+        snek_pvec_node_release(root);
+        snek_pvec_node_release(overflow);
+        return NULL;
+      }
+      top->slots[0] = root;
+      top->slots[1] = overflow;
+      top->count = 2;
+      node_update_sizes(top);
+      root = top;
+    }
+  }
+  if (root == NULL) {
+    return NULL;
+  }
+  return pvec_update(vec, root, pvec->size + 1, vm);
+}
+
+// Concat -----------------------------------------------------------------
+
+// Redistributes the slots of `all` (nodes of one height) so that the level
+// uses at most PVEC_EXTRAS more nodes than a fully packed one would.
+// Returns the new node count, with the slot count of each in `plan`.
+static size_t concat_plan(snek_pvec_node_t **all, size_t count, uint32_t *plan) {
+  size_t total = 0;
+  for (size_t i = 0; i < count; i++) {
+    plan[i] = all[i]->count;
+    total += plan[i];
+  }
+
+  size_t optimal = (total + SNEK_PVEC_BRANCH - 1) / SNEK_PVEC_BRANCH;
+  size_t i = 0;
+  while (count > optimal + PVEC_EXTRAS) {
+    while (plan[i] > SNEK_PVEC_BRANCH - PVEC_INVARIANT) {
+      i++;
+    }
+    // Spread the short node over the ones after it
+    uint32_t remaining = plan[i];
+    do {
+      uint32_t filled = remaining + plan[i + 1] < SNEK_PVEC_BRANCH
+                            ? remaining + plan[i + 1]
+                            : SNEK_PVEC_BRANCH;
+      remaining = remaining + plan[i + 1] - filled;
+      plan[i] = filled;
+      i++;
+    } while (remaining > 0);
+
+    for (size_t j = i; j < count - 1; j++) {
+      plan[j] = plan[j + 1];
+    }
+    count--;
+    i--;
+  }
+  return count;
+}
+
+// Builds the nodes described by `plan` from the slots of `all`, reusing
+// nodes that come through unchanged. Returns the number built into `out`.
+static size_t concat_execute(snek_pvec_node_t **all, uint32_t *plan,
+                             size_t planned, snek_pvec_node_t **out) {
+  size_t source = 0;
+  uint32_t offset = 0;
+  for (size_t k = 0; k < planned; k++) {
+    if (offset == 0 && all[source]->count == plan[k]) {
+      out[k] = node_retain(all[source++]);
+      continue;
+    }
+
+    snek_pvec_node_t *node = node_new(all[source]->height);
+    if (node == NULL) {
+      for (size_t j = 0; j < k; j++) {
+        snek_pvec_node_release(out[j]);
+      }
+      return 0;
+    }
+    while (node->count < plan[k]) {
+      uint32_t take = plan[k] - node->count;
+      if (take > all[source]->count - offset) {
+        take = all[source]->count - offset;
+      }
+      memcpy(node->slots + node->count, all[source]->slots + offset,
+             take * sizeof(void *));
+      if (node->height > 0) {
+        for (uint32_t j = 0; j < take; j++) {
+          node_retain(node->slots[node->count + j]);
+        }
+      }
+      node->count += take;
+      offset += take;
+      if (offset == all[source]->count) {
+        source++;
+        offset = 0;
+      }
+    }
+    if (node->height > 0) {
+      node_update_sizes(node);
+    }
+    out[k] = node;
+  }
+  return planned;
+}
+
+// Parent of height `height + 1` over at most 2 nodes holding `children`
+static snek_pvec_node_t *concat_pack(snek_pvec_node_t **children,
+                                     size_t count, uint32_t height) {
+  snek_pvec_node_t *top = node_new(height + 1);
+  if (top == NULL) {
+    return NULL;
+  }
+
+  size_t start = 0;
+  while (start < count) {
+    size_t take = count - start < SNEK_PVEC_BRANCH ? count - start
+                                                   : SNEK_PVEC_BRANCH;
+    snek_pvec_node_t *node = node_new(height);
+    if (node == NULL) {
+      snek_pvec_node_release(top);
+      return NULL;
+    }
+    memcpy(node->slots, children + start, take * sizeof(void *));
+    node->count = (uint32_t)take;
+    node_update_sizes(node);
+    top->slots[top->count++] = node;
+    start += take;
+  }
+  node_update_sizes(top);
+  return top;
+}
+
+// Merges the inner edges of `left` and `right` (either may be NULL) around
+// `centre`, a node one level up from its children. Returns a node of
+// height `height + 1` with one or two children.
+static snek_pvec_node_t *concat_rebalance(snek_pvec_node_t *left,
+                                          snek_pvec_node_t *centre,
+                                          snek_pvec_node_t *right,
+                                          uint32_t height) {
+  snek_pvec_node_t *all[3 * SNEK_PVEC_BRANCH];
+  uint32_t plan[3 * SNEK_PVEC_BRANCH];
+  snek_pvec_node_t *built[3 * SNEK_PVEC_BRANCH];
+  size_t count = 0;
+
+  if (left != NULL) {
+    for (uint32_t i = 0; i + 1 < left->count; i++) {
+      all[count++] = left->slots[i];
+    }
+  }
+  for (uint32_t i = 0; i < centre->count; i++) {
+    all[count++] = centre->slots[i];
+  }
+  if (right != NULL) {
+    for (uint32_t i = 1; i < right->count; i++) {
+      all[count++] = right->slots[i];
+    }
+  }
+
+  size_t planned = concat_plan(all, count, plan);
+  size_t built_count = concat_execute(all, plan, planned, built);
+  snek_pvec_node_release(centre);
+  if (built_count == 0) {
+    return NULL;
+  }
+
+  snek_pvec_node_t *top = concat_pack(built, built_count, height);
+  if (top == NULL) {
+    for (size_t i = 0; i < built_count; i++) {
+      snek_pvec_node_release(built[i]);
+    }
+  }
+  return top;
+}
+
+static snek_pvec_node_t *concat_rec(snek_pvec_node_t *left,
+                                    snek_pvec_node_t *right) {
+  if (left->height > right->height) {
+    snek_pvec_node_t *centre = concat_rec(left->slots[left->count - 1], right);
+    return centre == NULL
+               ? NULL
+               : concat_rebalance(left, centre, NULL, left->height);
+  }
+  if (left->height < right->height) {
+    snek_pvec_node_t *centre = concat_rec(left, right->slots[0]);
+    return centre == NULL
+               ? NULL
+               : concat_rebalance(NULL, centre, right, right->height);
+  }
+
+  if (left->height == 0) {
+    snek_pvec_node_t *top = node_new(1);
+    if (top == NULL) {
+      return NULL;
+    }
+    if (left->count + right->count <= SNEK_PVEC_BRANCH) {
+      snek_pvec_node_t *leaf = node_new(0);
+      if (leaf == NULL) {
+        free(top);
+        return NULL;
+      }
+      memcpy(leaf->slots, left->slots, left->count * sizeof(void *));
+      memcpy(leaf->slots + left->count, right->slots,
+             right->count * sizeof(void *));
+      leaf->count = left->count + right->count;
+      top->slots[top->count++] = leaf;
+    } else {
+      top->slots[top->count++] = node_retain(left);
+      top->slots[top->count++] = node_retain(right);
+    }
+    node_update_sizes(top);
+    return top;
+  }
+
+  snek_pvec_node_t *centre =
+      concat_rec(left->slots[left->count - 1], right->slots[0]);
+  return centre == NULL ? NULL
+                        : concat_rebalance(left, centre, right, left->height);
+}
+
+// Drops single-child levels above the real root
+static snek_pvec_node_t *root_shrink(snek_pvec_node_t *root) {
+  while (root != NULL && root->height > 0 && root->count == 1) {
+    snek_pvec_node_t *child = node_retain(root->slots[0]);
+    snek_pvec_node_release(root);
+    root = child;
+  }
+  return root;
+}
+
+snek_object_t *snek_pvec_concat(snek_object_t *a, snek_object_t *b, vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  if (a == NULL || b == NULL || a->kind != PVECTOR || b->kind != PVECTOR) {
+    return NULL;
+  }
+
+  snek_pvec_node_t *root;
+  if (a->data.v_pvec.root == NULL || b->data.v_pvec.root == NULL) {
+    root = a->data.v_pvec.root != NULL ? a->data.v_pvec.root
+                                       : b->data.v_pvec.root;
+    if (root != NULL) {
+      node_retain(root);
+    }
+  } else {
+    root = root_shrink(concat_rec(a->data.v_pvec.root, b->data.v_pvec.root));
+    if (root == NULL) {
+      return NULL;
+    }
+  }
+  return pvec_wrap(root, a->data.v_pvec.size + b->data.v_pvec.size, vm);
+}
+
+// Split ------------------------------------------------------------------
+
+// First `count` elements of `node`, 0 < count <= node_size(node)
+static snek_pvec_node_t *take_rec(snek_pvec_node_t *node, size_t count) {
+  if (count == node_size(node)) {
+    return node_retain(node);
+  }
+
+  snek_pvec_node_t *result = node_new(node->height);
+  if (result == NULL) {
+    return NULL;
+  }
+  if (node->height == 0) {
+    memcpy(result->slots, node->slots, count * sizeof(void *));
+    result->count = (uint32_t)count;
+    return result;
+  }
+
+  size_t index = count - 1;
+  uint32_t slot = node_find_slot(node, &index);
+  for (uint32_t i = 0; i < slot; i++) {
+    result->slots[i] = node_retain(node->slots[i]);
+  }
+  result->count = slot;
+  snek_pvec_node_t *edge = take_rec(node->slots[slot], index + 1);
+  if (edge == NULL) {
+    snek_pvec_node_release(result);
+    return NULL;
+  }
+  result->slots[result->count++] = edge;
+  node_update_sizes(result);
+  return result;
+}
+
+// Everything after the first `count` elements, count < node_size(node)
+static snek_pvec_node_t *drop_rec(snek_pvec_node_t *node, size_t count) {
+  if (count == 0) {
+    return node_retain(node);
+  }
+
+  snek_pvec_node_t *result = node_new(node->height);
+  if (result == NULL) {
+    return NULL;
+  }
+  if (node->height == 0) {
+    result->count = node->count - (uint32_t)count;
+    memcpy(result->slots, node->slots + count, result->count * sizeof(void *));
+    return result;
+  }
+
+  size_t index = count;
+  uint32_t slot = node_find_slot(node, &index);
+  snek_pvec_node_t *edge = drop_rec(node->slots[slot], index);
+  if (edge == NULL) {
+    free(result);
+    return NULL;
+  }
+  result->slots[result->count++] = edge;
+  for (uint32_t i = slot + 1; i < node->count; i++) {
+    result->slots[result->count++] = node_retain(node->slots[i]);
+  }
+  node_update_sizes(result);
+  return result;
+}
+
+snek_object_t *snek_pvec_take(snek_object_t *vec, size_t count, vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  if (vec == NULL || vec->kind != PVECTOR || count > vec->data.v_pvec.size) {
+    return NULL;
+  }
+  if (count == 0) {
+    return new_snek_pvec(vm);
+  }
+
+  snek_pvec_node_t *root = root_shrink(take_rec(vec->data.v_pvec.root, count));
+  if (root == NULL) {
+    return NULL;
+  }
+  return pvec_wrap(root, count, vm);
+}
+
+snek_object_t *snek_pvec_drop(snek_object_t *vec, size_t count, vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  if (vec == NULL || vec->kind != PVECTOR || count > vec->data.v_pvec.size) {
+    return NULL;
+  }
+  if (count == vec->data.v_pvec.size) {
+    return new_snek_pvec(vm);
+  }
+
+  snek_pvec_node_t *root = root_shrink(drop_rec(vec->data.v_pvec.root, count));
+  if (root == NULL) {
+    return NULL;
+  }
+  return pvec_wrap(root, vec->data.v_pvec.size - count, vm);
+}
+
+// Transients -------------------------------------------------------------
+
+snek_object_t *snek_pvec_transient(snek_object_t *vec, vm_t *vm) {
+  BOOT_SITE_SCOPE();
+  if (vec == NULL || vec->kind != PVECTOR) {
+    return NULL;
+  }
+
+  // Sharing the root makes every node non-unique, so the transient copies
+  // each path once and then owns it
+  snek_pvec_node_t *root = vec->data.v_pvec.root;
+  if (root != NULL) {
+    node_retain(root);
+  }
+  snek_object_t *transient = pvec_wrap(root, vec->data.v_pvec.size, vm);
+  if (transient != NULL) {
+    transient->data.v_pvec.transient = true;
+  }
+  return transient;
+}
+
+snek_object_t *snek_pvec_persistent(snek_object_t *vec) {
+  if (vec == NULL || vec->kind != PVECTOR) {
+    return NULL;
+  }
+  vec->data.v_pvec.transient = false;
+  return vec;
+}
+
+// Tracing ----------------------------------------------------------------
+
+static void trace_node(stack_t *gray_objects, snek_pvec_node_t *node,
+                       uint64_t epoch) {
+  if (epoch != 0) {
+    if (node->trace_epoch == epoch) {
+      return;
+    }
+    node->trace_epoch = epoch;
+  }
+
+  if (node->height == 0) {
+    for (uint32_t i = 0; i < node->count; i++) {
+      trace_mark_object(gray_objects, node->slots[i]);
+    }
+    return;
+  }
+  for (uint32_t i = 0; i < node->count; i++) {
+    trace_node(gray_objects, node->slots[i], epoch);
+  }
+}
+
+void snek_pvec_trace(stack_t *gray_objects, snek_object_t *vec,
+                     uint64_t epoch) {
+  if (vec->data.v_pvec.root != NULL) {
+    trace_node(gray_objects, vec->data.v_pvec.root, epoch);
+  }
+}
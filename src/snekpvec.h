@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "snekobject.h"
+#include "stack.h"
+
+/// Persistent vector (PVECTOR) built on a relaxed radix balanced tree.
+/// Nodes are refcounted and shared between vectors, so every update
+/// returns a new vector that copies only the path it touched. Transient
+/// vectors are updated in place wherever they hold the only reference.
+
+#define SNEK_PVEC_BITS 5
+#define SNEK_PVEC_BRANCH (1 << SNEK_PVEC_BITS)
+
+typedef struct SnekPvecNode {
+  size_t ref_count;
+  // Last trace that visited this node, shared subtrees are walked once
+  uint64_t trace_epoch;
+  uint32_t count;
+  // 0 for leaves, whose slots are elements, otherwise slots are children
+  uint32_t height;
+  void *slots[SNEK_PVEC_BRANCH];
+  // Internal nodes only: sizes[i] is the element count of slots[0..i]
+  size_t sizes[];
+} snek_pvec_node_t;
+
+snek_object_t *snek_pvec_get(snek_object_t *vec, size_t index);
+snek_object_t *snek_pvec_set(snek_object_t *vec, size_t index,
+                             snek_object_t *value, vm_t *vm);
+snek_object_t *snek_pvec_push(snek_object_t *vec, snek_object_t *value,
+                              vm_t *vm);
+snek_object_t *snek_pvec_concat(snek_object_t *a, snek_object_t *b, vm_t *vm);
+
+/// First `count` elements, and everything after the first `count`
+snek_object_t *snek_pvec_take(snek_object_t *vec, size_t count, vm_t *vm);
+snek_object_t *snek_pvec_drop(snek_object_t *vec, size_t count, vm_t *vm);
+
+/// Transient copy of `vec` for batches of in-place pushes and sets
+snek_object_t *snek_pvec_transient(snek_object_t *vec, vm_t *vm);
+/// Freezes a transient, returns it
+snek_object_t *snek_pvec_persistent(snek_object_t *vec);
+
+void snek_pvec_node_release(snek_pvec_node_t *node);
+/// Copy of the tree under `node` sharing no node with it, each element
+/// replaced by `map(ctx, element)`, or kept as is when `map` is NULL
+snek_pvec_node_t *snek_pvec_tree_copy(snek_pvec_node_t *node,
+                                      snek_object_t *(*map)(void *ctx,
+                                                            snek_object_t *),
+                                      void *ctx);
+/// Bytes held by the tree, with shared nodes split between their owners
+size_t snek_pvec_bytes(snek_object_t *vec);
+/// Marks every element once, skipping nodes already stamped with `epoch`
+void snek_pvec_trace(stack_t *gray_objects, snek_object_t *vec,
+                     uint64_t epoch);
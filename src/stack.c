@@ -1,3 +1,4 @@
+#define BOOT_CATEGORY BOOT_CATEGORY_STACK
 #include "bootmem.h"
 #include <stdio.h>
 
@@ -43,6 +44,31 @@ void stack_push(stack_t *stack, void *obj)
     return;
 }
 
+bool stack_shrink(stack_t *stack, size_t capacity)
+{
+    if (capacity < stack->count)
+    {
+        capacity = stack->count;
+    }
+    if (capacity == 0)
+    {
+        capacity = 1;
+    }
+    if (capacity >= stack->capacity)
+    {
+        return false;
+    }
+
+    void **data = realloc(stack->data, capacity * sizeof(void *));
+    if (data == NULL)
+    {
+        return false;
+    }
+    stack->data = data;
+    stack->capacity = capacity;
+    return true;
+}
+
 void *stack_pop(stack_t *stack)
 {
     if (stack->count == 0)
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
 
@@ -13,6 +14,9 @@ typedef struct Stack
 stack_t *stack_new(size_t capacity);
 
 void stack_push(stack_t *stack, void *obj);
+/// Cuts the buffer down to `capacity` entries, never below the count.
+/// Returns true if the buffer shrank.
+bool stack_shrink(stack_t *stack, size_t capacity);
 void *stack_pop(stack_t *stack);
 
 void stack_free(stack_t *stack);
@@ -1,10 +1,42 @@
 #include "bootmem.h"
+#include "heapsample.h"
+#include "heapverify.h"
 #include "snekobject.h"
+#include "snekpvec.h"
 #include "stack.h"
+#include <stdatomic.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "vm.h"
 
+// A parent array of at least this many elements that is only reachable
+// through slices covering at most 1/SLICE_COMPACT_RATIO of it is dropped,
+// and its slices are turned into standalone arrays
+#define SLICE_COMPACT_MIN_PARENT 1024
+#define SLICE_COMPACT_RATIO 8
+
+// Stacks are never scavenged below their starting capacity. Cutting to
+// twice the count means a stack has to double and fall to a quarter again
+// before it is touched twice, so the scavenger can't thrash it.
+#define SCAVENGE_MIN_CAPACITY 8
+
+// Each trace stamps shared persistent vector nodes with a fresh epoch so
+// they are walked once. 0 outside trace() means "no stamping".
+static atomic_uint_fast64_t trace_epoch_counter;
+static _Thread_local uint64_t trace_epoch;
+// Deepest the gray stack got during the current trace()
+static _Thread_local size_t trace_gray_peak;
+// Set by vm_mutator_attach, threads without one use vm->frames
+static _Thread_local vm_mutator_t *current_mutator;
+
+// VMs in stress mode, see `vm_gc_stress`
+static pthread_mutex_t gc_stress_lock = PTHREAD_MUTEX_INITIALIZER;
+static size_t gc_stress_vms;
+
+static void vm_pending_flush(vm_mutator_t *mutator);
+
 vm_t *vm_new() {
   vm_t *vm = malloc(sizeof(vm_t));
   if (vm == NULL) {
@@ -18,39 +50,280 @@ vm_t *vm_new() {
     return NULL;
   }
 
-  vm->objects = stack_new(capacity);
+  vm->objects = registry_new();
   if (vm->objects == NULL) {
     stack_free(vm->frames);
     free(vm);
     return NULL;
   }
 
+  vm->stats_enabled = false;
+  memset(&vm->stats, 0, sizeof(vm->stats));
+  vm->tracer = NULL;
+#ifdef SNEK_VERIFY_HEAP
+  vm->verify_heap = true;
+#else
+  vm->verify_heap = false;
+#endif
+  vm->gc_stress_interval = 0;
+  vm->gc_stress_countdown = 0;
+  vm->gc_inhibit = 0;
+  vm->scavenge_interval = VM_SCAVENGE_INTERVAL;
+  vm->scavenge_countdown = VM_SCAVENGE_INTERVAL;
+#ifdef SNEK_GC_STRESS
+  vm_gc_stress(vm, SNEK_GC_STRESS);
+#endif
+
+  vm->shared = false;
+  vm->mutators = stack_new(capacity);
+  if (vm->mutators == NULL) {
+    registry_free(vm->objects);
+    stack_free(vm->frames);
+    free(vm);
+    return NULL;
+  }
+  atomic_init(&vm->safepoint_requested, false);
+  pthread_mutex_init(&vm->safepoint_lock, NULL);
+  pthread_cond_init(&vm->safepoint_parked, NULL);
+  pthread_cond_init(&vm->safepoint_resume, NULL);
+  vm->running = 1;
+  heap_sample_claim(vm);
   return vm;
 }
 
 void vm_free(vm_t *vm) {
-  for (int i = 0; i < vm->frames->count; i++) {
+  vm_gc_stress(vm, 0);
+  for (size_t i = 0; i < vm->frames->count; i++) {
     frame_free((frame_t *)vm->frames->data[i]);
   }
   stack_free(vm->frames);
 
-  for (int i = 0; i < vm->objects->count; i++) {
-    snek_object_free(vm->objects->data[i]);
+  // Mutators whose threads never detached
+  for (size_t i = 0; i < vm->mutators->count; i++) {
+    vm_mutator_t *mutator = vm->mutators->data[i];
+    vm_pending_flush(mutator);
+    for (size_t j = 0; j < mutator->frames->count; j++) {
+      frame_free(mutator->frames->data[j]);
+    }
+    stack_free(mutator->frames);
+    free(mutator);
+  }
+  stack_free(vm->mutators);
+
+  registry_cursor_t cursor = registry_begin(vm->objects);
+  snek_object_t *obj;
+  while ((obj = registry_next(&cursor)) != NULL) {
+    snek_object_free(obj);
   }
-  stack_free(vm->objects);
+  registry_free(vm->objects);
 
+  gc_tracer_free(vm->tracer);
+  pthread_mutex_destroy(&vm->safepoint_lock);
+  pthread_cond_destroy(&vm->safepoint_parked);
+  pthread_cond_destroy(&vm->safepoint_resume);
   free(vm);
 }
 
+// Registers the objects `mutator` has pending, in one append
+static void vm_pending_flush(vm_mutator_t *mutator) {
+  if (mutator->pending_count == 0) {
+    return;
+  }
+  registry_add_many(mutator->vm->objects, (snek_object_t **)mutator->pending,
+                    mutator->pending_count);
+  mutator->pending_count = 0;
+}
+
+// The calling thread's mutator on `vm`, NULL for the creating thread
+static vm_mutator_t *vm_current_mutator(vm_t *vm) {
+  vm_mutator_t *mutator = current_mutator;
+  return mutator != NULL && mutator->vm == vm ? mutator : NULL;
+}
+
+static stack_t *vm_current_frames(vm_t *vm) {
+  vm_mutator_t *mutator = vm_current_mutator(vm);
+  return mutator != NULL ? mutator->frames : vm->frames;
+}
+
+static int *vm_current_inhibit(vm_t *vm) {
+  vm_mutator_t *mutator = vm_current_mutator(vm);
+  return mutator != NULL ? &mutator->gc_inhibit : &vm->gc_inhibit;
+}
+
+// Waits out a collection with `safepoint_lock` held. The caller counts as
+// running before and after.
+static void safepoint_park_locked(vm_t *vm) {
+  vm->running--;
+  pthread_cond_broadcast(&vm->safepoint_parked);
+  while (atomic_load(&vm->safepoint_requested)) {
+    pthread_cond_wait(&vm->safepoint_resume, &vm->safepoint_lock);
+  }
+  vm->running++;
+}
+
+void vm_safepoint(vm_t *vm) {
+  if (!atomic_load_explicit(&vm->safepoint_requested, memory_order_acquire)) {
+    return;
+  }
+  // Temporaries aren't rooted yet, the scope polls again when it ends
+  if (*vm_current_inhibit(vm) > 0) {
+    return;
+  }
+  pthread_mutex_lock(&vm->safepoint_lock);
+  safepoint_park_locked(vm);
+  pthread_mutex_unlock(&vm->safepoint_lock);
+}
+
+void vm_blocking_enter(vm_t *vm) {
+  pthread_mutex_lock(&vm->safepoint_lock);
+  vm->running--;
+  pthread_cond_broadcast(&vm->safepoint_parked);
+  pthread_mutex_unlock(&vm->safepoint_lock);
+}
+
+void vm_blocking_leave(vm_t *vm) {
+  pthread_mutex_lock(&vm->safepoint_lock);
+  while (atomic_load(&vm->safepoint_requested)) {
+    pthread_cond_wait(&vm->safepoint_resume, &vm->safepoint_lock);
+  }
+  vm->running++;
+  pthread_mutex_unlock(&vm->safepoint_lock);
+}
+
+// Returns false without stopping anything when another thread was
+// already collecting, that collection has finished by the time this
+// returns and serves the caller too
+static bool safepoint_stop_world(vm_t *vm) {
+  pthread_mutex_lock(&vm->safepoint_lock);
+  if (atomic_load(&vm->safepoint_requested)) {
+    safepoint_park_locked(vm);
+    pthread_mutex_unlock(&vm->safepoint_lock);
+    return false;
+  }
+  atomic_store(&vm->safepoint_requested, true);
+  while (vm->running > 1) {
+    pthread_cond_wait(&vm->safepoint_parked, &vm->safepoint_lock);
+  }
+  pthread_mutex_unlock(&vm->safepoint_lock);
+  return true;
+}
+
+static void safepoint_resume_world(vm_t *vm) {
+  pthread_mutex_lock(&vm->safepoint_lock);
+  atomic_store(&vm->safepoint_requested, false);
+  pthread_cond_broadcast(&vm->safepoint_resume);
+  pthread_mutex_unlock(&vm->safepoint_lock);
+}
+
+// Called with the world stopped
+static void vm_pending_flush_all(vm_t *vm) {
+  for (size_t i = 0; i < vm->mutators->count; i++) {
+    vm_pending_flush(vm->mutators->data[i]);
+  }
+}
+
+void vm_world_stop(vm_t *vm) {
+  if (!vm->shared) {
+    return;
+  }
+  // False means this thread parked for someone else's collection, which
+  // has finished, so try again
+  while (!safepoint_stop_world(vm)) {
+  }
+  vm_pending_flush_all(vm);
+}
+
+void vm_world_resume(vm_t *vm) {
+  if (vm->shared) {
+    safepoint_resume_world(vm);
+  }
+}
+
+vm_mutator_t *vm_mutator_new(vm_t *vm) {
+  vm_mutator_t *mutator = malloc(sizeof(vm_mutator_t));
+  if (mutator == NULL) {
+    return NULL;
+  }
+  mutator->vm = vm;
+  mutator->gc_inhibit = 0;
+  mutator->pending_count = 0;
+  mutator->frames = stack_new(8);
+  if (mutator->frames == NULL) {
+    free(mutator);
+    return NULL;
+  }
+
+  // The list is read by collections, which can't be running while the
+  // lock is held and no stop is requested
+  pthread_mutex_lock(&vm->safepoint_lock);
+  while (atomic_load(&vm->safepoint_requested)) {
+    safepoint_park_locked(vm);
+  }
+  vm->shared = true;
+  stack_push(vm->mutators, mutator);
+  pthread_mutex_unlock(&vm->safepoint_lock);
+  return mutator;
+}
+
+void vm_mutator_attach(vm_mutator_t *mutator) {
+  current_mutator = mutator;
+  vm_blocking_leave(mutator->vm);
+}
+
+void vm_mutator_free(vm_mutator_t *mutator) {
+  if (mutator == NULL) {
+    return;
+  }
+  vm_t *vm = mutator->vm;
+  pthread_mutex_lock(&vm->safepoint_lock);
+  vm->running--;
+  pthread_cond_broadcast(&vm->safepoint_parked);
+  // A collection in progress still reads this mutator's frames
+  while (atomic_load(&vm->safepoint_requested)) {
+    pthread_cond_wait(&vm->safepoint_resume, &vm->safepoint_lock);
+  }
+  vm_pending_flush(mutator);
+  for (size_t i = 0; i < vm->mutators->count; i++) {
+    if (vm->mutators->data[i] == mutator) {
+      vm->mutators->data[i] = vm->mutators->data[--vm->mutators->count];
+      break;
+    }
+  }
+  pthread_mutex_unlock(&vm->safepoint_lock);
+
+  if (current_mutator == mutator) {
+    current_mutator = NULL;
+  }
+  for (size_t i = 0; i < mutator->frames->count; i++) {
+    frame_free(mutator->frames->data[i]);
+  }
+  stack_free(mutator->frames);
+  free(mutator);
+}
+
+stack_t *vm_frame_stack(vm_t *vm, size_t index) {
+  if (index == 0) {
+    return vm->frames;
+  }
+  if (index - 1 < vm->mutators->count) {
+    return ((vm_mutator_t *)vm->mutators->data[index - 1])->frames;
+  }
+  return NULL;
+}
+
 void vm_frame_push(vm_t *vm, void *frame) {
   if (vm == NULL || frame == NULL) {
     return;
   }
 
-  stack_push(vm->frames, frame);
+  vm_safepoint(vm);
+  stack_push(vm_current_frames(vm), frame);
 }
 
-frame_t *vm_frame_pop(vm_t *vm) { return stack_pop(vm->frames); }
+frame_t *vm_frame_pop(vm_t *vm) {
+  vm_safepoint(vm);
+  return stack_pop(vm_current_frames(vm));
+}
 
 frame_t *vm_new_frame(vm_t *vm) {
   if (vm == NULL) {
@@ -78,40 +351,482 @@ void frame_free(frame_t *frame) {
 }
 
 void vm_track_object(vm_t *vm, snek_object_t *obj) {
-  stack_push(vm->objects, obj);
+  // The object and the payloads its constructor allocated
+  heap_sample_claim(vm);
+  if (!vm->shared) {
+    registry_add_exclusive(vm->objects, obj);
+    return;
+  }
+  vm_mutator_t *mutator = vm_current_mutator(vm);
+  if (mutator != NULL) {
+    mutator->pending[mutator->pending_count++] = obj;
+    if (mutator->pending_count == VM_REGISTER_BATCH) {
+      vm_pending_flush(mutator);
+    }
+    return;
+  }
+  registry_add(vm->objects, obj);
 }
 
 void frame_reference_object(frame_t *frame, snek_object_t *obj) {
   stack_push(frame->references, obj);
 }
 
+static void sweep_objects(vm_t *vm, bool measure, uint64_t *freed,
+                          uint64_t *freed_bytes);
+
+static void verify_collection(vm_t *vm) {
+  heap_verify_report_t report;
+  if (!vm_verify_heap_stopped(vm, &report)) {
+    fprintf(stderr,
+            "[vm]: heap verification failed after a collection, %zu "
+            "errors, first: %s\n",
+            report.errors, report.first_error);
+    abort();
+  }
+}
+
+static void collect(vm_t *vm);
+static size_t scavenge(vm_t *vm);
+
 void vm_collect_garbage(vm_t *vm) {
+  if (!vm->shared) {
+    collect(vm);
+    return;
+  }
+
+  uint64_t start = gc_stats_now_ns();
+  if (!safepoint_stop_world(vm)) {
+    return;
+  }
+  // The tracer is only safe to use once the world is stopped
+  uint64_t stopped = gc_stats_now_ns();
+  if (vm->tracer != NULL) {
+    gc_tracer_counter(vm->tracer, "time_to_safepoint_ns", stopped - start);
+  }
+  if (vm->stats_enabled) {
+    vm->stats.safepoint_total_ns += stopped - start;
+    if (stopped - start > vm->stats.safepoint_max_ns) {
+      vm->stats.safepoint_max_ns = stopped - start;
+    }
+  }
+  vm_pending_flush_all(vm);
+  collect(vm);
+  safepoint_resume_world(vm);
+}
+
+size_t vm_scavenge(vm_t *vm) {
+  if (!vm->shared) {
+    return scavenge(vm);
+  }
+  // Other threads' frame stacks are only safe to resize while they wait
+  if (!safepoint_stop_world(vm)) {
+    return 0;
+  }
+  size_t released = scavenge(vm);
+  safepoint_resume_world(vm);
+  return released;
+}
+
+void vm_scavenge_interval(vm_t *vm, size_t interval) {
+  vm->scavenge_interval = interval;
+  vm->scavenge_countdown = interval;
+}
+
+static size_t scavenge_stack(stack_t *stack) {
+  if (stack->capacity <= SCAVENGE_MIN_CAPACITY ||
+      stack->count > stack->capacity / 4) {
+    return 0;
+  }
+  size_t before = stack->capacity;
+  size_t target = stack->count * 2 > SCAVENGE_MIN_CAPACITY
+                      ? stack->count * 2
+                      : SCAVENGE_MIN_CAPACITY;
+  if (!stack_shrink(stack, target)) {
+    return 0;
+  }
+  return (before - stack->capacity) * sizeof(void *);
+}
+
+// Runs with the world stopped. The registry frees its emptied segments
+// when the sweep compacts it, and large payloads are unmapped as they are
+// freed, so what is left are stack buffers and malloc's free pages.
+static size_t scavenge(vm_t *vm) {
+  gc_tracer_t *tracer = vm->tracer;
+  if (tracer != NULL) {
+    gc_tracer_begin(tracer, "scavenge");
+  }
+  uint64_t start = gc_stats_now_ns();
+
+  size_t released = 0;
+  stack_t *frames;
+  for (size_t s = 0; (frames = vm_frame_stack(vm, s)) != NULL; s++) {
+    for (size_t i = 0; i < frames->count; i++) {
+      frame_t *frame = frames->data[i];
+      released += scavenge_stack(frame->references);
+    }
+    released += scavenge_stack(frames);
+  }
+  boot_trim();
+
+  if (tracer != NULL) {
+    gc_tracer_counter(tracer, "scavenged_bytes", released);
+    gc_tracer_end(tracer, "scavenge");
+  }
+  if (vm->stats_enabled) {
+    vm->stats.scavenges++;
+    vm->stats.scavenge_ns += gc_stats_now_ns() - start;
+    vm->stats.scavenged_bytes += released;
+  }
+  return released;
+}
+
+// Called after every collection
+static void scavenge_step(vm_t *vm) {
+  if (vm->scavenge_interval == 0 || --vm->scavenge_countdown > 0) {
+    return;
+  }
+  vm->scavenge_countdown = vm->scavenge_interval;
+  scavenge(vm);
+}
+
+static void collect(vm_t *vm) {
+  gc_tracer_t *tracer = vm->tracer;
+  if (!vm->stats_enabled && tracer == NULL) {
+    mark(vm);
+    trace(vm);
+    sweep(vm);
+    scavenge_step(vm);
+    if (vm->verify_heap) {
+      verify_collection(vm);
+    }
+    return;
+  }
+
+  if (tracer != NULL) {
+    gc_tracer_begin(tracer, "collect");
+    gc_tracer_counter(tracer, "heap_objects", registry_count(vm->objects));
+    gc_tracer_begin(tracer, "mark");
+  }
+  uint64_t start = gc_stats_now_ns();
   mark(vm);
+  uint64_t marked = gc_stats_now_ns();
+  if (tracer != NULL) {
+    gc_tracer_end(tracer, "mark");
+    gc_tracer_begin(tracer, "trace");
+  }
   trace(vm);
-  sweep(vm);
+  uint64_t traced = gc_stats_now_ns();
+  if (tracer != NULL) {
+    gc_tracer_end(tracer, "trace");
+    gc_tracer_counter(tracer, "gray_stack_peak", trace_gray_peak);
+    gc_tracer_begin(tracer, "sweep");
+  }
+  uint64_t freed = 0;
+  uint64_t freed_bytes = 0;
+  sweep_objects(vm, true, &freed, &freed_bytes);
+  uint64_t swept = gc_stats_now_ns();
+  if (tracer != NULL) {
+    gc_tracer_end(tracer, "sweep");
+    gc_tracer_counter(tracer, "objects_freed", freed);
+    gc_tracer_counter(tracer, "bytes_freed", freed_bytes);
+    gc_tracer_counter(tracer, "heap_objects", registry_count(vm->objects));
+    gc_tracer_end(tracer, "collect");
+  }
+
+  // Still stopped, so a scavenge is part of this collection's pause
+  scavenge_step(vm);
+  if (vm->stats_enabled) {
+    gc_stats_t *stats = &vm->stats;
+    stats->mark_ns += marked - start;
+    stats->trace_ns += traced - marked;
+    stats->sweep_ns += swept - traced;
+    gc_stats_record_pause(stats, gc_stats_now_ns() - start);
+  }
+  if (vm->verify_heap) {
+    verify_collection(vm);
+  }
+}
+
+void vm_verify_heap_enable(vm_t *vm, bool enabled) {
+  vm->verify_heap = enabled;
+}
+
+void vm_gc_stress(vm_t *vm, size_t interval) {
+  // Poisoning is global, it stays on while any VM is in stress mode
+  pthread_mutex_lock(&gc_stress_lock);
+  if (vm->gc_stress_interval == 0 && interval > 0) {
+    if (gc_stress_vms++ == 0) {
+      boot_poison_enable(true);
+    }
+  } else if (vm->gc_stress_interval > 0 && interval == 0) {
+    if (--gc_stress_vms == 0) {
+      boot_poison_enable(false);
+    }
+  }
+  pthread_mutex_unlock(&gc_stress_lock);
+
+  vm->gc_stress_interval = interval;
+  vm->gc_stress_countdown = interval;
+}
+
+void vm_gc_stress_step(vm_t *vm) {
+  if (vm->gc_stress_countdown > 0) {
+    vm->gc_stress_countdown--;
+  }
+  if (vm->gc_stress_countdown == 0 && vm->gc_inhibit == 0) {
+    vm->gc_stress_countdown = vm->gc_stress_interval;
+    vm_collect_garbage(vm);
+  }
+}
+
+vm_t *vm_gc_inhibit_enter(vm_t *vm) {
+  if (vm != NULL) {
+    (*vm_current_inhibit(vm))++;
+  }
+  return vm;
+}
+
+void vm_gc_inhibit_leave(vm_t **vm) {
+  if (*vm != NULL && --(*vm_current_inhibit(*vm)) == 0) {
+    vm_safepoint(*vm);
+  }
+}
+
+bool vm_gc_trace_start(vm_t *vm, const char *path, size_t capacity) {
+  if (vm->tracer != NULL) {
+    return false;
+  }
+  vm->tracer = gc_tracer_new(path, capacity);
+  return vm->tracer != NULL;
+}
+
+bool vm_gc_trace_flush(vm_t *vm) {
+  return vm->tracer != NULL && gc_tracer_flush(vm->tracer);
+}
+
+void vm_gc_trace_stop(vm_t *vm) {
+  gc_tracer_free(vm->tracer);
+  vm->tracer = NULL;
+}
+
+void vm_gc_stats_enable(vm_t *vm, bool enabled) {
+  vm->stats_enabled = enabled;
+}
+
+void vm_gc_stats(vm_t *vm, gc_stats_t *out) {
+  vm_world_stop(vm);
+  *out = vm->stats;
+
+  out->heap_objects = registry_count(vm->objects);
+  out->heap_bytes = 0;
+  registry_cursor_t cursor = registry_begin(vm->objects);
+  snek_object_t *obj;
+  while ((obj = registry_next(&cursor)) != NULL) {
+    out->heap_bytes += snek_object_size(obj);
+  }
+
+  out->pause_p50_ns = gc_stats_percentile(&vm->stats, 0.50);
+  out->pause_p99_ns = gc_stats_percentile(&vm->stats, 0.99);
+  vm_world_resume(vm);
 }
 
 void sweep(vm_t *vm) {
-  for (int i = 0; i < vm->objects->count; i++) {
-    snek_object_t *obj = vm->objects->data[i];
+  uint64_t freed;
+  uint64_t freed_bytes;
+  sweep_objects(vm, vm->stats_enabled, &freed, &freed_bytes);
+}
+
+// Frees unmarked objects. With `measure` set the freed objects and bytes
+// are counted, and added to the stats when those are enabled.
+static void sweep_objects(vm_t *vm, bool measure, uint64_t *freed,
+                          uint64_t *freed_bytes) {
+  // Freed sizes are taken before freeing, survivor sizes after, each
+  // with shared buffers split between the owners at that moment
+  *freed = 0;
+  *freed_bytes = 0;
+
+  registry_cursor_t cursor = registry_begin(vm->objects);
+  snek_object_t *obj;
+  while ((obj = registry_next(&cursor)) != NULL) {
     if (obj->is_marked) {
       obj->is_marked = false;
     } else {
+      if (measure) {
+        (*freed)++;
+        *freed_bytes += snek_object_size(obj);
+      }
       snek_object_free(obj);
-      vm->objects->data[i] = NULL;
+      registry_remove_current(vm->objects, &cursor);
     }
   }
-  stack_remove_nulls(vm->objects);
+  // The world is stopped, nothing appends while the segments are packed
+  registry_compact(vm->objects, true);
+  heap_sample_collection(vm);
+
+  if (measure && vm->stats_enabled) {
+    uint64_t survived_bytes = 0;
+    cursor = registry_begin(vm->objects);
+    while ((obj = registry_next(&cursor)) != NULL) {
+      survived_bytes += snek_object_size(obj);
+    }
+    vm->stats.objects_freed += *freed;
+    vm->stats.bytes_freed += *freed_bytes;
+    vm->stats.objects_survived = registry_count(vm->objects);
+    vm->stats.bytes_survived = survived_bytes;
+  }
 }
 
 void mark(vm_t *vm) {
-  for (size_t i = 0; i < vm->frames->count; i++) {
-    frame_t *frame = vm->frames->data[i];
-    for (size_t j = 0; j < frame->references->count; j++) {
-      snek_object_t *obj = frame->references->data[j];
-      obj->is_marked = true;
+  stack_t *frames;
+  for (size_t s = 0; (frames = vm_frame_stack(vm, s)) != NULL; s++) {
+    for (size_t i = 0; i < frames->count; i++) {
+      frame_t *frame = frames->data[i];
+      for (size_t j = 0; j < frame->references->count; j++) {
+        snek_object_t *obj = frame->references->data[j];
+        obj->is_marked = true;
+      }
+    }
+  }
+}
+
+static bool trace_slice_may_compact(snek_object_t *slice) {
+  snek_slice_t *view = &slice->data.v_slice;
+  size_t parent_size = view->parent->data.v_array.size;
+  return parent_size >= SLICE_COMPACT_MIN_PARENT &&
+         view->length * SLICE_COMPACT_RATIO <= parent_size;
+}
+
+static void trace_drain(stack_t *gray_objects, stack_t *slices) {
+  while (gray_objects->count > 0) {
+    if (gray_objects->count > trace_gray_peak) {
+      trace_gray_peak = gray_objects->count;
+    }
+    snek_object_t *ref = stack_pop(gray_objects);
+
+    // Hold back slices of large, not yet marked parents. Only the viewed
+    // range is traced, the parent may turn out to be unreachable otherwise.
+    if (slices != NULL && ref->kind == SLICE &&
+        !ref->data.v_slice.parent->is_marked && trace_slice_may_compact(ref)) {
+      snek_slice_t *view = &ref->data.v_slice;
+      for (size_t i = 0; i < view->length; i++) {
+        trace_mark_object(gray_objects,
+                          snek_array_get(view->parent, view->offset + i));
+      }
+      stack_push(slices, ref);
+      continue;
+    }
+
+    trace_blacken_object(gray_objects, ref);
+  }
+}
+
+static int trace_compare_slices(const void *a, const void *b) {
+  const snek_slice_t *left = &(*(snek_object_t *const *)a)->data.v_slice;
+  const snek_slice_t *right = &(*(snek_object_t *const *)b)->data.v_slice;
+  if (left->parent != right->parent) {
+    return (uintptr_t)left->parent < (uintptr_t)right->parent ? -1 : 1;
+  }
+  if (left->offset != right->offset) {
+    return left->offset < right->offset ? -1 : 1;
+  }
+  return 0;
+}
+
+// Slices of one parent can be compacted when they don't overlap (so no
+// aliasing is lost) and together cover a small part of the parent
+static bool trace_slice_group_compacts(void **group, size_t count) {
+  snek_object_t *parent = ((snek_object_t *)group[0])->data.v_slice.parent;
+  size_t covered = 0;
+  size_t end = 0;
+  for (size_t i = 0; i < count; i++) {
+    snek_slice_t *view = &((snek_object_t *)group[i])->data.v_slice;
+    if (i > 0 && view->offset < end) {
+      return false;
     }
+    end = view->offset + view->length;
+    covered += view->length;
   }
+  return covered * SLICE_COMPACT_RATIO <= parent->data.v_array.size;
+}
+
+static bool trace_compact_slice_group(void **group, size_t count) {
+  snek_array_buffer_t **buffers = calloc(count, sizeof(snek_array_buffer_t *));
+  if (buffers == NULL) {
+    return false;
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    snek_slice_t *view = &((snek_object_t *)group[i])->data.v_slice;
+    buffers[i] = snek_array_buffer_new(view->length);
+    if (buffers[i] == NULL) {
+      for (size_t j = 0; j < i; j++) {
+        snek_array_buffer_release(buffers[j]);
+      }
+      free(buffers);
+      return false;
+    }
+  }
+
+  // Elements in range were already marked when the slice was deferred
+  for (size_t i = 0; i < count; i++) {
+    snek_object_t *slice = group[i];
+    snek_slice_t view = slice->data.v_slice;
+    for (size_t j = 0; j < view.length; j++) {
+      buffers[i]->elements[j] = snek_array_get(view.parent, view.offset + j);
+    }
+    slice->kind = ARRAY;
+    slice->data.v_array = (snek_array_t){.size = view.length,
+                                         .elements = buffers[i]->elements,
+                                         .buffer = buffers[i],
+                                         .split = view.length};
+  }
+  free(buffers);
+  return true;
+}
+
+// Slices are sorted by parent, returns the end of the group at `start`
+static size_t trace_slice_group_end(stack_t *slices, size_t start) {
+  snek_object_t *parent =
+      ((snek_object_t *)slices->data[start])->data.v_slice.parent;
+  size_t end = start;
+  while (end < slices->count &&
+         ((snek_object_t *)slices->data[end])->data.v_slice.parent == parent) {
+    end++;
+  }
+  return end;
+}
+
+static void trace_compact_slices(stack_t *gray_objects, stack_t *slices) {
+  qsort(slices->data, slices->count, sizeof(void *), trace_compare_slices);
+
+  // Keep alive the parents whose slices don't qualify, then finish tracing
+  // so every other path to the remaining parents is discovered
+  size_t start = 0;
+  while (start < slices->count) {
+    snek_object_t *parent =
+        ((snek_object_t *)slices->data[start])->data.v_slice.parent;
+    size_t end = trace_slice_group_end(slices, start);
+    if (!trace_slice_group_compacts(slices->data + start, end - start)) {
+      trace_mark_object(gray_objects, parent);
+    }
+    start = end;
+  }
+  trace_drain(gray_objects, NULL);
+
+  // Parents still unmarked are only reachable through their small slices
+  start = 0;
+  while (start < slices->count) {
+    snek_object_t *parent =
+        ((snek_object_t *)slices->data[start])->data.v_slice.parent;
+    size_t end = trace_slice_group_end(slices, start);
+    if (!parent->is_marked &&
+        !trace_compact_slice_group(slices->data + start, end - start)) {
+      trace_mark_object(gray_objects, parent);
+    }
+    start = end;
+  }
+  trace_drain(gray_objects, NULL);
 }
 
 void trace(vm_t *vm) {
@@ -119,18 +834,24 @@ void trace(vm_t *vm) {
   if (gray_objects == NULL) {
     return;
   }
+  stack_t *slices = stack_new(8);
 
-  for (int i = 0; i < vm->objects->count; i++) {
-    snek_object_t *obj = vm->objects->data[i];
+  registry_cursor_t cursor = registry_begin(vm->objects);
+  snek_object_t *obj;
+  while ((obj = registry_next(&cursor)) != NULL) {
     if (obj->is_marked) {
       stack_push(gray_objects, obj);
     }
   }
 
-  while (gray_objects->count > 0) {
-    snek_object_t *ref = stack_pop(gray_objects);
-    trace_blacken_object(gray_objects, ref);
+  trace_epoch = atomic_fetch_add(&trace_epoch_counter, 1) + 1;
+  trace_gray_peak = 0;
+  trace_drain(gray_objects, slices);
+  if (slices != NULL) {
+    trace_compact_slices(gray_objects, slices);
+    stack_free(slices);
   }
+  trace_epoch = 0;
   stack_free(gray_objects);
 }
 
@@ -138,19 +859,40 @@ void trace_blacken_object(stack_t *gray_objects, snek_object_t *ref) {
   switch (ref->kind) {
   case INTEGER:
   case FLOAT:
+  case INT_ARRAY:
+  case FLOAT_ARRAY:
+  case FLOAT_VECTOR3:
+    break;
   case STRING:
+    // Flat strings have no children, ropes keep both halves alive
+    if (ref->data.v_string.rope != NULL) {
+      trace_mark_object(gray_objects, ref->data.v_string.rope->left);
+      trace_mark_object(gray_objects, ref->data.v_string.rope->right);
+    }
+    break;
+  case SLICE:
+    trace_mark_object(gray_objects, ref->data.v_slice.parent);
+    break;
+  case PVECTOR:
+    snek_pvec_trace(gray_objects, ref, trace_epoch);
     break;
   case VECTOR3:
     trace_mark_object(gray_objects, ref->data.v_vector3.x);
     trace_mark_object(gray_objects, ref->data.v_vector3.y);
     trace_mark_object(gray_objects, ref->data.v_vector3.z);
     break;
-  case ARRAY:
-    for (int i = 0; i < ref->data.v_array.size; i++) {
-      trace_mark_object(gray_objects, ref->data.v_array.elements[i]);
+  case ARRAY: {
+    // Shared buffers are traced once per array that uses them
+    snek_array_t *array = &ref->data.v_array;
+    for (size_t i = 0; i < array->split; i++) {
+      trace_mark_object(gray_objects, array->buffer->elements[i]);
+    }
+    for (size_t i = array->split; i < array->size; i++) {
+      trace_mark_object(gray_objects, array->tail->elements[i - array->split]);
     }
     break;
   }
+  }
 }
 
 void trace_mark_object(stack_t *gray_objects, snek_object_t *ref) {
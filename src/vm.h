@@ -1,14 +1,70 @@
 #pragma once
 
+#include "gcstats.h"
+#include "gctrace.h"
+#include "registry.h"
 #include "snekobject.h"
 #include "stack.h"
+#include <pthread.h>
+#include <stdatomic.h>
 
 typedef struct VirtualMachine
 {
+    /// Frames of the thread that created the VM, and of any other thread
+    /// that isn't attached as a mutator
     stack_t *frames;
-    stack_t *objects;
+    registry_t *objects;
+    /// Collections are only timed and measured while this is set
+    bool stats_enabled;
+    gc_stats_t stats;
+    /// Trace event output, NULL unless tracing was started
+    gc_tracer_t *tracer;
+    /// Checks the heap after every collection, see `vm_verify_heap`
+    bool verify_heap;
+    /// Stress mode collects every `gc_stress_interval` allocations, 0 is off
+    size_t gc_stress_interval;
+    size_t gc_stress_countdown;
+    /// Nonzero while a stress collection would free unrooted temporaries
+    int gc_inhibit;
+    /// The scavenger runs after every `scavenge_interval`-th collection,
+    /// 0 is off
+    size_t scavenge_interval;
+    size_t scavenge_countdown;
+
+    /// Attached threads, see `vm_mutator_new`. Set once the first one is
+    /// created, from then on collections stop every mutator at a
+    /// safepoint first.
+    bool shared;
+    stack_t *mutators;
+    atomic_bool safepoint_requested;
+    /// Guards `running`, `mutators` and the safepoint handshake
+    pthread_mutex_t safepoint_lock;
+    pthread_cond_t safepoint_parked;
+    pthread_cond_t safepoint_resume;
+    /// Threads executing VM code, parked and blocked threads don't count
+    size_t running;
 } vm_t;
 
+/// Collections between scavenger runs, see `vm_scavenge`
+#define VM_SCAVENGE_INTERVAL 8
+
+/// Objects a mutator buffers before registering them with one reservation
+#define VM_REGISTER_BATCH 256
+
+/// A thread allocating from a shared VM, with its own frame stack
+typedef struct VmMutator
+{
+    vm_t *vm;
+    stack_t *frames;
+    int gc_inhibit;
+    /// Objects this thread allocated that aren't in `vm->objects` yet.
+    /// Only their registration is batched, the headers themselves still
+    /// come from the allocator. Filled without synchronization, moved into
+    /// the registry when full and when a collection stops the world.
+    void *pending[VM_REGISTER_BATCH];
+    size_t pending_count;
+} vm_mutator_t;
+
 typedef struct Frame
 {
     stack_t *references;
@@ -21,6 +77,97 @@ void sweep(vm_t *vm);
 
 void vm_collect_garbage(vm_t *vm);
 
+/// Gives memory the collections freed back to the OS: frame and reference
+/// stacks at most a quarter full are cut to twice their count, and
+/// malloc's free pages are released. Returns the stack bytes released.
+/// Collections run it every `interval`-th time, VM_SCAVENGE_INTERVAL at
+/// first, 0 leaves it to explicit calls.
+size_t vm_scavenge(vm_t *vm);
+void vm_scavenge_interval(vm_t *vm, size_t interval);
+
+/// Turns collection statistics on or off, they start off
+void vm_gc_stats_enable(vm_t *vm, bool enabled);
+/// Copies the statistics gathered so far into `out`, with the heap size
+/// and pause percentiles computed at the time of the call. A shared VM's
+/// world is stopped meanwhile.
+void vm_gc_stats(vm_t *vm, gc_stats_t *out);
+
+/// Runs `vm_verify_heap` after every collection and aborts when it fails.
+/// Starts on when built with -DSNEK_VERIFY_HEAP, off otherwise.
+void vm_verify_heap_enable(vm_t *vm, bool enabled);
+
+/// Collects before every `interval`-th object allocation, 0 turns it off.
+/// Freed blocks are poisoned while any VM is in stress mode, so an object
+/// that misses its `frame_reference_object` is freed and garbled at a
+/// reproducible point.
+/// Pair with `vm_verify_heap_enable` to catch the dangling reference.
+/// Starts at SNEK_GC_STRESS when built with -DSNEK_GC_STRESS=N.
+void vm_gc_stress(vm_t *vm, size_t interval);
+/// Called by `_new_snek_object` in stress mode
+void vm_gc_stress_step(vm_t *vm);
+
+vm_t *vm_gc_inhibit_enter(vm_t *vm);
+void vm_gc_inhibit_leave(vm_t **vm);
+
+/// Defers stress collections until the enclosing function returns, for
+/// paths that build several objects before any of them is rooted.
+/// A collection that came due meanwhile runs at the next allocation.
+#define VM_GC_INHIBIT_SCOPE(vm)                                             \
+    vm_t *vm_gc_inhibit_scope                                               \
+        __attribute__((cleanup(vm_gc_inhibit_leave))) =                     \
+            vm_gc_inhibit_enter(vm)
+
+/// Adds a mutator for a new thread. Called by a thread already running on
+/// the VM, before the new thread starts, which then calls
+/// `vm_mutator_attach` with the result. Every thread allocating from the VM
+/// at the same time needs its own mutator, the creating thread keeps
+/// using `vm->frames`.
+///
+/// Collections stop the world: the collecting thread waits until every
+/// other mutator parks at a safepoint. Threads poll at every allocation
+/// and frame push or pop, so as in stress mode an object must be rooted
+/// before the thread allocates again (or inside `VM_GC_INHIBIT_SCOPE`).
+/// A thread that waits on anything else (a join, a lock, I/O) must do so
+/// between `vm_blocking_enter` and `vm_blocking_leave`, otherwise a
+/// collection started meanwhile waits for it forever.
+///
+/// The heap is shared, the objects aren't thread safe: an object that more
+/// than one thread uses, even only to read, needs the program's own lock.
+/// Stress mode is for single threaded VMs.
+vm_mutator_t *vm_mutator_new(vm_t *vm);
+/// Binds the calling thread to `mutator`, its frames go on the mutator's
+/// frame stack from now on
+void vm_mutator_attach(vm_mutator_t *mutator);
+/// Called by the attached thread once it is done with the VM. Frames it
+/// left pushed are freed and stop rooting their objects.
+void vm_mutator_free(vm_mutator_t *mutator);
+
+/// Parks the calling thread while another thread collects. Called at
+/// allocation and frame push/pop, threads in long loops that do neither
+/// should call it too.
+void vm_safepoint(vm_t *vm);
+void vm_blocking_enter(vm_t *vm);
+void vm_blocking_leave(vm_t *vm);
+
+/// Stops every other thread of a shared VM at a safepoint and moves the
+/// objects they buffered into the registry, so the heap can be walked as
+/// it is. Waits out a collection another thread started first. Does
+/// nothing on a VM without mutators, and must not be called while the
+/// world is already stopped, as inside a collection.
+void vm_world_stop(vm_t *vm);
+void vm_world_resume(vm_t *vm);
+
+/// Frame stacks of the VM's threads, `vm->frames` first, NULL past the
+/// last one. Only stable while the world is stopped or single threaded.
+stack_t *vm_frame_stack(vm_t *vm, size_t index);
+
+/// Records collector phases as Chrome trace events into a ring of
+/// `capacity` events, written to `path` by `vm_gc_trace_flush`. The file
+/// is completed by `vm_gc_trace_stop` or `vm_free`.
+bool vm_gc_trace_start(vm_t *vm, const char *path, size_t capacity);
+bool vm_gc_trace_flush(vm_t *vm);
+void vm_gc_trace_stop(vm_t *vm);
+
 /// Helper funcs for `trace`
 void trace_blacken_object(stack_t *gray_objects, snek_object_t *ref);
 void trace_mark_object(stack_t *gray_objects, snek_object_t *ref);
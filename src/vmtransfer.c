@@ -0,0 +1,393 @@
+#include "bootmem.h"
+#include <stdint.h>
+#include <string.h>
+
+#include "heapsample.h"
+#include "sneknew.h"
+#include "snekpvec.h"
+#include "vmtransfer.h"
+
+// Objects of the subgraph mapped to their copies, open addressing over a
+// power of two table. A move only uses the keys.
+typedef struct TransferMap {
+  size_t mask;
+  size_t count;
+  snek_object_t **keys;
+  snek_object_t **values;
+} transfer_map_t;
+
+static size_t transfer_slot(transfer_map_t *map, snek_object_t *obj) {
+  uint64_t hash = ((uintptr_t)obj >> 4) * 0x9e3779b97f4a7c15ull;
+  size_t slot = (size_t)(hash >> 32) & map->mask;
+  while (map->keys[slot] != NULL && map->keys[slot] != obj) {
+    slot = (slot + 1) & map->mask;
+  }
+  return slot;
+}
+
+static bool transfer_map_init(transfer_map_t *map, size_t capacity) {
+  map->mask = capacity - 1;
+  map->count = 0;
+  map->keys = calloc(capacity, sizeof(snek_object_t *));
+  map->values = calloc(capacity, sizeof(snek_object_t *));
+  return map->keys != NULL && map->values != NULL;
+}
+
+static void transfer_map_free(transfer_map_t *map) {
+  free(map->keys);
+  free(map->values);
+}
+
+// Kept at most half full
+static bool transfer_map_grow(transfer_map_t *map) {
+  transfer_map_t grown;
+  if (!transfer_map_init(&grown, (map->mask + 1) * 2)) {
+    transfer_map_free(&grown);
+    return false;
+  }
+  for (size_t i = 0; i <= map->mask; i++) {
+    if (map->keys[i] != NULL) {
+      size_t slot = transfer_slot(&grown, map->keys[i]);
+      grown.keys[slot] = map->keys[i];
+      grown.values[slot] = map->values[i];
+    }
+  }
+  grown.count = map->count;
+  transfer_map_free(map);
+  *map = grown;
+  return true;
+}
+
+static bool transfer_map_contains(transfer_map_t *map, snek_object_t *obj) {
+  return map->keys[transfer_slot(map, obj)] == obj;
+}
+
+static snek_object_t *transfer_map_get(void *ctx, snek_object_t *obj) {
+  transfer_map_t *map = ctx;
+  return obj == NULL ? NULL : map->values[transfer_slot(map, obj)];
+}
+
+static void transfer_map_set(transfer_map_t *map, snek_object_t *obj,
+                             snek_object_t *value) {
+  map->values[transfer_slot(map, obj)] = value;
+}
+
+// Adds `obj` unless present, the subgraph is collected in `order` so the
+// map doesn't have to be walked
+static bool transfer_visit(transfer_map_t *map, stack_t *order,
+                           snek_object_t *obj) {
+  if (obj == NULL || transfer_map_contains(map, obj)) {
+    return true;
+  }
+  if ((map->count + 1) * 2 > map->mask + 1 && !transfer_map_grow(map)) {
+    return false;
+  }
+  map->keys[transfer_slot(map, obj)] = obj;
+  map->count++;
+  stack_push(order, obj);
+  return true;
+}
+
+static bool transfer_visit_children(transfer_map_t *map, stack_t *order,
+                                    snek_object_t *obj) {
+  switch (obj->kind) {
+  case STRING:
+    return obj->data.v_string.rope == NULL ||
+           (transfer_visit(map, order, obj->data.v_string.rope->left) &&
+            transfer_visit(map, order, obj->data.v_string.rope->right));
+  case VECTOR3:
+    return transfer_visit(map, order, obj->data.v_vector3.x) &&
+           transfer_visit(map, order, obj->data.v_vector3.y) &&
+           transfer_visit(map, order, obj->data.v_vector3.z);
+  case SLICE:
+    return transfer_visit(map, order, obj->data.v_slice.parent);
+  case ARRAY:
+    for (size_t i = 0; i < obj->data.v_array.size; i++) {
+      if (!transfer_visit(map, order, snek_array_get(obj, i))) {
+        return false;
+      }
+    }
+    return true;
+  case PVECTOR:
+    for (size_t i = 0; i < obj->data.v_pvec.size; i++) {
+      if (!transfer_visit(map, order, snek_pvec_get(obj, i))) {
+        return false;
+      }
+    }
+    return true;
+  default:
+    return true;
+  }
+}
+
+// Breadth first from `obj`, `order` ends up holding the whole subgraph
+static bool transfer_collect(transfer_map_t *map, stack_t *order,
+                             snek_object_t *obj) {
+  if (!transfer_visit(map, order, obj)) {
+    return false;
+  }
+  for (size_t i = 0; i < order->count; i++) {
+    if (!transfer_visit_children(map, order, order->data[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Whether anything `src` reaches from its frames is in the subgraph.
+// Walks with a map of its own instead of the collector's mark and trace,
+// which would also compact slices, so `src` is only read. Out of memory
+// counts as reaching, the copy that follows leaves `src` as it was.
+static bool transfer_src_reaches(vm_t *src, transfer_map_t *subgraph) {
+  transfer_map_t seen;
+  stack_t *reached = stack_new(16);
+  bool ok = reached != NULL && transfer_map_init(&seen, 16);
+
+  stack_t *frames;
+  for (size_t s = 0; ok && (frames = vm_frame_stack(src, s)) != NULL; s++) {
+    for (size_t i = 0; ok && i < frames->count; i++) {
+      frame_t *frame = frames->data[i];
+      for (size_t j = 0; ok && j < frame->references->count; j++) {
+        ok = transfer_visit(&seen, reached, frame->references->data[j]);
+      }
+    }
+  }
+
+  bool reaches = !ok;
+  for (size_t i = 0; ok && !reaches && i < reached->count; i++) {
+    snek_object_t *obj = reached->data[i];
+    reaches = transfer_map_contains(subgraph, obj);
+    ok = transfer_visit_children(&seen, reached, obj);
+    reaches = reaches || !ok;
+  }
+  if (reached != NULL) {
+    transfer_map_free(&seen);
+  }
+  stack_free(reached);
+  return reaches;
+}
+
+static snek_object_t *transfer_move(vm_t *src, vm_t *dst, transfer_map_t *map,
+                                    stack_t *order) {
+  // Everything must be registered in `src` before anything is changed
+  size_t found = 0;
+  registry_cursor_t cursor = registry_begin(src->objects);
+  snek_object_t *entry;
+  while ((entry = registry_next(&cursor)) != NULL) {
+    found += transfer_map_contains(map, entry);
+  }
+  if (found != order->count) {
+    return NULL;
+  }
+
+  for (size_t i = 0; i < order->count; i++) {
+    snek_object_t *obj = order->data[i];
+    if (obj->kind == ARRAY && !snek_array_detach(obj)) {
+      return NULL;
+    }
+    if (obj->kind == PVECTOR && obj->data.v_pvec.root != NULL) {
+      snek_pvec_node_t *root =
+          snek_pvec_tree_copy(obj->data.v_pvec.root, NULL, NULL);
+      if (root == NULL) {
+        return NULL;
+      }
+      snek_pvec_node_release(obj->data.v_pvec.root);
+      obj->data.v_pvec.root = root;
+    }
+  }
+
+  cursor = registry_begin(src->objects);
+  while ((entry = registry_next(&cursor)) != NULL) {
+    if (transfer_map_contains(map, entry)) {
+      registry_remove_current(src->objects, &cursor);
+    }
+  }
+  registry_compact(src->objects, true);
+  registry_add_many(dst->objects, (snek_object_t **)order->data,
+                    order->count);
+  return order->data[0];
+}
+
+// A header for `obj` with its own payload, not registered anywhere yet.
+// References to other objects are filled in by `transfer_link` once
+// every copy exists.
+static snek_object_t *transfer_shell(snek_object_t *obj) {
+  snek_object_t *copy =
+      calloc_as(BOOT_CATEGORY_OBJECT, 1, sizeof(snek_object_t));
+  if (copy == NULL) {
+    return NULL;
+  }
+
+  switch (obj->kind) {
+  case STRING: {
+    snek_string_t string = obj->data.v_string;
+    if (string.chars != NULL) {
+      string.chars = malloc_as(BOOT_CATEGORY_STRING, string.length + 1);
+      if (string.chars == NULL) {
+        free(copy);
+        return NULL;
+      }
+      memcpy(string.chars, obj->data.v_string.chars, string.length + 1);
+    } else {
+      // Halves are filled in by `transfer_link`
+      string.rope = malloc_as(BOOT_CATEGORY_STRING, sizeof(snek_rope_t));
+      if (string.rope == NULL) {
+        free(copy);
+        return NULL;
+      }
+      *string.rope = *obj->data.v_string.rope;
+    }
+    copy->data.v_string = string;
+    break;
+  }
+  case ARRAY: {
+    size_t size = obj->data.v_array.size;
+    snek_array_buffer_t *buffer = snek_array_buffer_new(size);
+    if (buffer == NULL) {
+      free(copy);
+      return NULL;
+    }
+    copy->data.v_array = (snek_array_t){.size = size,
+                                        .elements = buffer->elements,
+                                        .buffer = buffer,
+                                        .split = size};
+    break;
+  }
+  case INT_ARRAY: {
+    snek_int_array_t array = obj->data.v_int_array;
+    array.elements = malloc_as(BOOT_CATEGORY_ARRAY,
+                               (array.size ? array.size : 1) * sizeof(int32_t));
+    if (array.elements == NULL) {
+      free(copy);
+      return NULL;
+    }
+    memcpy(array.elements, obj->data.v_int_array.elements,
+           array.size * sizeof(int32_t));
+    copy->data.v_int_array = array;
+    break;
+  }
+  case FLOAT_ARRAY: {
+    snek_float_array_t array = obj->data.v_float_array;
+    array.elements = malloc_as(BOOT_CATEGORY_ARRAY,
+                               (array.size ? array.size : 1) * sizeof(float));
+    if (array.elements == NULL) {
+      free(copy);
+      return NULL;
+    }
+    memcpy(array.elements, obj->data.v_float_array.elements,
+           array.size * sizeof(float));
+    copy->data.v_float_array = array;
+    break;
+  }
+  case PVECTOR:
+    copy->data.v_pvec = obj->data.v_pvec;
+    copy->data.v_pvec.root = NULL;
+    break;
+  default:
+    copy->data = obj->data;
+    break;
+  }
+  copy->kind = obj->kind;
+  return copy;
+}
+
+static bool transfer_link(transfer_map_t *map, snek_object_t *obj) {
+  snek_object_t *copy = transfer_map_get(map, obj);
+  switch (obj->kind) {
+  case STRING:
+    if (obj->data.v_string.rope != NULL) {
+      snek_rope_t *rope = copy->data.v_string.rope;
+      rope->left = transfer_map_get(map, obj->data.v_string.rope->left);
+      rope->right = transfer_map_get(map, obj->data.v_string.rope->right);
+    }
+    return true;
+  case VECTOR3:
+    copy->data.v_vector3.x = transfer_map_get(map, obj->data.v_vector3.x);
+    copy->data.v_vector3.y = transfer_map_get(map, obj->data.v_vector3.y);
+    copy->data.v_vector3.z = transfer_map_get(map, obj->data.v_vector3.z);
+    return true;
+  case SLICE:
+    copy->data.v_slice.parent =
+        transfer_map_get(map, obj->data.v_slice.parent);
+    return true;
+  case ARRAY:
+    for (size_t i = 0; i < obj->data.v_array.size; i++) {
+      copy->data.v_array.elements[i] =
+          transfer_map_get(map, snek_array_get(obj, i));
+    }
+    return true;
+  case PVECTOR:
+    if (obj->data.v_pvec.root == NULL) {
+      return true;
+    }
+    copy->data.v_pvec.root =
+        snek_pvec_tree_copy(obj->data.v_pvec.root, transfer_map_get, map);
+    return copy->data.v_pvec.root != NULL;
+  default:
+    return true;
+  }
+}
+
+// Frees the copies made so far, they were never registered
+static void transfer_copy_abort(transfer_map_t *map, stack_t *order,
+                                size_t made) {
+  for (size_t i = 0; i < made; i++) {
+    snek_object_free(transfer_map_get(map, order->data[i]));
+  }
+}
+
+// Copies are built outside `dst` and registered together at the end, so
+// the registry is appended to once for the whole subgraph and nothing
+// half built can be collected
+static snek_object_t *transfer_copy(vm_t *dst, transfer_map_t *map,
+                                    stack_t *order) {
+  for (size_t i = 0; i < order->count; i++) {
+    snek_object_t *copy = transfer_shell(order->data[i]);
+    if (copy == NULL) {
+      transfer_copy_abort(map, order, i);
+      return NULL;
+    }
+    transfer_map_set(map, order->data[i], copy);
+  }
+  for (size_t i = 0; i < order->count; i++) {
+    if (!transfer_link(map, order->data[i])) {
+      transfer_copy_abort(map, order, order->count);
+      return NULL;
+    }
+  }
+
+  // The copies' tracked order is theirs in `order`
+  for (size_t i = 0; i < order->count; i++) {
+    order->data[i] = transfer_map_get(map, order->data[i]);
+  }
+  heap_sample_claim(dst);
+  registry_add_many(dst->objects, (snek_object_t **)order->data,
+                    order->count);
+  return order->data[0];
+}
+
+snek_object_t *vm_transfer(vm_t *src, vm_t *dst, snek_object_t *obj) {
+  if (src == NULL || dst == NULL || obj == NULL || src->shared ||
+      dst->shared) {
+    return NULL;
+  }
+  if (src == dst) {
+    return obj;
+  }
+
+  transfer_map_t map = {0};
+  stack_t *order = stack_new(16);
+  snek_object_t *result = NULL;
+  if (order != NULL && transfer_map_init(&map, 16)) {
+    if (transfer_collect(&map, order, obj)) {
+      if (transfer_src_reaches(src, &map)) {
+        result = transfer_copy(dst, &map, order);
+      } else {
+        result = transfer_move(src, dst, &map, order);
+      }
+    }
+  }
+  transfer_map_free(&map);
+  stack_free(order);
+  return result;
+}
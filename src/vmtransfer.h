@@ -0,0 +1,21 @@
+#pragma once
+
+#include "snekobject.h"
+#include "vm.h"
+
+/// Moves `obj` and everything reachable from it from `src` to `dst`, for
+/// handing data between VMs that each belong to one thread. Returns the
+/// object to use in `dst`, or NULL when either VM is shared or memory ran
+/// out.
+///
+/// When nothing `src` can still reach from its frames is part of the
+/// subgraph, its objects are re-homed: they leave `src`'s registry and
+/// join `dst`'s unchanged, returning `obj` itself. Only array buffers and
+/// persistent vector trees are copied, so no refcounted storage stays
+/// shared between the two VMs. Otherwise the subgraph is deep copied into
+/// `dst`, cycles and sharing inside it kept intact, and `src` is left as
+/// it was.
+///
+/// The calling thread must be the only one using either VM, and must root
+/// the result in `dst` before its next allocation there.
+snek_object_t *vm_transfer(vm_t *src, vm_t *dst, snek_object_t *obj);
@@ -0,0 +1,316 @@
+#include "../munit/munit.h"
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include "../src/bootmem.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/vm.h"
+#include <pthread.h>
+#include <string.h>
+#include "stdlib.h"
+
+#define MAX_SITES 64
+
+static boot_site_stats_t *find_file_site(boot_site_stats_t *sites,
+                                         size_t count, int line)
+{
+  for (size_t i = 0; i < count; i++)
+  {
+    if (sites[i].file != NULL && strcmp(sites[i].file, __FILE__) == 0 &&
+        sites[i].line == line)
+    {
+      return &sites[i];
+    }
+  }
+  return NULL;
+}
+
+static MunitResult test_file_sites(const MunitParameter params[],
+                                   void *user_data)
+{
+  boot_profile_enable(true);
+  boot_profile_reset();
+
+  int line = __LINE__ + 1;
+  char *block = malloc(100);
+  char *other = calloc(10, 4);
+
+  boot_site_stats_t sites[MAX_SITES];
+  size_t count = boot_profile_sites(sites, MAX_SITES);
+  boot_site_stats_t *site = find_file_site(sites, count, line);
+  munit_assert_not_null(site);
+  munit_assert_uint64(site->allocations, ==, 1);
+  munit_assert_int64(site->live_count, ==, 1);
+  munit_assert_int64(site->live_bytes, ==, 100);
+  // Sorted by live bytes
+  munit_assert_ptr_equal(site, &sites[0]);
+  munit_assert_int64(sites[1].live_bytes, ==, 40);
+
+  // Growing keeps the block charged to where it was allocated
+  block = realloc(block, 300);
+  free(other);
+  count = boot_profile_sites(sites, MAX_SITES);
+  site = find_file_site(sites, count, line);
+  munit_assert_int64(site->live_bytes, ==, 300);
+  munit_assert_uint64(site->total_bytes, ==, 300);
+
+  free(block);
+  count = boot_profile_sites(sites, MAX_SITES);
+  site = find_file_site(sites, count, line);
+  munit_assert_int64(site->live_count, ==, 0);
+  munit_assert_int64(site->live_bytes, ==, 0);
+  munit_assert_uint64(site->allocations, ==, 1);
+
+  boot_profile_enable(false);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_constructor_sites(const MunitParameter params[],
+                                          void *user_data)
+{
+  vm_t *vm = vm_new();
+  boot_profile_enable(true);
+  boot_profile_reset();
+
+  // The object and its characters are both charged to this function
+  new_snek_string("hello", vm);
+
+  boot_site_stats_t sites[MAX_SITES];
+  size_t count = boot_profile_sites(sites, MAX_SITES);
+  boot_site_stats_t *caller = NULL;
+  for (size_t i = 0; i < count; i++)
+  {
+    if (sites[i].caller != NULL)
+    {
+      munit_assert_null(caller);
+      caller = &sites[i];
+    }
+  }
+  munit_assert_not_null(caller);
+  munit_assert_uint64(caller->allocations, ==, 2);
+  munit_assert_int64(caller->live_bytes, ==, sizeof(snek_object_t) + 6);
+
+  boot_profile_enable(false);
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_disabled(const MunitParameter params[],
+                                 void *user_data)
+{
+  boot_profile_enable(false);
+  boot_profile_reset();
+
+  vm_t *vm = vm_new();
+  new_snek_integer(1, vm);
+  boot_site_stats_t sites[MAX_SITES];
+  munit_assert_size(boot_profile_sites(sites, MAX_SITES), ==, 0);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_report(const MunitParameter params[],
+                               void *user_data)
+{
+  boot_profile_enable(true);
+  boot_profile_reset();
+  char *block = malloc(64);
+
+  FILE *out = tmpfile();
+  munit_assert_not_null(out);
+  boot_profile_report(out, 10);
+  rewind(out);
+  char text[1024];
+  size_t length = fread(text, 1, sizeof(text) - 1, out);
+  text[length] = '\0';
+  fclose(out);
+
+  munit_assert_not_null(strstr(text, "live bytes"));
+  munit_assert_not_null(strstr(text, "test_bootmem.c:"));
+
+  free(block);
+  boot_profile_enable(false);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_categories(const MunitParameter params[],
+                                   void *user_data)
+{
+  vm_t *vm = vm_new();
+  boot_mem_stats_t objects, strings, all;
+  boot_mem_stats(BOOT_CATEGORY_OBJECT, &objects);
+  boot_mem_stats(BOOT_CATEGORY_STRING, &strings);
+  boot_mem_stats(BOOT_CATEGORY_ALL, &all);
+  boot_mem_reset_peak();
+
+  new_snek_string("hello", vm);
+
+  boot_mem_stats_t after;
+  boot_mem_stats(BOOT_CATEGORY_OBJECT, &after);
+  munit_assert_size(after.current_bytes, ==,
+                    objects.current_bytes + sizeof(snek_object_t));
+  munit_assert_uint64(after.allocations, ==, objects.allocations + 1);
+  boot_mem_stats(BOOT_CATEGORY_STRING, &after);
+  munit_assert_size(after.current_bytes, ==, strings.current_bytes + 6);
+  munit_assert_size(after.peak_bytes, ==, after.current_bytes);
+
+  // Growth counts as allocated bytes and shrinkage as freed bytes
+  boot_mem_stats(BOOT_CATEGORY_ALL, &all);
+  char *block = malloc(100);
+  block = realloc(block, 400);
+  block = realloc(block, 50);
+  boot_mem_stats(BOOT_CATEGORY_ALL, &after);
+  munit_assert_size(after.current_bytes, ==, all.current_bytes + 50);
+  munit_assert_size(after.peak_bytes, >=, all.current_bytes + 400);
+  munit_assert_uint64(after.allocated_bytes, ==, all.allocated_bytes + 400);
+  munit_assert_uint64(after.freed_bytes, ==, all.freed_bytes + 350);
+  munit_assert_uint64(after.allocations, ==, all.allocations + 1);
+  free(block);
+
+  vm_free(vm);
+  boot_mem_stats(BOOT_CATEGORY_STRING, &after);
+  munit_assert_size(after.current_bytes, ==, strings.current_bytes);
+  munit_assert_uint64(after.freed_bytes, ==, strings.freed_bytes + 6);
+  munit_assert_size(after.peak_bytes, ==, strings.current_bytes + 6);
+
+  boot_mem_reset_peak();
+  boot_mem_stats(BOOT_CATEGORY_ALL, &after);
+  munit_assert_size(after.peak_bytes, ==, after.current_bytes);
+  munit_assert_size(boot_current_bytes(), ==, after.current_bytes);
+  munit_assert_uint64(after.allocated_bytes - after.freed_bytes, ==,
+                      after.current_bytes);
+  munit_assert_string_equal(boot_category_name(BOOT_CATEGORY_STACK),
+                            "stack");
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static void *churn_blocks(void *arg)
+{
+  for (int i = 0; i < 10000; i++)
+  {
+    // Freed on the other thread half of the time
+    void **slot = arg;
+    void *block = malloc(1 + i % 200);
+    void *previous = __atomic_exchange_n(slot, block, __ATOMIC_ACQ_REL);
+    free(previous);
+  }
+  return NULL;
+}
+
+static MunitResult test_threads(const MunitParameter params[],
+                                void *user_data)
+{
+  boot_mem_stats_t before, after;
+  boot_mem_stats(BOOT_CATEGORY_OTHER, &before);
+
+  void *slot = NULL;
+  pthread_t threads[4];
+  for (int i = 0; i < 4; i++)
+  {
+    pthread_create(&threads[i], NULL, churn_blocks, &slot);
+  }
+  for (int i = 0; i < 4; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  free(slot);
+
+  boot_mem_stats(BOOT_CATEGORY_OTHER, &after);
+  munit_assert_size(after.current_bytes, ==, before.current_bytes);
+  munit_assert_uint64(after.allocations - before.allocations, ==, 40000);
+  munit_assert_uint64(after.frees - before.frees, ==, 40000);
+  munit_assert_uint64(after.allocated_bytes - before.allocated_bytes, ==,
+                      after.freed_bytes - before.freed_bytes);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_overflow(const MunitParameter params[],
+                                 void *user_data)
+{
+  // Sizes that wrap once the header is added fail instead
+  munit_assert_null(malloc(SIZE_MAX - 1));
+  munit_assert_null(malloc_as(BOOT_CATEGORY_STRING, SIZE_MAX - 1));
+  munit_assert_null(calloc(1, SIZE_MAX - 1));
+
+  char *block = malloc(8);
+  munit_assert_not_null(block);
+  memcpy(block, "kept", 5);
+  munit_assert_null(realloc(block, SIZE_MAX - 1));
+  munit_assert_string_equal(block, "kept");
+  free(block);
+
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static int exited_line;
+
+static void *allocate_and_exit(void *arg)
+{
+  (void)arg;
+  exited_line = __LINE__ + 1;
+  free(malloc(16));
+  return NULL;
+}
+
+static MunitResult test_thread_exit(const MunitParameter params[],
+                                    void *user_data)
+{
+  boot_profile_reset();
+  boot_profile_enable(true);
+#ifdef __GLIBC__
+  struct mallinfo2 before = mallinfo2();
+#endif
+
+  // One thread at a time, each exits before the next starts
+  for (int i = 0; i < 64; i++)
+  {
+    pthread_t thread;
+    pthread_create(&thread, NULL, allocate_and_exit, NULL);
+    pthread_join(thread, NULL);
+  }
+  boot_profile_enable(false);
+
+  // Exited threads keep their history
+  boot_site_stats_t sites[MAX_SITES];
+  size_t count = boot_profile_sites(sites, MAX_SITES);
+  boot_site_stats_t *site = find_file_site(sites, count, exited_line);
+  munit_assert_not_null(site);
+  munit_assert_uint64(site->allocations, ==, 64);
+  munit_assert_int64(site->live_count, ==, 0);
+
+#ifdef __GLIBC__
+  // Their site tables are reused rather than one left per thread
+  struct mallinfo2 after = mallinfo2();
+  munit_assert_size(after.hblkhd + after.uordblks, <,
+                    before.hblkhd + before.uordblks + 4 * 1024 * 1024);
+#endif
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitTest bootmem_tests[] = {
+    {"/file_sites", test_file_sites, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/constructor_sites", test_constructor_sites, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/disabled", test_disabled, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/report", test_report, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/categories", test_categories, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/threads", test_threads, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/overflow", test_overflow, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/thread_exit", test_thread_exit, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+MunitSuite bootmem_suite = {"/bootmem", bootmem_tests, NULL, 1,
+                            MUNIT_SUITE_OPTION_NONE};
@@ -0,0 +1,70 @@
+#include "../munit/munit.h"
+#include "../fuzz/snekfuzz.h"
+#include "../src/bootmem.h"
+
+// Fixed seeds, so a failure here replays with the fuzz target
+#define CORPUS_PROGRAMS 256
+#define CORPUS_PROGRAM_SIZE 1024
+
+static void run_program(const uint8_t *data, size_t size)
+{
+  char error[256];
+  bool ok = snek_fuzz_run(data, size, error, sizeof(error));
+  if (!ok)
+  {
+    munit_errorf("program of %zu bytes failed: %s", size, error);
+  }
+  munit_assert_true(boot_all_freed());
+}
+
+static MunitResult test_empty(const MunitParameter params[], void *user_data)
+{
+  run_program(NULL, 0);
+  return MUNIT_OK;
+}
+
+// Op bytes follow the FuzzOp order in snekfuzz.c
+static MunitResult test_handcrafted(const MunitParameter params[],
+                                    void *user_data)
+{
+  // Frame, array of 4, integer, set array[1], root the array, collect,
+  // slice it, collect, pop the frame and collect
+  static const uint8_t rooted_array[] = {13, 3, 4, 0, 7, 11, 0, 0, 1, 1, 0, 15,
+                                         0,  0, 16, 7, 0, 0, 1, 3, 16, 14, 16};
+  run_program(rooted_array, sizeof(rooted_array));
+
+  // Unrooted strings, a rope over them and a pvec push, all freed
+  static const uint8_t garbage[] = {2, 5, 2, 9, 8, 0, 0, 1, 0, 9, 10, 3, 0,
+                                    2, 0, 16};
+  run_program(garbage, sizeof(garbage));
+  return MUNIT_OK;
+}
+
+static MunitResult test_corpus(const MunitParameter params[], void *user_data)
+{
+  static uint8_t data[CORPUS_PROGRAM_SIZE];
+  uint64_t state = 0x9e3779b97f4a7c15ull;
+  for (int program = 0; program < CORPUS_PROGRAMS; program++)
+  {
+    for (size_t i = 0; i < CORPUS_PROGRAM_SIZE; i++)
+    {
+      state ^= state << 13;
+      state ^= state >> 7;
+      state ^= state << 17;
+      data[i] = (uint8_t)(state >> 24);
+    }
+    // Vary the length so programs end at every kind of operation
+    run_program(data, CORPUS_PROGRAM_SIZE - program % 64);
+  }
+  return MUNIT_OK;
+}
+
+static MunitTest fuzz_tests[] = {
+    {"/empty", test_empty, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/handcrafted", test_handcrafted, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/corpus", test_corpus, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+MunitSuite fuzz_suite = {"/fuzz", fuzz_tests, NULL, 1,
+                         MUNIT_SUITE_OPTION_NONE};
@@ -0,0 +1,152 @@
+#include "../munit/munit.h"
+#include "../src/bootmem.h"
+#include "../src/gcstats.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/vm.h"
+#include "stdlib.h"
+
+static MunitResult test_buckets(const MunitParameter params[],
+                                void *user_data)
+{
+  munit_assert_int(gc_stats_bucket(0), ==, 0);
+  munit_assert_int(gc_stats_bucket(1), ==, 0);
+  munit_assert_int(gc_stats_bucket(2), ==, 1);
+  munit_assert_int(gc_stats_bucket(1023), ==, 9);
+  munit_assert_int(gc_stats_bucket(1024), ==, 10);
+  munit_assert_int(gc_stats_bucket(UINT64_MAX), ==, GC_PAUSE_BUCKETS - 1);
+
+  return MUNIT_OK;
+}
+
+static MunitResult test_percentiles(const MunitParameter params[],
+                                    void *user_data)
+{
+  gc_stats_t stats = {0};
+  munit_assert_uint64(gc_stats_percentile(&stats, 0.5), ==, 0);
+
+  // 98 fast pauses and two slow ones
+  for (int i = 0; i < 98; i++)
+  {
+    gc_stats_record_pause(&stats, 1000);
+  }
+  gc_stats_record_pause(&stats, 1000000);
+  gc_stats_record_pause(&stats, 3000000);
+
+  munit_assert_uint64(stats.collections, ==, 100);
+  munit_assert_uint64(stats.pause_max_ns, ==, 3000000);
+  munit_assert_uint64(stats.pause_last_ns, ==, 3000000);
+  munit_assert_uint64(gc_stats_percentile(&stats, 0.50), ==, 1024);
+  munit_assert_uint64(gc_stats_percentile(&stats, 0.98), ==, 1024);
+  munit_assert_uint64(gc_stats_percentile(&stats, 0.99), ==, 1 << 20);
+  munit_assert_uint64(gc_stats_percentile(&stats, 1.0), ==, 3000000);
+
+  return MUNIT_OK;
+}
+
+static MunitResult test_disabled(const MunitParameter params[],
+                                 void *user_data)
+{
+  vm_t *vm = vm_new();
+  new_snek_integer(1, vm);
+  vm_collect_garbage(vm);
+
+  gc_stats_t stats;
+  vm_gc_stats(vm, &stats);
+  munit_assert_uint64(stats.collections, ==, 0);
+  munit_assert_uint64(stats.objects_freed, ==, 0);
+  munit_assert_uint64(stats.heap_objects, ==, 0);
+  munit_assert_uint64(stats.heap_bytes, ==, 0);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+
+  return MUNIT_OK;
+}
+
+static MunitResult test_collections(const MunitParameter params[],
+                                    void *user_data)
+{
+  vm_t *vm = vm_new();
+  vm_gc_stats_enable(vm, true);
+  frame_t *frame = vm_new_frame(vm);
+
+  snek_object_t *kept = new_snek_int_array(100, vm);
+  frame_reference_object(frame, kept);
+  new_snek_int_array(50, vm);
+  new_snek_integer(7, vm);
+
+  size_t kept_bytes = snek_object_size(kept);
+  munit_assert_size(kept_bytes, ==,
+                    sizeof(snek_object_t) + 100 * sizeof(int32_t));
+
+  gc_stats_t stats;
+  vm_gc_stats(vm, &stats);
+  munit_assert_uint64(stats.heap_objects, ==, 3);
+  munit_assert_uint64(stats.heap_bytes, ==,
+                      kept_bytes + sizeof(snek_object_t) * 2 +
+                          50 * sizeof(int32_t));
+
+  vm_collect_garbage(vm);
+  vm_collect_garbage(vm);
+
+  vm_gc_stats(vm, &stats);
+  munit_assert_uint64(stats.collections, ==, 2);
+  munit_assert_uint64(stats.objects_freed, ==, 2);
+  munit_assert_uint64(stats.bytes_freed, ==,
+                      sizeof(snek_object_t) * 2 + 50 * sizeof(int32_t));
+  munit_assert_uint64(stats.objects_survived, ==, 1);
+  munit_assert_uint64(stats.bytes_survived, ==, kept_bytes);
+  munit_assert_uint64(stats.heap_bytes, ==, kept_bytes);
+  munit_assert_uint64(stats.pause_total_ns, >=,
+                      stats.mark_ns + stats.trace_ns + stats.sweep_ns);
+  munit_assert_uint64(stats.pause_max_ns, <=, stats.pause_total_ns);
+  munit_assert_uint64(stats.pause_p50_ns, <=, stats.pause_max_ns);
+  munit_assert_uint64(stats.pause_p99_ns, <=, stats.pause_max_ns);
+
+  uint64_t counted = 0;
+  for (int i = 0; i < GC_PAUSE_BUCKETS; i++)
+  {
+    counted += stats.pause_histogram[i];
+  }
+  munit_assert_uint64(counted, ==, 2);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+
+  return MUNIT_OK;
+}
+
+static MunitResult test_shared_size(const MunitParameter params[],
+                                    void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *a = new_snek_array(4, vm);
+  snek_object_t *b = new_snek_array(4, vm);
+  size_t alone = snek_object_size(a);
+
+  // The concatenation shares both buffers, so each is split in two
+  snek_object_t *ab = snek_add(a, b, vm);
+  munit_assert_size(snek_object_size(a) + snek_object_size(b) +
+                        snek_object_size(ab),
+                    <=, 2 * alone + sizeof(snek_object_t));
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+
+  return MUNIT_OK;
+}
+
+static MunitTest gcstats_tests[] = {
+    {"/buckets", test_buckets, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/percentiles", test_percentiles, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/disabled", test_disabled, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/collections", test_collections, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/shared_size", test_shared_size, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+MunitSuite gcstats_suite = {"/gcstats", gcstats_tests, NULL, 1,
+                            MUNIT_SUITE_OPTION_NONE};
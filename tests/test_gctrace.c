@@ -0,0 +1,165 @@
+#include "../munit/munit.h"
+#include "../src/bootmem.h"
+#include "../src/gctrace.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/vm.h"
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include "stdlib.h"
+
+static char *trace_path(void)
+{
+  static char path[] = "/tmp/snek_gctrace_XXXXXX";
+  strcpy(path, "/tmp/snek_gctrace_XXXXXX");
+  int fd = mkstemp(path);
+  munit_assert_int(fd, >=, 0);
+  close(fd);
+  return path;
+}
+
+// Reads the trace back with the real allocator, bootmem isn't involved
+static char *read_trace(const char *path)
+{
+  FILE *file = fopen(path, "r");
+  munit_assert_not_null(file);
+  static char contents[1 << 16];
+  size_t length = fread(contents, 1, sizeof(contents) - 1, file);
+  contents[length] = '\0';
+  fclose(file);
+  unlink(path);
+  return contents;
+}
+
+static size_t count_occurrences(const char *haystack, const char *needle)
+{
+  size_t count = 0;
+  for (const char *at = strstr(haystack, needle); at != NULL;
+       at = strstr(at + 1, needle))
+  {
+    count++;
+  }
+  return count;
+}
+
+static MunitResult test_collect_events(const MunitParameter params[],
+                                       void *user_data)
+{
+  char *path = trace_path();
+  vm_t *vm = vm_new();
+  munit_assert_true(vm_gc_trace_start(vm, path, 64));
+  munit_assert_false(vm_gc_trace_start(vm, path, 64));
+
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *array = new_snek_array(2, vm);
+  snek_array_set(array, 0, new_snek_integer(1, vm));
+  frame_reference_object(frame, array);
+  new_snek_integer(2, vm);
+  vm_collect_garbage(vm);
+  munit_assert_true(vm_gc_trace_flush(vm));
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+
+  char *trace = read_trace(path);
+  munit_assert_char(trace[0], ==, '[');
+  munit_assert_not_null(strstr(trace, "\n]\n"));
+  munit_assert_size(count_occurrences(trace, "\"ph\":\"B\""), ==, 4);
+  munit_assert_size(count_occurrences(trace, "\"ph\":\"E\""), ==, 4);
+  munit_assert_not_null(strstr(trace, "{\"name\":\"mark\",\"cat\":\"gc\","
+                                      "\"ph\":\"B\""));
+  munit_assert_not_null(strstr(trace, "{\"name\":\"sweep\""));
+  munit_assert_not_null(
+      strstr(trace, "\"name\":\"objects_freed\",\"cat\":\"gc\",\"ph\":\"C\""));
+  munit_assert_not_null(strstr(trace, "\"args\":{\"value\":1}"));
+  munit_assert_not_null(strstr(trace, "\"name\":\"gray_stack_peak\""));
+
+  return MUNIT_OK;
+}
+
+static MunitResult test_full_ring_drops(const MunitParameter params[],
+                                        void *user_data)
+{
+  char *path = trace_path();
+  gc_tracer_t *tracer = gc_tracer_new(path, 4);
+  munit_assert_not_null(tracer);
+
+  for (int i = 0; i < 6; i++)
+  {
+    gc_tracer_counter(tracer, "n", i);
+  }
+  munit_assert_uint64(gc_tracer_dropped(tracer), ==, 2);
+
+  // Flushing frees the ring up again
+  munit_assert_true(gc_tracer_flush(tracer));
+  gc_tracer_counter(tracer, "n", 6);
+  gc_tracer_free(tracer);
+  munit_assert_true(boot_all_freed());
+
+  char *trace = read_trace(path);
+  munit_assert_size(count_occurrences(trace, "\"name\":\"n\""), ==, 5);
+  munit_assert_not_null(strstr(trace, "\"args\":{\"value\":3}"));
+  munit_assert_null(strstr(trace, "\"args\":{\"value\":4}"));
+  munit_assert_not_null(strstr(trace, "\"args\":{\"value\":6}"));
+
+  return MUNIT_OK;
+}
+
+#define PRODUCERS 4
+#define EVENTS_PER_PRODUCER 2000
+
+static void *produce(void *tracer)
+{
+  for (int i = 0; i < EVENTS_PER_PRODUCER; i++)
+  {
+    gc_tracer_begin(tracer, "step");
+  }
+  return NULL;
+}
+
+static MunitResult test_concurrent_producers(const MunitParameter params[],
+                                             void *user_data)
+{
+  char *path = trace_path();
+  gc_tracer_t *tracer = gc_tracer_new(path, PRODUCERS * EVENTS_PER_PRODUCER);
+
+  pthread_t threads[PRODUCERS];
+  for (int i = 0; i < PRODUCERS; i++)
+  {
+    munit_assert_int(pthread_create(&threads[i], NULL, produce, tracer), ==,
+                     0);
+  }
+  for (int i = 0; i < PRODUCERS; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  munit_assert_uint64(gc_tracer_dropped(tracer), ==, 0);
+  gc_tracer_free(tracer);
+
+  FILE *file = fopen(path, "r");
+  munit_assert_not_null(file);
+  size_t events = 0;
+  char line[256];
+  while (fgets(line, sizeof(line), file) != NULL)
+  {
+    events += strstr(line, "\"name\":\"step\"") != NULL;
+  }
+  fclose(file);
+  unlink(path);
+  munit_assert_size(events, ==, PRODUCERS * EVENTS_PER_PRODUCER);
+
+  return MUNIT_OK;
+}
+
+static MunitTest gctrace_tests[] = {
+    {"/collect_events", test_collect_events, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/full_ring_drops", test_full_ring_drops, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/concurrent_producers", test_concurrent_producers, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+MunitSuite gctrace_suite = {"/gctrace", gctrace_tests, NULL, 1,
+                            MUNIT_SUITE_OPTION_NONE};
@@ -0,0 +1,176 @@
+#include "../munit/munit.h"
+#include "../src/bootmem.h"
+#include "../src/heapsample.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/vm.h"
+#include <string.h>
+#include "stdlib.h"
+
+static MunitResult test_survival(const MunitParameter params[],
+                                 void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+
+  // Every allocation is sampled with weight close to its size
+  heap_sample_start(1);
+  snek_object_t *kept = new_snek_integer(1, vm);
+  new_snek_integer(2, vm);
+  frame_reference_object(frame, kept);
+
+  heap_sample_stats_t stats;
+  heap_sample_stats(&stats);
+  munit_assert_uint64(stats.samples, ==, 2);
+  munit_assert_uint64(stats.live_samples, ==, 2);
+  munit_assert_double_equal(stats.allocated_bytes,
+                            2.0 * sizeof(snek_object_t), 3);
+
+  vm_collect_garbage(vm);
+  vm_collect_garbage(vm);
+  heap_sample_stop();
+
+  // The collector's own scratch space is sampled too and churns
+  heap_sample_stats(&stats);
+  munit_assert_uint64(stats.live_samples, ==, 1);
+  munit_assert_double_equal(stats.live_bytes, sizeof(snek_object_t), 3);
+  munit_assert_double_equal(stats.survived_bytes, sizeof(snek_object_t), 3);
+  munit_assert_double(stats.churned_bytes, >=, sizeof(snek_object_t));
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_survival_per_vm(const MunitParameter params[],
+                                        void *user_data)
+{
+  vm_t *vm = vm_new();
+  vm_t *other = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+
+  heap_sample_start(1);
+  frame_reference_object(frame, new_snek_integer(1, vm));
+
+  // Another VM's collections don't count for this one's objects
+  vm_collect_garbage(other);
+  vm_collect_garbage(other);
+  heap_sample_stats_t stats;
+  heap_sample_stats(&stats);
+  munit_assert_double_equal(stats.survived_bytes, 0.0, 3);
+
+  vm_collect_garbage(vm);
+  heap_sample_stop();
+  heap_sample_stats(&stats);
+  munit_assert_double_equal(stats.survived_bytes, sizeof(snek_object_t), 3);
+
+  vm_free(other);
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_stale_ids(const MunitParameter params[],
+                                  void *user_data)
+{
+  heap_sample_start(1);
+  void *stale = malloc(64);
+
+  // Same low byte of the session, and the same index
+  for (int i = 0; i < 256; i++)
+  {
+    heap_sample_start(1);
+  }
+  void *current = malloc(64);
+  free(stale);
+
+  heap_sample_stats_t stats;
+  heap_sample_stats(&stats);
+  munit_assert_uint64(stats.samples, ==, 1);
+  munit_assert_uint64(stats.live_samples, ==, 1);
+
+  free(current);
+  heap_sample_stop();
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_unbiased_estimate(const MunitParameter params[],
+                                          void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  const int count = 20000;
+  const size_t elements = 16;
+  // Rooted in a list sized up front, so nothing is resized while sampling:
+  // the sampler sees fresh allocations only, grown blocks aren't sampled
+  snek_object_t *list = new_snek_array(count, vm);
+  frame_reference_object(frame, list);
+
+  boot_mem_stats_t before, after;
+  heap_sample_seed(0x5eed);
+  boot_mem_stats(BOOT_CATEGORY_ALL, &before);
+  heap_sample_start(1024);
+  for (int i = 0; i < count; i++)
+  {
+    snek_array_set(list, i, new_snek_int_array(elements, vm));
+  }
+  heap_sample_stop();
+  boot_mem_stats(BOOT_CATEGORY_ALL, &after);
+  heap_sample_seed(0);
+
+  // About 2300 samples, so the estimate is within a few percent of every
+  // byte allocated meanwhile, registry segments included
+  double actual = (double)(after.allocated_bytes - before.allocated_bytes);
+  munit_assert_uint64(after.allocations - before.allocations, >=, 2 * count);
+  heap_sample_stats_t stats;
+  heap_sample_stats(&stats);
+  munit_assert_uint64(stats.samples, >, 1000);
+  munit_assert_uint64(stats.samples, <, 5000);
+  munit_assert_double(stats.allocated_bytes, >, actual * 0.95);
+  munit_assert_double(stats.allocated_bytes, <, actual * 1.05);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_report(const MunitParameter params[],
+                               void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  heap_sample_start(1);
+  frame_reference_object(frame, new_snek_string("sampled", vm));
+  vm_collect_garbage(vm);
+  heap_sample_stop();
+
+  FILE *out = tmpfile();
+  munit_assert_not_null(out);
+  heap_sample_report(out, 5);
+  rewind(out);
+  char text[8192];
+  size_t length = fread(text, 1, sizeof(text) - 1, out);
+  text[length] = '\0';
+  fclose(out);
+
+  munit_assert_not_null(strstr(text, "samples, 1 per 1 bytes"));
+  munit_assert_not_null(strstr(text, "100% survived a collection"));
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitTest heapsample_tests[] = {
+    {"/survival", test_survival, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/survival_per_vm", test_survival_per_vm, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/stale_ids", test_stale_ids, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/unbiased_estimate", test_unbiased_estimate, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/report", test_report, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+MunitSuite heapsample_suite = {"/heapsample", heapsample_tests, NULL, 1,
+                               MUNIT_SUITE_OPTION_NONE};
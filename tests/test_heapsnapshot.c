@@ -0,0 +1,196 @@
+#include "../munit/munit.h"
+#include "../src/bootmem.h"
+#include "../src/heapsnapshot.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/vm.h"
+#include <string.h>
+#include <unistd.h>
+#include "stdlib.h"
+
+static char *snapshot_path(void)
+{
+  static char path[] = "/tmp/snek_heap_XXXXXX";
+  strcpy(path, "/tmp/snek_heap_XXXXXX");
+  int fd = mkstemp(path);
+  munit_assert_int(fd, >=, 0);
+  close(fd);
+  return path;
+}
+
+static heap_snapshot_t *snapshot_vm(vm_t *vm)
+{
+  char *path = snapshot_path();
+  munit_assert_true(vm_heap_snapshot(vm, path));
+  heap_snapshot_t *snapshot = heap_snapshot_load(path);
+  unlink(path);
+  munit_assert_not_null(snapshot);
+  return snapshot;
+}
+
+static MunitResult test_round_trip(const MunitParameter params[],
+                                   void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *one = new_snek_integer(1, vm);
+  snek_object_t *two = new_snek_integer(2, vm);
+  snek_object_t *array = new_snek_array(3, vm);
+  snek_array_set(array, 0, one);
+  snek_array_set(array, 2, two);
+  snek_object_t *vector = new_snek_vector3(one, two, one, vm);
+  frame_reference_object(frame, array);
+  frame_reference_object(vm_new_frame(vm), vector);
+
+  heap_snapshot_t *snapshot = snapshot_vm(vm);
+  munit_assert_uint32(snapshot->node_count, ==, 4);
+  munit_assert_uint64(snapshot->edge_count, ==, 5);
+  munit_assert_uint64(snapshot->root_count, ==, 2);
+
+  munit_assert_uint8(snapshot->nodes[2].kind, ==, ARRAY);
+  munit_assert_uint32(snapshot->nodes[2].out_degree, ==, 2);
+  munit_assert_uint64(snapshot->nodes[2].self_size, ==,
+                      snek_object_size(array));
+  uint32_t *array_edges = snapshot->edges + snapshot->edge_offsets[2];
+  munit_assert_uint32(array_edges[0], ==, 0);
+  munit_assert_uint32(array_edges[1], ==, 1);
+
+  munit_assert_uint8(snapshot->nodes[3].kind, ==, VECTOR3);
+  munit_assert_uint32(snapshot->nodes[3].out_degree, ==, 3);
+  munit_assert_uint32(snapshot->roots[0].frame, ==, 0);
+  munit_assert_uint32(snapshot->roots[0].node, ==, 2);
+  munit_assert_uint32(snapshot->roots[1].frame, ==, 1);
+  munit_assert_uint32(snapshot->roots[1].node, ==, 3);
+
+  heap_snapshot_free(snapshot);
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+
+  return MUNIT_OK;
+}
+
+static MunitResult test_dominators(const MunitParameter params[],
+                                   void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+
+  // root -> holder -> {left, right} -> shared, and root -> {a, b} -> both
+  snek_object_t *shared = new_snek_integer(1, vm);
+  snek_object_t *left = new_snek_array(1, vm);
+  snek_object_t *right = new_snek_array(1, vm);
+  snek_array_set(left, 0, shared);
+  snek_array_set(right, 0, shared);
+  snek_object_t *holder = new_snek_array(2, vm);
+  snek_array_set(holder, 0, left);
+  snek_array_set(holder, 1, right);
+
+  snek_object_t *both = new_snek_integer(2, vm);
+  snek_object_t *a = new_snek_array(1, vm);
+  snek_object_t *b = new_snek_array(1, vm);
+  snek_array_set(a, 0, both);
+  snek_array_set(b, 0, both);
+  new_snek_integer(3, vm);
+
+  frame_reference_object(frame, holder);
+  frame_reference_object(frame, a);
+  frame_reference_object(frame, b);
+
+  heap_snapshot_t *snapshot = snapshot_vm(vm);
+  heap_dominators_t *dominators = heap_snapshot_dominators(snapshot);
+  munit_assert_not_null(dominators);
+
+  // Registry order: shared, left, right, holder, both, a, b, garbage
+  uint32_t *idom = dominators->idom;
+  munit_assert_uint32(dominators->reachable, ==, 7);
+  munit_assert_uint32(idom[0], ==, 3);
+  munit_assert_uint32(idom[1], ==, 3);
+  munit_assert_uint32(idom[2], ==, 3);
+  munit_assert_uint32(idom[3], ==, HEAP_SNAPSHOT_ROOT);
+  munit_assert_uint32(idom[4], ==, HEAP_SNAPSHOT_ROOT);
+  munit_assert_uint32(idom[5], ==, HEAP_SNAPSHOT_ROOT);
+  munit_assert_uint32(idom[7], ==, HEAP_SNAPSHOT_UNREACHABLE);
+
+  uint64_t *retained = dominators->retained;
+  heap_snapshot_node_t *nodes = snapshot->nodes;
+  munit_assert_uint64(retained[3], ==,
+                      nodes[0].self_size + nodes[1].self_size +
+                          nodes[2].self_size + nodes[3].self_size);
+  munit_assert_uint64(retained[1], ==, nodes[1].self_size);
+  munit_assert_uint64(retained[5], ==, nodes[5].self_size);
+  munit_assert_uint64(retained[7], ==, 0);
+
+  heap_dominators_free(dominators);
+  heap_snapshot_free(snapshot);
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+
+  return MUNIT_OK;
+}
+
+static MunitResult test_deep_chain(const MunitParameter params[],
+                                   void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+
+  // Deep enough to overflow a recursive DFS or path compression
+  const int depth = 200000;
+  snek_object_t *head = new_snek_integer(0, vm);
+  for (int i = 0; i < depth; i++)
+  {
+    snek_object_t *link = new_snek_array(1, vm);
+    snek_array_set(link, 0, head);
+    head = link;
+  }
+  frame_reference_object(frame, head);
+
+  heap_snapshot_t *snapshot = snapshot_vm(vm);
+  heap_dominators_t *dominators = heap_snapshot_dominators(snapshot);
+  munit_assert_not_null(dominators);
+  munit_assert_uint32(dominators->reachable, ==, depth + 1);
+  munit_assert_uint32(dominators->idom[depth], ==, HEAP_SNAPSHOT_ROOT);
+  munit_assert_uint32(dominators->idom[0], ==, 1);
+
+  uint64_t total = 0;
+  for (int i = 0; i <= depth; i++)
+  {
+    total += snapshot->nodes[i].self_size;
+  }
+  munit_assert_uint64(dominators->retained[depth], ==, total);
+
+  heap_dominators_free(dominators);
+  heap_snapshot_free(snapshot);
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+
+  return MUNIT_OK;
+}
+
+static MunitResult test_rejects_garbage(const MunitParameter params[],
+                                        void *user_data)
+{
+  char *path = snapshot_path();
+  FILE *file = fopen(path, "wb");
+  fputs("not a snapshot at all", file);
+  fclose(file);
+  munit_assert_null(heap_snapshot_load(path));
+  unlink(path);
+  munit_assert_true(boot_all_freed());
+
+  return MUNIT_OK;
+}
+
+static MunitTest heapsnapshot_tests[] = {
+    {"/round_trip", test_round_trip, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/dominators", test_dominators, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/deep_chain", test_deep_chain, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/rejects_garbage", test_rejects_garbage, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+MunitSuite heapsnapshot_suite = {"/heapsnapshot", heapsnapshot_tests, NULL, 1,
+                                 MUNIT_SUITE_OPTION_NONE};
@@ -0,0 +1,211 @@
+#include "../munit/munit.h"
+#include "../src/bootmem.h"
+#include "../src/heapverify.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/snekpvec.h"
+#include "../src/vm.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include "stdlib.h"
+
+// Takes `obj` out of the registry without touching what references it
+static void unregister(vm_t *vm, snek_object_t *obj)
+{
+  registry_remove(vm->objects, obj);
+}
+
+static MunitResult test_clean_heap(const MunitParameter params[],
+                                   void *user_data)
+{
+  vm_t *vm = vm_new();
+  vm_verify_heap_enable(vm, true);
+  frame_t *frame = vm_new_frame(vm);
+
+  snek_object_t *one = new_snek_integer(1, vm);
+  snek_object_t *array = new_snek_array(4, vm);
+  snek_array_set(array, 0, one);
+  snek_array_set(array, 3, new_snek_float(2.0f, vm));
+  snek_object_t *rope = new_snek_rope(new_snek_string("ab", vm),
+                                      new_snek_string("cd", vm), vm);
+  snek_object_t *pvec = snek_pvec_push(new_snek_pvec(vm), rope, vm);
+  frame_reference_object(frame, new_snek_slice(array, 1, 3, vm));
+  frame_reference_object(frame, new_snek_vector3(one, rope, pvec, vm));
+  new_snek_integer(3, vm);
+
+  // Aborts on failure
+  vm_collect_garbage(vm);
+
+  heap_verify_report_t report;
+  munit_assert_true(vm_verify_heap(vm, &report));
+  munit_assert_size(report.objects, ==, registry_count(vm->objects));
+  munit_assert_size(report.roots, ==, 2);
+  munit_assert_size(report.errors, ==, 0);
+  munit_assert_string_equal(report.first_error, "");
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_freed_reference(const MunitParameter params[],
+                                        void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *child = new_snek_integer(1, vm);
+  snek_object_t *array = new_snek_array(1, vm);
+  snek_array_set(array, 0, child);
+  frame_reference_object(frame, array);
+
+  unregister(vm, child);
+  snek_object_free(child);
+
+  heap_verify_report_t report;
+  munit_assert_false(vm_verify_heap(vm, &report));
+  munit_assert_size(report.errors, ==, 1);
+  munit_assert_not_null(strstr(report.first_error, "references freed"));
+
+  array->data.v_array.elements[0] = NULL;
+  munit_assert_true(vm_verify_heap(vm, NULL));
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_marks_and_roots(const MunitParameter params[],
+                                        void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *obj = new_snek_integer(1, vm);
+  snek_object_t outside = {0};
+  frame_reference_object(frame, obj);
+  frame_reference_object(frame, &outside);
+  obj->is_marked = true;
+  registry_add(vm->objects, obj);
+
+  heap_verify_report_t report;
+  munit_assert_false(vm_verify_heap(vm, &report));
+  // Registered twice, still marked in both slots and a root outside the
+  // heap
+  munit_assert_size(report.errors, ==, 4);
+  munit_assert_not_null(strstr(report.first_error, "registered twice"));
+
+  registry_remove(vm->objects, obj);
+  obj->is_marked = false;
+  frame->references->count--;
+  munit_assert_true(vm_verify_heap(vm, NULL));
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_parallel(const MunitParameter params[],
+                                 void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  size_t count = HEAP_VERIFY_PARALLEL_MIN * 2;
+  snek_object_t *previous = new_snek_integer(0, vm);
+  snek_object_t *middle = NULL;
+  for (size_t i = 1; i < count / 2; i++)
+  {
+    snek_object_t *link = new_snek_array(1, vm);
+    snek_array_set(link, 0, previous);
+    new_snek_integer((int)i, vm);
+    if (i == count / 4)
+    {
+      middle = previous;
+    }
+    previous = link;
+  }
+  frame_reference_object(frame, previous);
+
+  heap_verify_report_t report;
+  munit_assert_true(vm_verify_heap(vm, &report));
+  munit_assert_size(report.objects, ==, count - 1);
+  munit_assert_size(report.edges, ==, count / 2 - 1);
+
+  unregister(vm, middle);
+  munit_assert_false(vm_verify_heap(vm, &report));
+  munit_assert_size(report.errors, ==, 1);
+
+  registry_add(vm->objects, middle);
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+typedef struct BufferedThread
+{
+  vm_mutator_t *mutator;
+  atomic_bool ready;
+  atomic_bool done;
+} buffered_thread_t;
+
+static void *buffered_thread(void *arg)
+{
+  buffered_thread_t *thread = arg;
+  vm_mutator_attach(thread->mutator);
+  vm_t *vm = thread->mutator->vm;
+  frame_t *frame = vm_new_frame(vm);
+  for (int i = 0; i < 10; i++)
+  {
+    frame_reference_object(frame, new_snek_integer(i, vm));
+  }
+
+  // Rooted but only in this thread's buffer, parked until the check is done
+  vm_blocking_enter(vm);
+  atomic_store(&thread->ready, true);
+  while (!atomic_load(&thread->done))
+  {
+  }
+  vm_blocking_leave(vm);
+  vm_mutator_free(thread->mutator);
+  return NULL;
+}
+
+static MunitResult test_shared_vm(const MunitParameter params[],
+                                  void *user_data)
+{
+  vm_t *vm = vm_new();
+  buffered_thread_t thread = {.mutator = vm_mutator_new(vm)};
+  pthread_t handle;
+  pthread_create(&handle, NULL, buffered_thread, &thread);
+  while (!atomic_load(&thread.ready))
+  {
+  }
+
+  heap_verify_report_t report;
+  munit_assert_true(vm_verify_heap(vm, &report));
+  munit_assert_size(report.objects, ==, 10);
+  munit_assert_size(report.roots, ==, 10);
+  gc_stats_t stats;
+  vm_gc_stats(vm, &stats);
+  munit_assert_uint64(stats.heap_objects, ==, 10);
+
+  atomic_store(&thread.done, true);
+  vm_blocking_enter(vm);
+  pthread_join(handle, NULL);
+  vm_blocking_leave(vm);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitTest heapverify_tests[] = {
+    {"/clean_heap", test_clean_heap, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/freed_reference", test_freed_reference, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/marks_and_roots", test_marks_and_roots, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/parallel", test_parallel, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/shared_vm", test_shared_vm, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+MunitSuite heapverify_suite = {"/heapverify", heapverify_tests, NULL, 1,
+                               MUNIT_SUITE_OPTION_NONE};
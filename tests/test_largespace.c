@@ -0,0 +1,121 @@
+#include "../munit/munit.h"
+#include "../src/bootmem.h"
+#include "../src/largespace.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/vm.h"
+#include <string.h>
+#include "stdlib.h"
+
+#define LARGE_INTS (SNEK_LARGE_OBJECT_THRESHOLD / sizeof(int32_t))
+
+static MunitResult test_map_remap(const MunitParameter params[],
+                                  void *user_data)
+{
+  large_space_stats_t before;
+  large_space_stats(&before);
+
+  unsigned char *block = large_space_map(100000);
+  munit_assert_not_null(block);
+  munit_assert_size((uintptr_t)block % 16, ==, 0);
+  for (size_t i = 0; i < 100000; i++)
+  {
+    munit_assert_uint8(block[i], ==, 0);
+  }
+  memset(block, 7, 100000);
+
+  large_space_stats_t stats;
+  large_space_stats(&stats);
+  munit_assert_size(stats.regions, ==, before.regions + 1);
+  munit_assert_size(stats.mapped_bytes, >=, before.mapped_bytes + 100000);
+
+  block = large_space_remap(block, 1000000);
+  munit_assert_not_null(block);
+  munit_assert_uint8(block[0], ==, 7);
+  munit_assert_uint8(block[99999], ==, 7);
+  large_space_stats(&stats);
+  munit_assert_size(stats.regions, ==, before.regions + 1);
+  munit_assert_size(stats.mapped_bytes, >=, before.mapped_bytes + 1000000);
+
+  large_space_unmap(block);
+  large_space_stats(&stats);
+  munit_assert_size(stats.regions, ==, before.regions);
+  munit_assert_size(stats.mapped_bytes, ==, before.mapped_bytes);
+  munit_assert_uint64(stats.unmaps, ==, before.unmaps + 1);
+  return MUNIT_OK;
+}
+
+static MunitResult test_payload_routing(const MunitParameter params[],
+                                        void *user_data)
+{
+  large_space_stats_t before;
+  large_space_stats(&before);
+
+  // Payloads over the threshold are mapped, headers and small ones aren't
+  char *small = malloc_as(BOOT_CATEGORY_STRING, 64);
+  char *other = malloc(SNEK_LARGE_OBJECT_THRESHOLD);
+  char *chars = malloc_as(BOOT_CATEGORY_STRING, SNEK_LARGE_OBJECT_THRESHOLD);
+  large_space_stats_t stats;
+  large_space_stats(&stats);
+  munit_assert_size(stats.regions, ==, before.regions + 1);
+
+  // Still accounted like any other block
+  boot_mem_stats_t strings;
+  boot_mem_stats(BOOT_CATEGORY_STRING, &strings);
+  munit_assert_size(strings.current_bytes, >=,
+                    SNEK_LARGE_OBJECT_THRESHOLD + 64);
+
+  chars = realloc(chars, 2 * SNEK_LARGE_OBJECT_THRESHOLD);
+  munit_assert_not_null(chars);
+  chars[2 * SNEK_LARGE_OBJECT_THRESHOLD - 1] = 'x';
+  free(chars);
+  free(other);
+  free(small);
+  large_space_stats(&stats);
+  munit_assert_size(stats.regions, ==, before.regions);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_swept_objects(const MunitParameter params[],
+                                      void *user_data)
+{
+  large_space_stats_t before;
+  large_space_stats(&before);
+
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *kept = new_snek_int_array(LARGE_INTS, vm);
+  frame_reference_object(frame, kept);
+  new_snek_float_array(LARGE_INTS, vm);
+  new_snek_array(SNEK_LARGE_OBJECT_THRESHOLD / sizeof(void *), vm);
+  new_snek_int_array(16, vm);
+
+  large_space_stats_t stats;
+  large_space_stats(&stats);
+  munit_assert_size(stats.regions, ==, before.regions + 3);
+  munit_assert_int32(kept->data.v_int_array.elements[LARGE_INTS - 1], ==, 0);
+
+  // The sweep unmaps what it frees right away
+  vm_collect_garbage(vm);
+  large_space_stats(&stats);
+  munit_assert_size(stats.regions, ==, before.regions + 1);
+  munit_assert_uint64(stats.unmaps, ==, before.unmaps + 2);
+
+  vm_free(vm);
+  large_space_stats(&stats);
+  munit_assert_size(stats.regions, ==, before.regions);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitTest largespace_tests[] = {
+    {"/map_remap", test_map_remap, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/payload_routing", test_payload_routing, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/swept_objects", test_swept_objects, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+MunitSuite largespace_suite = {"/largespace", largespace_tests, NULL, 1,
+                               MUNIT_SUITE_OPTION_NONE};
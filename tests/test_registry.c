@@ -0,0 +1,238 @@
+#include "../munit/munit.h"
+#include "../src/bootmem.h"
+#include "../src/registry.h"
+#include <pthread.h>
+#include <stdint.h>
+#include "stdlib.h"
+
+#define APPEND_THREADS 4
+#define APPEND_PER_THREAD 20000
+#define APPEND_BATCH 7
+
+// The registry never dereferences its entries, so ids stand in for objects
+static snek_object_t *fake(size_t id)
+{
+  return (snek_object_t *)(uintptr_t)((id + 1) * 16);
+}
+
+static size_t fake_id(snek_object_t *obj)
+{
+  return (uintptr_t)obj / 16 - 1;
+}
+
+static size_t segment_count(registry_t *registry)
+{
+  size_t count = 0;
+  for (registry_segment_t *segment = registry->head; segment != NULL;
+       segment = atomic_load(&segment->next))
+  {
+    count++;
+  }
+  return count;
+}
+
+static MunitResult test_append_segments(const MunitParameter params[],
+                                        void *user_data)
+{
+  registry_t *registry = registry_new();
+  size_t total = 3 * REGISTRY_SEGMENT_SLOTS + 5;
+  snek_object_t *batch[100];
+  size_t id = 0;
+  while (id < total)
+  {
+    // Batches straddle segment boundaries
+    size_t n = total - id < 100 ? total - id : 100;
+    for (size_t i = 0; i < n; i++)
+    {
+      batch[i] = fake(id + i);
+    }
+    if (n == 1)
+    {
+      registry_add(registry, batch[0]);
+    }
+    else
+    {
+      registry_add_many(registry, batch, n);
+    }
+    id += n;
+  }
+
+  munit_assert_size(registry_count(registry), ==, total);
+  munit_assert_size(segment_count(registry), ==, 4);
+  registry_cursor_t cursor = registry_begin(registry);
+  snek_object_t *obj;
+  size_t expected = 0;
+  while ((obj = registry_next(&cursor)) != NULL)
+  {
+    munit_assert_size(fake_id(obj), ==, expected++);
+  }
+  munit_assert_size(expected, ==, total);
+  munit_assert_ptr_equal(registry_get(registry, total - 1), fake(total - 1));
+  munit_assert_null(registry_get(registry, total));
+
+  registry_free(registry);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_remove_compact(const MunitParameter params[],
+                                       void *user_data)
+{
+  registry_t *registry = registry_new();
+  size_t total = 2 * REGISTRY_SEGMENT_SLOTS + 10;
+  for (size_t i = 0; i < total; i++)
+  {
+    registry_add(registry, fake(i));
+  }
+
+  registry_cursor_t cursor = registry_begin(registry);
+  snek_object_t *obj;
+  while ((obj = registry_next(&cursor)) != NULL)
+  {
+    if (fake_id(obj) % 2 == 1)
+    {
+      registry_remove_current(registry, &cursor);
+    }
+  }
+  munit_assert_size(registry_count(registry), ==, total / 2);
+  munit_assert_true(registry_remove(registry, fake(0)));
+  munit_assert_false(registry_remove(registry, fake(1)));
+
+  registry_compact(registry, true);
+  munit_assert_size(segment_count(registry), ==, 2);
+  munit_assert_ptr_equal(atomic_load(&registry->tail),
+                         atomic_load(&registry->head->next));
+  munit_assert_ptr_equal(registry_get(registry, 0), fake(2));
+
+  // Appends continue right after the packed entries
+  registry_add(registry, fake(total));
+  size_t count = registry_count(registry);
+  munit_assert_size(count, ==, total / 2);
+  munit_assert_ptr_equal(registry_get(registry, count - 1), fake(total));
+
+  // The even ids from 2, then the appended one
+  size_t expected = 2;
+  cursor = registry_begin(registry);
+  while ((obj = registry_next(&cursor)) != NULL)
+  {
+    munit_assert_size(fake_id(obj), ==, expected);
+    expected += 2;
+  }
+  munit_assert_size(expected, ==, total + 2);
+
+  // Emptying it keeps the head segment
+  cursor = registry_begin(registry);
+  while ((obj = registry_next(&cursor)) != NULL)
+  {
+    registry_remove_current(registry, &cursor);
+  }
+  registry_compact(registry, true);
+  munit_assert_size(registry_count(registry), ==, 0);
+  munit_assert_size(segment_count(registry), ==, 1);
+  munit_assert_null(registry_get(registry, 0));
+
+  registry_free(registry);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+typedef struct Appender
+{
+  registry_t *registry;
+  size_t first;
+} appender_t;
+
+static void *append_thread(void *arg)
+{
+  appender_t *appender = arg;
+  snek_object_t *batch[APPEND_BATCH];
+  size_t id = appender->first;
+  size_t end = appender->first + APPEND_PER_THREAD;
+  while (id < end)
+  {
+    size_t n = end - id < APPEND_BATCH ? end - id : APPEND_BATCH;
+    for (size_t i = 0; i < n; i++)
+    {
+      batch[i] = fake(id + i);
+    }
+    registry_add_many(appender->registry, batch, n);
+    id += n;
+  }
+  return NULL;
+}
+
+// Removes every third id, as a sweep would
+static void remove_thirds(registry_t *registry)
+{
+  registry_cursor_t cursor = registry_begin(registry);
+  snek_object_t *obj;
+  while ((obj = registry_next(&cursor)) != NULL)
+  {
+    if (fake_id(obj) % 3 == 0)
+    {
+      registry_remove_current(registry, &cursor);
+    }
+  }
+}
+
+static MunitResult test_concurrent(const MunitParameter params[],
+                                   void *user_data)
+{
+  registry_t *registry = registry_new();
+  pthread_t threads[APPEND_THREADS];
+  appender_t appenders[APPEND_THREADS];
+  for (size_t i = 0; i < APPEND_THREADS; i++)
+  {
+    appenders[i] = (appender_t){registry, i * APPEND_PER_THREAD};
+    pthread_create(&threads[i], NULL, append_thread, &appenders[i]);
+  }
+
+  // Sweeps and packs the finished segments while appends go on
+  for (int round = 0; round < 50; round++)
+  {
+    remove_thirds(registry);
+    registry_compact(registry, false);
+  }
+  for (size_t i = 0; i < APPEND_THREADS; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  remove_thirds(registry);
+  registry_compact(registry, false);
+  registry_compact(registry, true);
+
+  size_t total = APPEND_THREADS * APPEND_PER_THREAD;
+  size_t kept = total - (total + 2) / 3;
+  munit_assert_size(registry_count(registry), ==, kept);
+  unsigned char *seen = calloc(total, 1);
+  registry_cursor_t cursor = registry_begin(registry);
+  snek_object_t *obj;
+  size_t walked = 0;
+  while ((obj = registry_next(&cursor)) != NULL)
+  {
+    size_t id = fake_id(obj);
+    munit_assert_size(id, <, total);
+    munit_assert_size(id % 3, !=, 0);
+    munit_assert_false(seen[id]);
+    seen[id] = 1;
+    walked++;
+  }
+  munit_assert_size(walked, ==, kept);
+  free(seen);
+
+  registry_free(registry);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitTest registry_tests[] = {
+    {"/append_segments", test_append_segments, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/remove_compact", test_remove_compact, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/concurrent", test_concurrent, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+MunitSuite registry_suite = {"/registry", registry_tests, NULL, 1,
+                             MUNIT_SUITE_OPTION_NONE};
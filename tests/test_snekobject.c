@@ -1,16 +1,20 @@
 #include "../munit/munit.h"
 #include "../src/bootmem.h"
+#include "../src/sneknew.h"
 #include "../src/snekobject.h"
+#include "../src/vm.h"
 #include "stdlib.h"
+#include <string.h>
 
 // Test Integer --------------------------------
 
 static MunitResult test_integer_positive(const MunitParameter params[],
                                          void *user_data)
 {
-  snek_object_t *obj = new_snek_integer(42);
+  vm_t *vm = vm_new();
+  snek_object_t *obj = new_snek_integer(42, vm);
   munit_assert_int(obj->data.v_int, ==, 42);
-  free(obj);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -18,10 +22,11 @@ static MunitResult test_integer_positive(const MunitParameter params[],
 static MunitResult test_integer_zero(const MunitParameter params[],
                                      void *user_data)
 {
-  snek_object_t *obj = new_snek_integer(0);
+  vm_t *vm = vm_new();
+  snek_object_t *obj = new_snek_integer(0, vm);
   munit_assert_int(obj->kind, ==, INTEGER);
   munit_assert_int(obj->data.v_int, ==, 0);
-  free(obj);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -29,11 +34,12 @@ static MunitResult test_integer_zero(const MunitParameter params[],
 static MunitResult test_integer_negative(const MunitParameter params[],
                                          void *user_data)
 {
-  snek_object_t *obj = new_snek_integer(-5);
+  vm_t *vm = vm_new();
+  snek_object_t *obj = new_snek_integer(-5, vm);
 
   munit_assert_int(obj->kind, ==, INTEGER);
   munit_assert_int(obj->data.v_int, ==, -5);
-  free(obj);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -43,10 +49,11 @@ static MunitResult test_integer_negative(const MunitParameter params[],
 static MunitResult test_float_positive(const MunitParameter params[],
                                        void *user_data)
 {
-  snek_object_t *obj = new_snek_float(42.0);
+  vm_t *vm = vm_new();
+  snek_object_t *obj = new_snek_float(42.0, vm);
 
   munit_assert_float(obj->data.v_float, ==, 42.0);
-  free(obj);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -54,11 +61,12 @@ static MunitResult test_float_positive(const MunitParameter params[],
 static MunitResult test_float_zero(const MunitParameter params[],
                                    void *user_data)
 {
-  snek_object_t *obj = new_snek_float(0.0);
+  vm_t *vm = vm_new();
+  snek_object_t *obj = new_snek_float(0.0, vm);
 
   munit_assert_float(obj->kind, ==, FLOAT);
   munit_assert_float(obj->data.v_float, ==, 0.0);
-  free(obj);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
 
   return MUNIT_OK;
@@ -67,10 +75,11 @@ static MunitResult test_float_zero(const MunitParameter params[],
 static MunitResult test_float_negative(const MunitParameter params[],
                                        void *user_data)
 {
-  snek_object_t *obj = new_snek_float(-5.0);
+  vm_t *vm = vm_new();
+  snek_object_t *obj = new_snek_float(-5.0, vm);
 
   munit_assert_float(obj->data.v_float, ==, -5.0);
-  free(obj);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -80,30 +89,76 @@ static MunitResult test_float_negative(const MunitParameter params[],
 static MunitResult test_str_copied(const MunitParameter params[],
                                    void *user_data)
 {
+  vm_t *vm = vm_new();
   char *input = "Hello World!";
-  snek_object_t *obj = new_snek_string(input);
+  snek_object_t *obj = new_snek_string(input, vm);
 
   munit_assert_int(obj->kind, ==, STRING);
 
-  munit_assert_ptr_not_equal(obj->data.v_string, input);
-  munit_assert_string_equal(obj->data.v_string, input);
+  munit_assert_ptr_not_equal(obj->data.v_string.chars, input);
+  munit_assert_string_equal(obj->data.v_string.chars, input);
+  munit_assert_int(snek_length(obj), ==, 12);
   // munit_assert_int_equal(boot_alloc_size(), 22);     TODO: FIX THIS
 
-  free(obj->data.v_string);
-  free(obj);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
 
   return MUNIT_OK;
 }
 
+static MunitResult test_str_binary(const MunitParameter params[],
+                                   void *user_data)
+{
+  vm_t *vm = vm_new();
+  char payload[] = {'a', '\0', 'b', '\0'};
+  snek_object_t *obj = new_snek_string_len(payload, sizeof(payload), vm);
+
+  munit_assert_int(snek_length(obj), ==, 4);
+  munit_assert_memory_equal(4, snek_string_chars(obj), payload);
+
+  snek_object_t *twice = snek_add(obj, obj, vm);
+  munit_assert_int(snek_length(twice), ==, 8);
+  munit_assert_memory_equal(4, snek_string_chars(twice) + 4, payload);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_str_hash_equal(const MunitParameter params[],
+                                       void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *whole = new_snek_string("Hello World!", vm);
+  snek_object_t *joined = snek_add(new_snek_string("Hello ", vm),
+                                   new_snek_string("World!", vm), vm);
+  snek_object_t *other = new_snek_string("Hello World?", vm);
+
+  munit_assert_uint64(whole->data.v_string.hash, ==, 0);
+  munit_assert_uint64(snek_string_hash(whole), ==, snek_string_hash(joined));
+  munit_assert_uint64(whole->data.v_string.hash, !=, 0);
+  munit_assert_true(snek_string_equal(whole, joined));
+  munit_assert_false(snek_string_equal(whole, other));
+
+  char a[] = {'x', '\0', 'y'};
+  char b[] = {'x', '\0', 'z'};
+  munit_assert_false(snek_string_equal(new_snek_string_len(a, 3, vm),
+                                       new_snek_string_len(b, 3, vm)));
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
 // Test Vector3 -------------------------------
 
 static MunitResult test_returns_null(const MunitParameter params[],
                                      void *user_data)
 {
-  snek_object_t *vec = new_snek_vector3(NULL, NULL, NULL);
+  vm_t *vm = vm_new();
+  snek_object_t *vec = new_snek_vector3(NULL, NULL, NULL, vm);
   munit_assert_null(vec);
-  free(vec);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -111,10 +166,11 @@ static MunitResult test_returns_null(const MunitParameter params[],
 static MunitResult test_vec_multiple_objects(const MunitParameter params[],
                                              void *user_data)
 {
-  snek_object_t *x = new_snek_integer(1);
-  snek_object_t *y = new_snek_integer(2);
-  snek_object_t *z = new_snek_integer(3);
-  snek_object_t *vec = new_snek_vector3(x, y, z);
+  vm_t *vm = vm_new();
+  snek_object_t *x = new_snek_integer(1, vm);
+  snek_object_t *y = new_snek_integer(2, vm);
+  snek_object_t *z = new_snek_integer(3, vm);
+  snek_object_t *vec = new_snek_vector3(x, y, z, vm);
 
   munit_assert_ptr_not_null(vec);
 
@@ -127,10 +183,7 @@ static MunitResult test_vec_multiple_objects(const MunitParameter params[],
   munit_assert_int(vec->data.v_vector3.y->data.v_int, ==, 2);
   munit_assert_int(vec->data.v_vector3.z->data.v_int, ==, 3);
 
-  free(x);
-  free(y);
-  free(z);
-  free(vec);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
 
   return MUNIT_OK;
@@ -139,8 +192,9 @@ static MunitResult test_vec_multiple_objects(const MunitParameter params[],
 static MunitResult test_vec_same_object(const MunitParameter params[],
                                         void *user_data)
 {
-  snek_object_t *i = new_snek_integer(1);
-  snek_object_t *vec = new_snek_vector3(i, i, i);
+  vm_t *vm = vm_new();
+  snek_object_t *i = new_snek_integer(1, vm);
+  snek_object_t *vec = new_snek_vector3(i, i, i, vm);
 
   munit_assert_ptr(i, ==, vec->data.v_vector3.x);
   munit_assert_ptr(i, ==, vec->data.v_vector3.y);
@@ -156,24 +210,59 @@ static MunitResult test_vec_same_object(const MunitParameter params[],
   munit_assert_int(vec->data.v_vector3.z->data.v_int, ==, 2);
   munit_assert_int(vec->data.v_vector3.x->data.v_int, ==, 2);
 
-  free(i);
-  free(vec);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
 
   return MUNIT_OK;
 }
 
+static MunitResult test_float_vec_inline(const MunitParameter params[],
+                                         void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *vec = new_snek_float_vector3(1.0, 2.0, 3.0, vm);
+
+  munit_assert_int(vec->kind, ==, FLOAT_VECTOR3);
+  munit_assert_int(snek_length(vec), ==, 3);
+  munit_assert_size(sizeof(snek_float_vector3_t), ==, 16);
+  munit_assert_float(vec->data.v_float_vector3.x, ==, 1.0);
+  munit_assert_float(vec->data.v_float_vector3.y, ==, 2.0);
+  munit_assert_float(vec->data.v_float_vector3.z, ==, 3.0);
+
+  // One allocation for the object, no component objects
+  munit_assert_int(registry_count(vm->objects), ==, 1);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
 // Test Array -----------------------------------
 
 static MunitResult test_create_empty_array(const MunitParameter params[],
                                            void *user_data)
 {
-  snek_object_t *obj = new_snek_array(3);
+  vm_t *vm = vm_new();
+  snek_object_t *obj = new_snek_array(3, vm);
   munit_assert_int(obj->kind, ==, ARRAY);
   munit_assert_int(obj->data.v_array.size, ==, 3);
 
-  free(obj->data.v_array.elements);
-  free(obj);
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_array_out_of_memory(const MunitParameter params[],
+                                            void *user_data)
+{
+  vm_t *vm = vm_new();
+
+  // The buffer can't be allocated, nothing is left registered
+  munit_assert_null(new_snek_array(SIZE_MAX / 16, vm));
+  munit_assert_int(registry_count(vm->objects), ==, 0);
+  vm_collect_garbage(vm);
+
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -181,13 +270,13 @@ static MunitResult test_create_empty_array(const MunitParameter params[],
 static MunitResult test_used_calloc(const MunitParameter params[],
                                     void *user_data)
 {
-  snek_object_t *obj = new_snek_array(2);
+  vm_t *vm = vm_new();
+  snek_object_t *obj = new_snek_array(2, vm);
 
   munit_assert_ptr_null(obj->data.v_array.elements[0]);
   munit_assert_ptr_null(obj->data.v_array.elements[1]);
 
-  free(obj->data.v_array.elements);
-  free(obj);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -195,18 +284,16 @@ static MunitResult test_used_calloc(const MunitParameter params[],
 static MunitResult test_set_outside_bounds(const MunitParameter params[],
                                            void *user_data)
 {
-  snek_object_t *obj = new_snek_array(2);
+  vm_t *vm = vm_new();
+  snek_object_t *obj = new_snek_array(2, vm);
 
-  snek_object_t *outside = new_snek_string("First");
+  snek_object_t *outside = new_snek_string("First", vm);
 
   munit_assert_true(snek_array_set(obj, 1, outside));
 
   munit_assert_false(snek_array_set(obj, 100, outside));
 
-  free(outside->data.v_string);
-  free(outside);
-  free(obj->data.v_array.elements);
-  free(obj);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -214,16 +301,83 @@ static MunitResult test_set_outside_bounds(const MunitParameter params[],
 static MunitResult test_get_outside_bounds(const MunitParameter params[],
                                            void *user_data)
 {
-  snek_object_t *obj = new_snek_array(1);
-  snek_object_t *first = new_snek_string("First");
+  vm_t *vm = vm_new();
+  snek_object_t *obj = new_snek_array(1, vm);
+  snek_object_t *first = new_snek_string("First", vm);
   munit_assert_true(snek_array_set(obj, 0, first));
 
   munit_assert_null(snek_array_get(obj, 1));
 
-  free(first->data.v_string);
-  free(first);
-  free(obj->data.v_array.elements);
-  free(obj);
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+// Test Slice -----------------------------------
+
+static MunitResult test_slice_view(const MunitParameter params[],
+                                   void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *arr = new_snek_array(5, vm);
+  for (int i = 0; i < 5; i++)
+  {
+    snek_array_set(arr, i, new_snek_integer(i, vm));
+  }
+
+  snek_object_t *slice = new_snek_slice(arr, 1, 3, vm);
+  munit_assert_int(slice->kind, ==, SLICE);
+  munit_assert_int(snek_length(slice), ==, 3);
+  munit_assert_int(snek_array_get(slice, 0)->data.v_int, ==, 1);
+  munit_assert_int(snek_array_get(slice, 2)->data.v_int, ==, 3);
+  munit_assert_null(snek_array_get(slice, 3));
+
+  // Writes go through to the parent
+  snek_object_t *forty_two = new_snek_integer(42, vm);
+  munit_assert_true(snek_array_set(slice, 1, forty_two));
+  munit_assert_ptr_equal(snek_array_get(arr, 2), forty_two);
+  munit_assert_false(snek_array_set(slice, 3, forty_two));
+
+  // Slices of slices view the underlying array directly
+  snek_object_t *inner = new_snek_slice(slice, 1, 2, vm);
+  munit_assert_ptr_equal(inner->data.v_slice.parent, arr);
+  munit_assert_size(inner->data.v_slice.offset, ==, 2);
+  munit_assert_ptr_equal(snek_array_get(inner, 0), forty_two);
+
+  munit_assert_null(new_snek_slice(arr, 4, 2, vm));
+  munit_assert_null(new_snek_slice(slice, 0, 4, vm));
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+// Test Typed Arrays ----------------------------
+
+static MunitResult test_create_int_array(const MunitParameter params[],
+                                         void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *obj = new_snek_int_array(4, vm);
+  munit_assert_int(obj->kind, ==, INT_ARRAY);
+  munit_assert_int(snek_length(obj), ==, 4);
+  munit_assert_int(obj->data.v_int_array.elements[3], ==, 0);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_create_float_array(const MunitParameter params[],
+                                           void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *obj = new_snek_float_array(5, vm);
+  munit_assert_int(obj->kind, ==, FLOAT_ARRAY);
+  munit_assert_int(snek_length(obj), ==, 5);
+  munit_assert_float(obj->data.v_float_array.elements[4], ==, 0.0);
+
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -233,17 +387,16 @@ static MunitResult test_get_outside_bounds(const MunitParameter params[],
 static MunitResult test_integer_add(const MunitParameter params[],
                                     void *user_data)
 {
-  snek_object_t *one = new_snek_integer(1);
-  snek_object_t *three = new_snek_integer(3);
-  snek_object_t *four = snek_add(one, three);
+  vm_t *vm = vm_new();
+  snek_object_t *one = new_snek_integer(1, vm);
+  snek_object_t *three = new_snek_integer(3, vm);
+  snek_object_t *four = snek_add(one, three, vm);
 
   munit_assert_not_null(four);
   munit_assert_int(four->kind, ==, INTEGER);
   munit_assert_int(four->data.v_int, ==, 4);
 
-  free(one);
-  free(three);
-  free(four);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -251,17 +404,16 @@ static MunitResult test_integer_add(const MunitParameter params[],
 static MunitResult test_float_add(const MunitParameter params[],
                                   void *user_data)
 {
-  snek_object_t *one = new_snek_float(1.5);
-  snek_object_t *three = new_snek_float(3.5);
-  snek_object_t *five = snek_add(one, three);
+  vm_t *vm = vm_new();
+  snek_object_t *one = new_snek_float(1.5, vm);
+  snek_object_t *three = new_snek_float(3.5, vm);
+  snek_object_t *five = snek_add(one, three, vm);
 
   munit_assert_not_null(five);
   munit_assert_int(five->kind, ==, FLOAT);
   munit_assert_float(five->data.v_float, ==, 5.0);
 
-  free(one);
-  free(three);
-  free(five);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -269,20 +421,16 @@ static MunitResult test_float_add(const MunitParameter params[],
 static MunitResult test_string_add(const MunitParameter params[],
                                    void *user_data)
 {
-  snek_object_t *hello = new_snek_string("Hello ");
-  snek_object_t *world = new_snek_string("World!");
-  snek_object_t *greeting = snek_add(hello, world);
+  vm_t *vm = vm_new();
+  snek_object_t *hello = new_snek_string("Hello ", vm);
+  snek_object_t *world = new_snek_string("World!", vm);
+  snek_object_t *greeting = snek_add(hello, world, vm);
 
   munit_assert_not_null(greeting);
   munit_assert_int(greeting->kind, ==, STRING);
-  munit_assert_string_equal(greeting->data.v_string, "Hello World!");
+  munit_assert_string_equal(snek_string_chars(greeting), "Hello World!");
 
-  free(hello->data.v_string);
-  free(hello);
-  free(world->data.v_string);
-  free(world);
-  free(greeting->data.v_string);
-  free(greeting);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -290,17 +438,97 @@ static MunitResult test_string_add(const MunitParameter params[],
 static MunitResult test_string_add_self(const MunitParameter params[],
                                         void *user_data)
 {
-  snek_object_t *repeated = new_snek_string("(repeated)");
-  snek_object_t *result = snek_add(repeated, repeated);
+  vm_t *vm = vm_new();
+  snek_object_t *repeated = new_snek_string("(repeated)", vm);
+  snek_object_t *result = snek_add(repeated, repeated, vm);
 
   munit_assert_not_null(result);
   munit_assert_int(result->kind, ==, STRING);
-  munit_assert_string_equal(result->data.v_string, "(repeated)(repeated)");
+  munit_assert_string_equal(snek_string_chars(result), "(repeated)(repeated)");
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_string_add_rope_appends(const MunitParameter params[],
+                                                void *user_data)
+{
+  vm_t *vm = vm_new();
+  char chunk[80];
+  memset(chunk, 'x', sizeof(chunk) - 1);
+  chunk[sizeof(chunk) - 1] = '\0';
+  snek_object_t *piece = new_snek_string(chunk, vm);
+  snek_object_t *rope = new_snek_string("", vm);
+
+  // Each append copies one path of a balanced tree, never the whole rope
+  int rounds = 4096;
+  for (int i = 0; i < rounds; i++)
+  {
+    rope = snek_add(rope, piece, vm);
+    munit_assert_not_null(rope);
+  }
+  munit_assert_size(snek_string_depth(rope), <=, 18);
+  munit_assert_size(registry_count(vm->objects), <, 24 * rounds);
+  munit_assert_int(snek_length(rope), ==, 79 * rounds);
+
+  // Pieces added at either end keep their order
+  snek_object_t *both = new_snek_string("", vm);
+  for (int i = 0; i < 200; i++)
+  {
+    chunk[0] = (char)('a' + i % 26);
+    snek_object_t *next = new_snek_string(chunk, vm);
+    both = i % 2 == 0 ? snek_add(both, next, vm) : snek_add(next, both, vm);
+    munit_assert_not_null(both);
+  }
+  munit_assert_size(snek_string_depth(both), <=, 12);
+  const char *flat = snek_string_chars(both);
+  for (int i = 0; i < 200; i++)
+  {
+    // Odd pieces were prepended, last first, then the even ones in order
+    int piece_index = i < 100 ? 199 - 2 * i : 2 * (i - 100);
+    munit_assert_char(flat[79 * i], ==, (char)('a' + piece_index % 26));
+  }
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
 
-  free(repeated->data.v_string);
-  free(repeated);
-  free(result->data.v_string);
-  free(result);
+static MunitResult test_string_add_rope(const MunitParameter params[],
+                                        void *user_data)
+{
+  vm_t *vm = vm_new();
+  char chunk[41] = "0123456789abcdefghijklmnopqrstuvwxyzABCD";
+  snek_object_t *piece = new_snek_string(chunk, vm);
+  snek_object_t *rope = new_snek_string("", vm);
+
+  int rounds = 1000;
+  for (int i = 0; i < rounds; i++)
+  {
+    rope = snek_add(rope, piece, vm);
+    munit_assert_not_null(rope);
+  }
+
+  // Concatenation builds nodes, depth stays bounded by rebalancing
+  munit_assert_int(snek_length(rope), ==, 40 * rounds);
+  munit_assert_null(rope->data.v_string.chars);
+  munit_assert_size(snek_string_depth(rope), <=, 48);
+
+  const char *flat = snek_string_chars(rope);
+  munit_assert_not_null(flat);
+  munit_assert_size(strlen(flat), ==, 40 * rounds);
+  for (int i = 0; i < rounds; i++)
+  {
+    munit_assert_memory_equal(40, flat + 40 * i, chunk);
+  }
+
+  // Flattening happens once, in place
+  munit_assert_ptr_equal(snek_string_chars(rope), flat);
+  munit_assert_null(rope->data.v_string.rope);
+  munit_assert_size(snek_string_depth(rope), ==, 0);
+
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -308,16 +536,17 @@ static MunitResult test_string_add_self(const MunitParameter params[],
 static MunitResult test_vector3_add(const MunitParameter params[],
                                     void *user_data)
 {
-  snek_object_t *one = new_snek_float(1.0);
-  snek_object_t *two = new_snek_float(2.0);
-  snek_object_t *three = new_snek_float(3.0);
-  snek_object_t *four = new_snek_float(4.0);
-  snek_object_t *five = new_snek_float(5.0);
-  snek_object_t *six = new_snek_float(6.0);
-
-  snek_object_t *vec1 = new_snek_vector3(one, two, three);
-  snek_object_t *vec2 = new_snek_vector3(four, five, six);
-  snek_object_t *result = snek_add(vec1, vec2);
+  vm_t *vm = vm_new();
+  snek_object_t *one = new_snek_float(1.0, vm);
+  snek_object_t *two = new_snek_float(2.0, vm);
+  snek_object_t *three = new_snek_float(3.0, vm);
+  snek_object_t *four = new_snek_float(4.0, vm);
+  snek_object_t *five = new_snek_float(5.0, vm);
+  snek_object_t *six = new_snek_float(6.0, vm);
+
+  snek_object_t *vec1 = new_snek_vector3(one, two, three, vm);
+  snek_object_t *vec2 = new_snek_vector3(four, five, six, vm);
+  snek_object_t *result = snek_add(vec1, vec2, vm);
 
   munit_assert_not_null(result);
   munit_assert_int(result->kind, ==, VECTOR3);
@@ -325,20 +554,29 @@ static MunitResult test_vector3_add(const MunitParameter params[],
   munit_assert_float(result->data.v_vector3.y->data.v_float, ==, 7.0);
   munit_assert_float(result->data.v_vector3.z->data.v_float, ==, 9.0);
 
-  free(vec1->data.v_vector3.x);
-  free(vec1->data.v_vector3.y);
-  free(vec1->data.v_vector3.z);
-  free(vec1);
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
 
-  free(vec2->data.v_vector3.x);
-  free(vec2->data.v_vector3.y);
-  free(vec2->data.v_vector3.z);
-  free(vec2);
+static MunitResult test_float_vector3_add(const MunitParameter params[],
+                                          void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *vec1 = new_snek_float_vector3(1.0, 2.0, 3.0, vm);
+  snek_object_t *vec2 = new_snek_float_vector3(4.0, 5.0, 6.0, vm);
+  snek_object_t *result = snek_add(vec1, vec2, vm);
+
+  munit_assert_not_null(result);
+  munit_assert_int(result->kind, ==, FLOAT_VECTOR3);
+  munit_assert_float(result->data.v_float_vector3.x, ==, 5.0);
+  munit_assert_float(result->data.v_float_vector3.y, ==, 7.0);
+  munit_assert_float(result->data.v_float_vector3.z, ==, 9.0);
+  munit_assert_int(registry_count(vm->objects), ==, 3);
+
+  munit_assert_null(snek_add(vec1, new_snek_float(1.0, vm), vm));
 
-  free(result->data.v_vector3.x);
-  free(result->data.v_vector3.y);
-  free(result->data.v_vector3.z);
-  free(result);
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -346,18 +584,19 @@ static MunitResult test_vector3_add(const MunitParameter params[],
 MunitResult test_array_add(const MunitParameter params[],
                            void *user_data)
 {
-  snek_object_t *one = new_snek_integer(1);
-  snek_object_t *ones = new_snek_array(2);
+  vm_t *vm = vm_new();
+  snek_object_t *one = new_snek_integer(1, vm);
+  snek_object_t *ones = new_snek_array(2, vm);
   munit_assert_true(snek_array_set(ones, 0, one));
   munit_assert_true(snek_array_set(ones, 1, one));
 
-  snek_object_t *hi = new_snek_string("hi");
-  snek_object_t *hellos = new_snek_array(3);
+  snek_object_t *hi = new_snek_string("hi", vm);
+  snek_object_t *hellos = new_snek_array(3, vm);
   munit_assert_true(snek_array_set(hellos, 0, hi));
   munit_assert_true(snek_array_set(hellos, 1, hi));
   munit_assert_true(snek_array_set(hellos, 2, hi));
 
-  snek_object_t *result = snek_add(ones, hellos);
+  snek_object_t *result = snek_add(ones, hellos, vm);
 
   munit_assert_not_null(result);
   munit_assert_int(result->kind, ==, ARRAY);
@@ -368,19 +607,154 @@ MunitResult test_array_add(const MunitParameter params[],
 
   snek_object_t *third = snek_array_get(result, 2);
   munit_assert_not_null(third);
-  munit_assert_string_equal(third->data.v_string, "hi");
+  munit_assert_string_equal(snek_string_chars(third), "hi");
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_array_add_shares(const MunitParameter params[],
+                                         void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *one = new_snek_integer(1, vm);
+  snek_object_t *two = new_snek_integer(2, vm);
+  snek_object_t *ones = new_snek_array(2, vm);
+  snek_object_t *twos = new_snek_array(3, vm);
+  for (int i = 0; i < 2; i++)
+  {
+    snek_array_set(ones, i, one);
+  }
+  for (int i = 0; i < 3; i++)
+  {
+    snek_array_set(twos, i, two);
+  }
+
+  snek_object_t *result = snek_add(ones, twos, vm);
+
+  // Nothing copied yet, both operand buffers are shared
+  munit_assert_ptr_equal(result->data.v_array.buffer,
+                         ones->data.v_array.buffer);
+  munit_assert_ptr_equal(result->data.v_array.tail, twos->data.v_array.buffer);
+  munit_assert_size(ones->data.v_array.buffer->ref_count, ==, 2);
+  munit_assert_ptr_equal(snek_array_get(result, 1), one);
+  munit_assert_ptr_equal(snek_array_get(result, 4), two);
+
+  // Writing to an operand copies it and leaves the result alone
+  snek_object_t *three = new_snek_integer(3, vm);
+  munit_assert_true(snek_array_set(ones, 0, three));
+  munit_assert_ptr_not_equal(ones->data.v_array.buffer,
+                             result->data.v_array.buffer);
+  munit_assert_ptr_equal(snek_array_get(result, 0), one);
+
+  // Writing to the result collapses it into one private buffer
+  munit_assert_true(snek_array_set(result, 4, three));
+  munit_assert_null(result->data.v_array.tail);
+  munit_assert_size(twos->data.v_array.buffer->ref_count, ==, 1);
+  munit_assert_ptr_equal(snek_array_get(result, 2), two);
+  munit_assert_ptr_equal(snek_array_get(result, 4), three);
+  munit_assert_ptr_equal(snek_array_get(twos, 2), two);
+
+  // Concat with an empty array is just another reference to one buffer
+  snek_object_t *same = snek_add(new_snek_array(0, vm), twos, vm);
+  munit_assert_ptr_equal(same->data.v_array.buffer, twos->data.v_array.buffer);
+  munit_assert_null(same->data.v_array.tail);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_slice_add(const MunitParameter params[],
+                                  void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *arr = new_snek_array(4, vm);
+  for (int i = 0; i < 4; i++)
+  {
+    snek_array_set(arr, i, new_snek_integer(i, vm));
+  }
+
+  snek_object_t *head = new_snek_slice(arr, 0, 1, vm);
+  snek_object_t *result = snek_add(head, arr, vm);
+  munit_assert_not_null(result);
+  munit_assert_int(result->kind, ==, ARRAY);
+  munit_assert_int(snek_length(result), ==, 5);
+  munit_assert_int(snek_array_get(result, 0)->data.v_int, ==, 0);
+  munit_assert_int(snek_array_get(result, 4)->data.v_int, ==, 3);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_int_array_add(const MunitParameter params[],
+                                      void *user_data)
+{
+  vm_t *vm = vm_new();
+  // Odd length so both the vector loop and the scalar tail run
+  size_t size = 37;
+  snek_object_t *a = new_snek_int_array(size, vm);
+  snek_object_t *b = new_snek_int_array(size, vm);
+  for (size_t i = 0; i < size; i++)
+  {
+    a->data.v_int_array.elements[i] = (int32_t)i;
+    b->data.v_int_array.elements[i] = -2 * (int32_t)i;
+  }
+
+  snek_object_t *result = snek_add(a, b, vm);
+  munit_assert_not_null(result);
+  munit_assert_int(result->kind, ==, INT_ARRAY);
+  munit_assert_int(snek_length(result), ==, size);
+  for (size_t i = 0; i < size; i++)
+  {
+    munit_assert_int(result->data.v_int_array.elements[i], ==, -(int32_t)i);
+  }
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_float_array_add(const MunitParameter params[],
+                                        void *user_data)
+{
+  vm_t *vm = vm_new();
+  size_t size = 21;
+  snek_object_t *a = new_snek_float_array(size, vm);
+  snek_object_t *b = new_snek_float_array(size, vm);
+  for (size_t i = 0; i < size; i++)
+  {
+    a->data.v_float_array.elements[i] = (float)i;
+    b->data.v_float_array.elements[i] = 0.5f;
+  }
+
+  snek_object_t *result = snek_add(a, b, vm);
+  munit_assert_not_null(result);
+  munit_assert_int(result->kind, ==, FLOAT_ARRAY);
+  for (size_t i = 0; i < size; i++)
+  {
+    munit_assert_float(result->data.v_float_array.elements[i], ==, i + 0.5f);
+  }
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
 
-  free(one);
-  free(ones->data.v_array.elements);
-  free(ones);
+static MunitResult test_typed_array_add_mismatch(const MunitParameter params[],
+                                                 void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *ints = new_snek_int_array(4, vm);
+  snek_object_t *short_ints = new_snek_int_array(3, vm);
+  snek_object_t *floats = new_snek_float_array(4, vm);
 
-  free(hi->data.v_string);
-  free(hi);
-  free(hellos->data.v_array.elements);
-  free(hellos);
-  free(result->data.v_array.elements);
-  free(result);
+  munit_assert_null(snek_add(ints, short_ints, vm));
+  munit_assert_null(snek_add(ints, floats, vm));
 
+  vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
@@ -401,12 +775,20 @@ static MunitTest snekobject_tests[] = {
      NULL},
     {"/string/copied", test_str_copied, NULL, NULL, MUNIT_TEST_OPTION_NONE,
      NULL},
+    {"/string/binary", test_str_binary, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/string/hash_equal", test_str_hash_equal, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
     {"/vector3/returns_null", test_returns_null, NULL, NULL,
      MUNIT_TEST_OPTION_NONE, NULL},
     {"/vector3/multiple_objects", test_vec_multiple_objects, NULL, NULL,
      MUNIT_TEST_OPTION_NONE, NULL},
     {"/vector3/same_object", test_vec_same_object, NULL, NULL,
      MUNIT_TEST_OPTION_NONE, NULL},
+    {"/float_vector3/inline", test_float_vec_inline, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/array/out_of_memory", test_array_out_of_memory, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
     {"/array/create_empty_array", test_create_empty_array, NULL, NULL,
      MUNIT_TEST_OPTION_NONE, NULL},
     {"/array/used_calloc", test_used_calloc, NULL, NULL, MUNIT_TEST_OPTION_NONE,
@@ -415,6 +797,12 @@ static MunitTest snekobject_tests[] = {
      MUNIT_TEST_OPTION_NONE, NULL},
     {"/array/get_outside_bounds", test_get_outside_bounds, NULL, NULL,
      MUNIT_TEST_OPTION_NONE, NULL},
+    {"/slice/view", test_slice_view, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/int_array/create", test_create_int_array, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/float_array/create", test_create_float_array, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
     {"/add/integer", test_integer_add, NULL, NULL, MUNIT_TEST_OPTION_NONE,
      NULL},
     {"/add/float", test_float_add, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
@@ -422,9 +810,24 @@ static MunitTest snekobject_tests[] = {
      NULL},
     {"/add/string_self", test_string_add_self, NULL, NULL,
      MUNIT_TEST_OPTION_NONE, NULL},
+    {"/add/string_rope_appends", test_string_add_rope_appends, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/add/string_rope", test_string_add_rope, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
     {"/add/vector3", test_vector3_add, NULL, NULL, MUNIT_TEST_OPTION_NONE,
      NULL},
+    {"/add/float_vector3", test_float_vector3_add, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
     {"/add/array", test_array_add, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/add/array_shares", test_array_add_shares, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/add/slice", test_slice_add, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/add/int_array", test_int_array_add, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/add/float_array", test_float_array_add, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/add/typed_array_mismatch", test_typed_array_add_mismatch, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
     {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
 MunitSuite snekobject_suite = {
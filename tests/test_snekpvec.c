@@ -0,0 +1,206 @@
+#include "../munit/munit.h"
+#include "../src/bootmem.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/snekpvec.h"
+#include "../src/vm.h"
+#include "stdlib.h"
+
+// Builds [first, first + count) of integers with a transient
+static snek_object_t *pvec_range(int first, int count, vm_t *vm)
+{
+  snek_object_t *vec = snek_pvec_transient(new_snek_pvec(vm), vm);
+  for (int i = 0; i < count; i++)
+  {
+    vec = snek_pvec_push(vec, new_snek_integer(first + i, vm), vm);
+  }
+  return snek_pvec_persistent(vec);
+}
+
+static void assert_pvec_range(snek_object_t *vec, int first, int count)
+{
+  munit_assert_int(snek_length(vec), ==, count);
+  for (int i = 0; i < count; i++)
+  {
+    snek_object_t *item = snek_pvec_get(vec, i);
+    munit_assert_not_null(item);
+    munit_assert_int(item->data.v_int, ==, first + i);
+  }
+  munit_assert_null(snek_pvec_get(vec, count));
+}
+
+static MunitResult test_push_get(const MunitParameter params[],
+                                 void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *vec = new_snek_pvec(vm);
+  munit_assert_int(vec->kind, ==, PVECTOR);
+  munit_assert_int(snek_length(vec), ==, 0);
+
+  // Persistent pushes return new vectors and leave the old ones alone
+  snek_object_t *one = snek_pvec_push(vec, new_snek_integer(0, vm), vm);
+  munit_assert_ptr_not_equal(one, vec);
+  munit_assert_int(snek_length(vec), ==, 0);
+
+  snek_object_t *big = pvec_range(0, 40000, vm);
+  assert_pvec_range(big, 0, 40000);
+  // 32^3 < 40000 <= 32^4 elements, so the root sits three levels up
+  munit_assert_int(big->data.v_pvec.root->height, ==, 3);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_set_persistent(const MunitParameter params[],
+                                       void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *vec = pvec_range(0, 1000, vm);
+  snek_object_t *marker = new_snek_integer(-1, vm);
+
+  snek_object_t *updated = snek_pvec_set(vec, 500, marker, vm);
+  munit_assert_ptr_not_equal(updated, vec);
+  munit_assert_ptr_equal(snek_pvec_get(updated, 500), marker);
+  munit_assert_int(snek_pvec_get(vec, 500)->data.v_int, ==, 500);
+
+  // Only the path to the updated leaf is copied
+  munit_assert_ptr_equal(updated->data.v_pvec.root->slots[0],
+                         vec->data.v_pvec.root->slots[0]);
+  munit_assert_ptr_not_equal(updated->data.v_pvec.root->slots[15],
+                             vec->data.v_pvec.root->slots[15]);
+
+  munit_assert_null(snek_pvec_set(vec, 1000, marker, vm));
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_transient(const MunitParameter params[],
+                                  void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *vec = pvec_range(0, 100, vm);
+  snek_object_t *transient = snek_pvec_transient(vec, vm);
+  snek_object_t *marker = new_snek_integer(-1, vm);
+
+  // Transients update themselves, copying shared paths only once
+  munit_assert_ptr_equal(snek_pvec_set(transient, 10, marker, vm), transient);
+  snek_pvec_node_t *leaf = transient->data.v_pvec.root->slots[0];
+  munit_assert_ptr_equal(snek_pvec_set(transient, 11, marker, vm), transient);
+  munit_assert_ptr_equal(transient->data.v_pvec.root->slots[0], leaf);
+  munit_assert_ptr_equal(snek_pvec_push(transient, marker, vm), transient);
+
+  munit_assert_int(snek_length(transient), ==, 101);
+  munit_assert_ptr_equal(snek_pvec_get(transient, 11), marker);
+  assert_pvec_range(vec, 0, 100);
+
+  // Frozen again, updates copy
+  snek_pvec_persistent(transient);
+  munit_assert_ptr_not_equal(snek_pvec_push(transient, marker, vm), transient);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_concat(const MunitParameter params[],
+                               void *user_data)
+{
+  vm_t *vm = vm_new();
+  int sizes[] = {1, 31, 32, 33, 100, 1024, 1025, 3000, 7};
+  int count = sizeof(sizes) / sizeof(sizes[0]);
+
+  for (int i = 0; i < count; i++)
+  {
+    for (int j = 0; j < count; j++)
+    {
+      snek_object_t *left = pvec_range(0, sizes[i], vm);
+      snek_object_t *right = pvec_range(sizes[i], sizes[j], vm);
+      snek_object_t *both = snek_add(left, right, vm);
+      munit_assert_int(both->kind, ==, PVECTOR);
+      assert_pvec_range(both, 0, sizes[i] + sizes[j]);
+      assert_pvec_range(right, sizes[i], sizes[j]);
+    }
+  }
+
+  // Many small concats stay shallow thanks to rebalancing
+  snek_object_t *acc = new_snek_pvec(vm);
+  int total = 0;
+  unsigned seed = 7;
+  for (int i = 0; i < 300; i++)
+  {
+    seed = seed * 1103515245 + 12345;
+    int size = 1 + (seed >> 16) % 50;
+    acc = snek_add(acc, pvec_range(total, size, vm), vm);
+    total += size;
+  }
+  assert_pvec_range(acc, 0, total);
+  munit_assert_int(acc->data.v_pvec.root->height, <=, 4);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_take_drop(const MunitParameter params[],
+                                  void *user_data)
+{
+  vm_t *vm = vm_new();
+  snek_object_t *vec = pvec_range(0, 2500, vm);
+  int cuts[] = {0, 1, 31, 32, 33, 1024, 1500, 2499, 2500};
+
+  for (size_t i = 0; i < sizeof(cuts) / sizeof(cuts[0]); i++)
+  {
+    snek_object_t *head = snek_pvec_take(vec, cuts[i], vm);
+    snek_object_t *tail = snek_pvec_drop(vec, cuts[i], vm);
+    assert_pvec_range(head, 0, cuts[i]);
+    assert_pvec_range(tail, cuts[i], 2500 - cuts[i]);
+
+    // Splitting and joining gives back the original sequence
+    assert_pvec_range(snek_add(head, tail, vm), 0, 2500);
+  }
+  munit_assert_null(snek_pvec_take(vec, 2501, vm));
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_trace_shared(const MunitParameter params[],
+                                     void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *vec = pvec_range(0, 500, vm);
+  snek_object_t *other = snek_pvec_set(vec, 0, new_snek_integer(-1, vm), vm);
+  frame_reference_object(frame, other);
+  new_snek_integer(1234, vm);
+
+  vm_collect_garbage(vm);
+
+  // The 500 elements and the replacement survive through `other`; `vec`,
+  // the replaced element and the loose integer are swept
+  munit_assert_int(registry_count(vm->objects), ==, 1 + 500);
+  munit_assert_int(snek_pvec_get(other, 0)->data.v_int, ==, -1);
+  munit_assert_int(snek_pvec_get(other, 499)->data.v_int, ==, 499);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitTest snekpvec_tests[] = {
+    {"/push_get", test_push_get, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/set_persistent", test_set_persistent, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/transient", test_transient, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/concat", test_concat, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/take_drop", test_take_drop, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/trace_shared", test_trace_shared, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+MunitSuite snekpvec_suite = {"/snekpvec", snekpvec_tests, NULL, 1,
+                             MUNIT_SUITE_OPTION_NONE};
@@ -143,6 +143,30 @@ static MunitResult test_pop_empty_stack(const MunitParameter params[],
     return MUNIT_OK;
 }
 
+static MunitResult test_shrink_stack(const MunitParameter params[],
+                                     void *user_data)
+{
+    stack_t *stack = stack_new(100);
+    int a = 1, b = 2;
+    stack_push(stack, &a);
+    stack_push(stack, &b);
+
+    munit_assert_true(stack_shrink(stack, 10));
+    munit_assert_int(stack->capacity, ==, 10);
+    munit_assert_ptr_equal(stack->data[1], &b);
+
+    // Never below the count, never grows
+    munit_assert_true(stack_shrink(stack, 1));
+    munit_assert_int(stack->capacity, ==, 2);
+    munit_assert_false(stack_shrink(stack, 50));
+    munit_assert_int(stack->capacity, ==, 2);
+    munit_assert_ptr_equal(stack->data[0], &a);
+
+    stack_free(stack);
+    munit_assert_true(boot_all_freed());
+    return MUNIT_OK;
+}
+
 static MunitTest stack_tests[] = {
     {"/create_stack_small", test_create_stack_small, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
     {"/create_stack_large", test_create_stack_large, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
@@ -150,6 +174,7 @@ static MunitTest stack_tests[] = {
     {"/push_double_capacity", test_push_double_capacity, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
     {"/pop_stack", test_pop_stack, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
     {"/pop_empty_stack", test_pop_empty_stack, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/shrink_stack", test_shrink_stack, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
     {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
 MunitSuite stack_suite = {
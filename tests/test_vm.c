@@ -3,6 +3,7 @@
 #include "../src/sneknew.h"
 #include "../src/snekobject.h"
 #include "../src/vm.h"
+#include <pthread.h>
 #include <stdio.h>
 #include "stdlib.h"
 
@@ -12,7 +13,7 @@ static MunitResult test_vm_new(const MunitParameter params[], void *user_data)
   munit_assert_ptr_not_null(vm->frames);
   munit_assert_ptr_not_null(vm->objects);
   munit_assert_int(vm->frames->capacity, ==, 8);
-  munit_assert_int(vm->objects->capacity, ==, 8);
+  munit_assert_int(registry_count(vm->objects), ==, 0);
   vm_free(vm);
 
   return MUNIT_OK;
@@ -35,7 +36,7 @@ static MunitResult test_new_object(const MunitParameter params[],
   vm_t *vm = vm_new();
   snek_object_t *obj = new_snek_integer(20, vm);
   munit_assert_int(obj->kind, ==, INTEGER);
-  munit_assert_ptr_equal(vm->objects->data[0], obj);
+  munit_assert_ptr_equal(registry_get(vm->objects, 0), obj);
 
   vm_free(vm);
   munit_assert_true(boot_all_freed());
@@ -192,6 +193,56 @@ static MunitResult test_trace_vector(const MunitParameter params[],
   return MUNIT_OK;
 }
 
+static MunitResult test_trace_float_vector(const MunitParameter params[],
+                                           void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *vec = new_snek_float_vector3(1.0, 2.0, 3.0, vm);
+  snek_object_t *garbage = new_snek_float_vector3(4.0, 5.0, 6.0, vm);
+
+  frame_reference_object(frame, vec);
+  vm_collect_garbage(vm);
+
+  munit_assert_int(registry_count(vm->objects), ==, 1);
+  munit_assert_ptr_equal(registry_get(vm->objects, 0), vec);
+  munit_assert_false(vec->is_marked);
+  (void)garbage;
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_trace_rope(const MunitParameter params[],
+                                   void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *left = new_snek_string(
+      "a left half that is long enough to become a rope node", vm);
+  snek_object_t *right = new_snek_string(
+      "and a right half that is long enough to stay unflattened", vm);
+  snek_object_t *rope = snek_add(left, right, vm);
+  munit_assert_ptr_equal(rope->data.v_string.rope->left, left);
+
+  frame_reference_object(frame, rope);
+  vm_collect_garbage(vm);
+
+  // The halves are only reachable through the rope
+  munit_assert_int(registry_count(vm->objects), ==, 3);
+  munit_assert_int(snek_length(rope), ==, snek_length(left) + snek_length(right));
+
+  // After flattening the halves are no longer needed
+  munit_assert_not_null(snek_string_chars(rope));
+  vm_collect_garbage(vm);
+  munit_assert_int(registry_count(vm->objects), ==, 1);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
 static MunitResult test_trace_array(MunitParameter params[], void *user_data)
 {
   vm_t *vm = vm_new();
@@ -256,6 +307,133 @@ static MunitResult test_trace_array_nested(MunitParameter params[],
   return MUNIT_OK;
 }
 
+static MunitResult test_trace_shared_array(const MunitParameter params[],
+                                           void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *first = new_snek_array(1, vm);
+  snek_object_t *second = new_snek_array(1, vm);
+  snek_object_t *hello = new_snek_string("Hello", vm);
+  snek_object_t *world = new_snek_string("World", vm);
+  snek_array_set(first, 0, hello);
+  snek_array_set(second, 0, world);
+
+  // Operands are garbage, their buffers live on in the concat
+  snek_object_t *both = snek_add(first, second, vm);
+  frame_reference_object(frame, both);
+  vm_collect_garbage(vm);
+
+  munit_assert_int(registry_count(vm->objects), ==, 3);
+  munit_assert_ptr_equal(snek_array_get(both, 0), hello);
+  munit_assert_ptr_equal(snek_array_get(both, 1), world);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_trace_slice(const MunitParameter params[],
+                                    void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *arr = new_snek_array(2, vm);
+  snek_object_t *hello = new_snek_string("Hello", vm);
+  snek_object_t *world = new_snek_string("World", vm);
+  snek_array_set(arr, 0, hello);
+  snek_array_set(arr, 1, world);
+
+  snek_object_t *slice = new_snek_slice(arr, 1, 1, vm);
+  frame_reference_object(frame, slice);
+  mark(vm);
+  trace(vm);
+
+  // Small parents are kept alive whole, elements outside the view included
+  munit_assert_true(arr->is_marked);
+  munit_assert_true(hello->is_marked);
+  munit_assert_true(world->is_marked);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static snek_object_t *new_big_array(size_t size, vm_t *vm)
+{
+  snek_object_t *arr = new_snek_array(size, vm);
+  for (size_t i = 0; i < size; i++)
+  {
+    snek_array_set(arr, i, new_snek_integer((int)i, vm));
+  }
+  return arr;
+}
+
+static MunitResult test_slice_compacts_parent(const MunitParameter params[],
+                                              void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *arr = new_big_array(2048, vm);
+  snek_object_t *first = new_snek_slice(arr, 10, 4, vm);
+  snek_object_t *second = new_snek_slice(arr, 100, 4, vm);
+  frame_reference_object(frame, first);
+  frame_reference_object(frame, second);
+
+  vm_collect_garbage(vm);
+
+  // The parent is gone, the slices own copies of their ranges
+  munit_assert_int(registry_count(vm->objects), ==, 2 + 8);
+  munit_assert_int(first->kind, ==, ARRAY);
+  munit_assert_int(snek_length(first), ==, 4);
+  munit_assert_int(snek_array_get(first, 0)->data.v_int, ==, 10);
+  munit_assert_int(snek_array_get(second, 3)->data.v_int, ==, 103);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_slice_keeps_parent(const MunitParameter params[],
+                                           void *user_data)
+{
+  vm_t *vm = vm_new();
+  frame_t *frame = vm_new_frame(vm);
+
+  // Parent also rooted directly
+  snek_object_t *rooted = new_big_array(2048, vm);
+  snek_object_t *rooted_view = new_snek_slice(rooted, 0, 4, vm);
+  frame_reference_object(frame, rooted_view);
+  frame_reference_object(frame, rooted);
+
+  // Overlapping slices must keep sharing their parent
+  snek_object_t *shared = new_big_array(2048, vm);
+  snek_object_t *left = new_snek_slice(shared, 0, 8, vm);
+  snek_object_t *right = new_snek_slice(shared, 4, 8, vm);
+  frame_reference_object(frame, left);
+  frame_reference_object(frame, right);
+
+  // Parent reachable through an element of a compacting candidate's range
+  snek_object_t *outer = new_big_array(2048, vm);
+  snek_object_t *inner = new_big_array(2048, vm);
+  snek_object_t *inner_view = new_snek_slice(inner, 0, 4, vm);
+  snek_array_set(outer, 0, inner);
+  snek_array_set(inner, 1, inner_view);
+  frame_reference_object(frame, new_snek_slice(outer, 0, 2, vm));
+
+  vm_collect_garbage(vm);
+
+  munit_assert_int(rooted_view->kind, ==, SLICE);
+  munit_assert_int(left->kind, ==, SLICE);
+  munit_assert_int(right->kind, ==, SLICE);
+  munit_assert_int(inner_view->kind, ==, SLICE);
+  munit_assert_ptr_equal(snek_array_get(left, 4), snek_array_get(right, 0));
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
 static MunitResult test_full_system_simple(const MunitParameter params[],
                                            void *user_data)
 {
@@ -306,12 +484,12 @@ static MunitResult test_full_system(const MunitParameter params[],
   frame_reference_object(frame2, vec);
   frame_reference_object(frame3, vec);
 
-  munit_assert_int(vm->objects->count, ==, 7);
+  munit_assert_int(registry_count(vm->objects), ==, 7);
 
   // free the top frame
   frame_free(vm_frame_pop(vm));
   vm_collect_garbage(vm);
-  munit_assert_int(vm->objects->count, ==, 6);
+  munit_assert_int(registry_count(vm->objects), ==, 6);
   printf("Asserting that memory is not freed yet:\n");
   munit_assert_false(boot_all_freed());
   // TODO: implement boot_is_freed(*ptr) and refactor boot_all_freed()
@@ -324,12 +502,312 @@ static MunitResult test_full_system(const MunitParameter params[],
   frame_free(vm_frame_pop(vm));
   frame_free(vm_frame_pop(vm));
   vm_collect_garbage(vm);
-  munit_assert_int(vm->objects->count, ==, 0);
+  munit_assert_int(registry_count(vm->objects), ==, 0);
 
   vm_free(vm);
   munit_assert_true(boot_all_freed());
   return MUNIT_OK;
 }
+static MunitResult test_gc_stress_frees_unrooted(const MunitParameter params[],
+                                                 void *user_data)
+{
+  vm_t *vm = vm_new();
+  vm_gc_stress(vm, 1);
+  frame_t *frame = vm_new_frame(vm);
+
+  // Missing its frame reference, so the next allocation frees it
+  new_snek_integer(1, vm);
+  snek_object_t *kept = new_snek_integer(2, vm);
+  munit_assert_int(registry_count(vm->objects), ==, 1);
+  frame_reference_object(frame, kept);
+  new_snek_integer(3, vm);
+  munit_assert_int(registry_count(vm->objects), ==, 2);
+  munit_assert_ptr_equal(registry_get(vm->objects, 0), kept);
+
+  vm_gc_stress(vm, 0);
+  new_snek_integer(4, vm);
+  new_snek_integer(5, vm);
+  munit_assert_int(registry_count(vm->objects), ==, 4);
+
+  vm_free(vm);
+  munit_assert_false(boot_poison_enabled());
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_gc_stress_poisoning(const MunitParameter params[],
+                                            void *user_data)
+{
+  vm_t *a = vm_new();
+  vm_t *b = vm_new();
+  munit_assert_false(boot_poison_enabled());
+
+  vm_gc_stress(a, 1);
+  vm_gc_stress(b, 1);
+  vm_gc_stress(b, 4);
+  munit_assert_true(boot_poison_enabled());
+
+  // Still on for `b`
+  vm_gc_stress(a, 0);
+  vm_gc_stress(a, 0);
+  munit_assert_true(boot_poison_enabled());
+
+  // Freeing the last VM in stress mode turns it off
+  vm_free(b);
+  munit_assert_false(boot_poison_enabled());
+
+  vm_free(a);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_gc_stress_inhibit(const MunitParameter params[],
+                                          void *user_data)
+{
+  vm_t *vm = vm_new();
+  vm_gc_stress(vm, 1);
+  vm_verify_heap_enable(vm, true);
+  frame_t *frame = vm_new_frame(vm);
+
+  snek_object_t *x = new_snek_integer(1, vm);
+  frame_reference_object(frame, x);
+  snek_object_t *y = new_snek_integer(2, vm);
+  frame_reference_object(frame, y);
+  snek_object_t *z = new_snek_float(3.0f, vm);
+  frame_reference_object(frame, z);
+  snek_object_t *a = new_snek_vector3(x, y, z, vm);
+  frame_reference_object(frame, a);
+
+  // The three component sums are unrooted until the vector holds them
+  snek_object_t *sum = snek_add(a, a, vm);
+  frame_reference_object(frame, sum);
+  new_snek_integer(0, vm);
+  munit_assert_int(sum->data.v_vector3.x->data.v_int, ==, 2);
+  munit_assert_int(sum->data.v_vector3.y->data.v_int, ==, 4);
+  munit_assert_float(sum->data.v_vector3.z->data.v_float, ==, 6.0f);
+
+  // Deep enough to be rebalanced, which builds a tree of new nodes
+  snek_object_t *piece =
+      new_snek_string("a piece long enough to stay a separate rope leaf", vm);
+  frame_reference_object(frame, piece);
+  snek_object_t *text = piece;
+  for (int i = 0; i < 80; i++)
+  {
+    text = snek_add(text, piece, vm);
+    frame_reference_object(frame, text);
+  }
+  new_snek_integer(0, vm);
+  munit_assert_int(snek_length(text), ==, 81 * snek_length(piece));
+  munit_assert_size(snek_string_depth(text), <=, 48);
+
+  vm_free(vm);
+  munit_assert_false(boot_poison_enabled());
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+#define MUTATOR_THREADS 4
+#define MUTATOR_ELEMENTS 2000
+
+typedef struct MutatorArgs
+{
+  vm_mutator_t *mutator;
+  long long sum;
+} mutator_args_t;
+
+static void *mutator_thread(void *arg)
+{
+  mutator_args_t *args = arg;
+  vm_mutator_attach(args->mutator);
+  vm_t *vm = args->mutator->vm;
+  frame_t *frame = vm_new_frame(vm);
+
+  snek_object_t *list = new_snek_array(MUTATOR_ELEMENTS, vm);
+  frame_reference_object(frame, list);
+  for (int i = 0; i < MUTATOR_ELEMENTS; i++)
+  {
+    // Each integer is held by the rooted list before the next allocation
+    snek_array_set(list, i, new_snek_integer(i, vm));
+    new_snek_integer(-i, vm);
+    if (i % 250 == 0)
+    {
+      vm_collect_garbage(vm);
+    }
+  }
+  vm_collect_garbage(vm);
+
+  args->sum = 0;
+  for (int i = 0; i < MUTATOR_ELEMENTS; i++)
+  {
+    args->sum += snek_array_get(list, i)->data.v_int;
+  }
+  vm_mutator_free(args->mutator);
+  return NULL;
+}
+
+static MunitResult test_mutator_threads(const MunitParameter params[],
+                                        void *user_data)
+{
+  vm_t *vm = vm_new();
+  vm_gc_stats_enable(vm, true);
+  frame_t *frame = vm_new_frame(vm);
+  snek_object_t *kept = new_snek_integer(7, vm);
+  frame_reference_object(frame, kept);
+
+  pthread_t threads[MUTATOR_THREADS];
+  mutator_args_t args[MUTATOR_THREADS];
+  for (int i = 0; i < MUTATOR_THREADS; i++)
+  {
+    args[i].mutator = vm_mutator_new(vm);
+    munit_assert_ptr_not_null(args[i].mutator);
+    pthread_create(&threads[i], NULL, mutator_thread, &args[i]);
+  }
+  // Joining waits outside the VM, collections must not wait for it
+  vm_blocking_enter(vm);
+  for (int i = 0; i < MUTATOR_THREADS; i++)
+  {
+    pthread_join(threads[i], NULL);
+  }
+  vm_blocking_leave(vm);
+
+  long long expected = (long long)MUTATOR_ELEMENTS * (MUTATOR_ELEMENTS - 1) / 2;
+  for (int i = 0; i < MUTATOR_THREADS; i++)
+  {
+    munit_assert_llong(args[i].sum, ==, expected);
+  }
+  munit_assert_size(vm->mutators->count, ==, 0);
+
+  // The workers' frames went with them, only the main frame is left
+  vm_collect_garbage(vm);
+  munit_assert_int(registry_count(vm->objects), ==, 1);
+  munit_assert_ptr_equal(registry_get(vm->objects, 0), kept);
+
+  gc_stats_t stats;
+  vm_gc_stats(vm, &stats);
+  munit_assert_uint64(stats.collections, >=, MUTATOR_THREADS);
+  munit_assert_uint64(stats.safepoint_max_ns, <=, stats.safepoint_total_ns);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static void *register_batch_thread(void *arg)
+{
+  vm_mutator_t *mutator = arg;
+  vm_mutator_attach(mutator);
+  vm_t *vm = mutator->vm;
+  frame_t *frame = vm_new_frame(vm);
+
+  // Buffered by the thread, the registry hasn't seen them yet
+  size_t registered = registry_count(vm->objects);
+  for (int i = 0; i < 10; i++)
+  {
+    frame_reference_object(frame, new_snek_integer(i, vm));
+  }
+  munit_assert_size(mutator->pending_count, ==, 10);
+  munit_assert_size(registry_count(vm->objects), ==, registered);
+
+  // A full buffer goes to the registry in one append
+  for (int i = 10; i < VM_REGISTER_BATCH; i++)
+  {
+    new_snek_integer(i, vm);
+  }
+  munit_assert_size(mutator->pending_count, ==, 0);
+  munit_assert_size(registry_count(vm->objects), ==, registered + VM_REGISTER_BATCH);
+
+  new_snek_integer(-1, vm);
+  munit_assert_size(mutator->pending_count, ==, 1);
+  vm_collect_garbage(vm);
+  munit_assert_size(mutator->pending_count, ==, 0);
+  munit_assert_size(registry_count(vm->objects), ==, registered + 10);
+
+  // What's still buffered when the thread leaves is kept
+  snek_object_t *last = new_snek_integer(-2, vm);
+  vm_mutator_free(mutator);
+  return last;
+}
+
+static MunitResult test_mutator_register_batch(const MunitParameter params[],
+                                               void *user_data)
+{
+  vm_t *vm = vm_new();
+  pthread_t thread;
+  pthread_create(&thread, NULL, register_batch_thread, vm_mutator_new(vm));
+  vm_blocking_enter(vm);
+  void *last;
+  pthread_join(thread, &last);
+  vm_blocking_leave(vm);
+
+  munit_assert_int(registry_count(vm->objects), ==, 11);
+  munit_assert_ptr_equal(registry_get(vm->objects, 10), last);
+  vm_collect_garbage(vm);
+  munit_assert_int(registry_count(vm->objects), ==, 0);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_scavenge(const MunitParameter params[],
+                                 void *user_data)
+{
+  vm_t *vm = vm_new();
+  vm_gc_stats_enable(vm, true);
+  frame_t *root = vm_new_frame(vm);
+  snek_object_t *kept = new_snek_integer(1, vm);
+  for (int i = 0; i < 1000; i++)
+  {
+    frame_reference_object(root, kept);
+  }
+  // A deep call spike that has unwound
+  for (int i = 0; i < 1000; i++)
+  {
+    vm_new_frame(vm);
+  }
+  for (int i = 0; i < 1000; i++)
+  {
+    frame_free(vm_frame_pop(vm));
+  }
+  root->references->count = 1;
+  munit_assert_size(vm->frames->capacity, >=, 1000);
+
+  size_t released = vm_scavenge(vm);
+  munit_assert_size(released, >, 0);
+  munit_assert_size(vm->frames->capacity, ==, 8);
+  munit_assert_size(root->references->capacity, ==, 8);
+  munit_assert_ptr_equal(root->references->data[0], kept);
+  // Nothing left to cut
+  munit_assert_size(vm_scavenge(vm), ==, 0);
+
+  // Collections run it every interval-th time
+  vm_scavenge_interval(vm, 2);
+  for (int i = 0; i < 100; i++)
+  {
+    frame_reference_object(root, kept);
+  }
+  root->references->count = 1;
+  vm_collect_garbage(vm);
+  munit_assert_size(root->references->capacity, >, 8);
+  gc_stats_t stats;
+  vm_gc_stats(vm, &stats);
+  uint64_t scavenge_ns = stats.scavenge_ns;
+  vm_collect_garbage(vm);
+  munit_assert_size(root->references->capacity, ==, 8);
+
+  // The scavenge ran inside the collection's pause
+  vm_gc_stats(vm, &stats);
+  munit_assert_uint64(stats.pause_last_ns, >=,
+                      stats.scavenge_ns - scavenge_ns);
+  munit_assert_uint64(stats.scavenges, ==, 3);
+  munit_assert_uint64(stats.scavenged_bytes, >=, released);
+  munit_assert_int(registry_count(vm->objects), ==, 1);
+
+  vm_free(vm);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
 static MunitTest vm_tests[] = {
     {"/vm_new", test_vm_new, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
     {"/vm_free", test_vm_free, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
@@ -348,14 +826,37 @@ static MunitTest vm_tests[] = {
      NULL},
     {"/trace_vector", test_trace_vector, NULL, NULL, MUNIT_TEST_OPTION_NONE,
      NULL},
+    {"/trace_float_vector", test_trace_float_vector, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/trace_rope", test_trace_rope, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
     {"/trace_array", test_trace_array, NULL, NULL, MUNIT_TEST_OPTION_NONE,
      NULL},
     {"/trace_array_nested", test_trace_array_nested, NULL, NULL,
      MUNIT_TEST_OPTION_NONE, NULL},
+    {"/trace_shared_array", test_trace_shared_array, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/trace_slice", test_trace_slice, NULL, NULL, MUNIT_TEST_OPTION_NONE,
+     NULL},
+    {"/slice_compacts_parent", test_slice_compacts_parent, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/slice_keeps_parent", test_slice_keeps_parent, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
     {"/full_system_simple", test_full_system_simple, NULL, NULL,
      MUNIT_TEST_OPTION_NONE, NULL},
     {"/full_system", test_full_system, NULL, NULL, MUNIT_TEST_OPTION_NONE,
      NULL},
+    {"/gc_stress_frees_unrooted", test_gc_stress_frees_unrooted, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/gc_stress_poisoning", test_gc_stress_poisoning, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/gc_stress_inhibit", test_gc_stress_inhibit, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/mutator_threads", test_mutator_threads, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/mutator_register_batch", test_mutator_register_batch, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/scavenge", test_scavenge, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
     {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
 
 MunitSuite vm_suite = {"/vm", vm_tests, NULL, 1, MUNIT_SUITE_OPTION_NONE};
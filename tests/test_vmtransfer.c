@@ -0,0 +1,217 @@
+#include "../munit/munit.h"
+#include "../src/bootmem.h"
+#include "../src/heapverify.h"
+#include "../src/sneknew.h"
+#include "../src/snekobject.h"
+#include "../src/snekpvec.h"
+#include "../src/vmtransfer.h"
+#include <string.h>
+#include "stdlib.h"
+
+static bool registered(vm_t *vm, snek_object_t *obj)
+{
+  registry_cursor_t cursor = registry_begin(vm->objects);
+  snek_object_t *entry;
+  while ((entry = registry_next(&cursor)) != NULL)
+  {
+    if (entry == obj)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+static MunitResult test_move(const MunitParameter params[], void *user_data)
+{
+  vm_t *src = vm_new();
+  vm_t *dst = vm_new();
+  frame_t *src_frame = vm_new_frame(src);
+  frame_t *dst_frame = vm_new_frame(dst);
+
+  snek_object_t *kept = new_snek_integer(1, src);
+  frame_reference_object(src_frame, kept);
+
+  snek_object_t *array = new_snek_array(3, src);
+  frame_reference_object(src_frame, array);
+  snek_array_set(array, 0, new_snek_integer(2, src));
+  snek_object_t *rope = new_snek_rope(new_snek_string("ab", src),
+                                      new_snek_string("cd", src), src);
+  snek_array_set(array, 1, rope);
+  snek_object_t *pvec = snek_pvec_push(new_snek_pvec(src), kept, src);
+  snek_array_set(array, 2, pvec);
+  // Only `kept` stays rooted, the array is held by the caller alone
+  frame_free(vm_frame_pop(src));
+  src_frame = vm_new_frame(src);
+  frame_reference_object(src_frame, kept);
+
+  // `kept` is still rooted in `src`, so the vector holding it is copied
+  snek_object_t *copied = vm_transfer(src, dst, array);
+  munit_assert_ptr_not_null(copied);
+  munit_assert_ptr_not_equal(copied, array);
+  munit_assert_true(registered(src, array));
+
+  snek_array_set(array, 2, new_snek_integer(3, src));
+  snek_object_t *moved = vm_transfer(src, dst, array);
+  frame_reference_object(dst_frame, moved);
+  frame_reference_object(dst_frame, copied);
+  munit_assert_ptr_equal(moved, array);
+  munit_assert_false(registered(src, array));
+  munit_assert_false(registered(src, rope));
+  munit_assert_true(registered(dst, array));
+  munit_assert_true(registered(dst, rope->data.v_string.rope->left));
+
+  vm_collect_garbage(src);
+  vm_collect_garbage(dst);
+  munit_assert_true(vm_verify_heap(src, NULL));
+  munit_assert_true(vm_verify_heap(dst, NULL));
+  munit_assert_int(registry_count(src->objects), ==, 1);
+  munit_assert_string_equal(snek_string_chars(snek_array_get(moved, 1)),
+                            "abcd");
+  munit_assert_int(snek_array_get(moved, 2)->data.v_int, ==, 3);
+  snek_object_t *copied_pvec = snek_array_get(copied, 2);
+  munit_assert_int(snek_pvec_get(copied_pvec, 0)->data.v_int, ==, 1);
+  munit_assert_ptr_not_equal(snek_pvec_get(copied_pvec, 0), kept);
+
+  vm_free(src);
+  vm_free(dst);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_move_detaches_storage(const MunitParameter params[],
+                                              void *user_data)
+{
+  vm_t *src = vm_new();
+  vm_t *dst = vm_new();
+  frame_t *dst_frame = vm_new_frame(dst);
+
+  // Both share `a`'s buffer, and `vec` shares its tree with `base`
+  snek_object_t *a = new_snek_array(2, src);
+  snek_array_set(a, 0, new_snek_integer(1, src));
+  snek_array_set(a, 1, new_snek_integer(2, src));
+  snek_object_t *both = snek_add(a, a, src);
+  snek_object_t *base = snek_pvec_push(new_snek_pvec(src), a, src);
+  snek_object_t *vec = snek_pvec_push(base, both, src);
+  munit_assert_size(a->data.v_array.buffer->ref_count, ==, 3);
+
+  snek_object_t *moved = vm_transfer(src, dst, vec);
+  munit_assert_ptr_equal(moved, vec);
+  frame_reference_object(dst_frame, moved);
+  munit_assert_size(a->data.v_array.buffer->ref_count, ==, 1);
+  munit_assert_size(both->data.v_array.buffer->ref_count, ==, 1);
+  munit_assert_null(both->data.v_array.tail);
+  munit_assert_size(vec->data.v_pvec.root->ref_count, ==, 1);
+
+  // Freeing what's left in `src` must not touch the moved storage
+  vm_collect_garbage(src);
+  munit_assert_int(registry_count(src->objects), ==, 0);
+  vm_collect_garbage(dst);
+  munit_assert_true(vm_verify_heap(dst, NULL));
+  munit_assert_int(snek_length(snek_pvec_get(moved, 1)), ==, 4);
+  munit_assert_int(snek_array_get(snek_pvec_get(moved, 1), 3)->data.v_int, ==,
+                   2);
+
+  vm_free(src);
+  vm_free(dst);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_copy_keeps_cycles(const MunitParameter params[],
+                                          void *user_data)
+{
+  vm_t *src = vm_new();
+  vm_t *dst = vm_new();
+  frame_t *src_frame = vm_new_frame(src);
+  frame_t *dst_frame = vm_new_frame(dst);
+
+  snek_object_t *x = new_snek_array(4, src);
+  frame_reference_object(src_frame, x);
+  snek_object_t *y = new_snek_array(2, src);
+  snek_object_t *shared = new_snek_float(1.5f, src);
+  snek_array_set(x, 0, y);
+  snek_array_set(y, 0, x);
+  snek_array_set(x, 1, shared);
+  snek_array_set(y, 1, shared);
+  snek_array_set(x, 2, new_snek_slice(y, 1, 1, src));
+  snek_object_t *ints = new_snek_int_array(3, src);
+  ints->data.v_int_array.elements[2] = 42;
+  snek_array_set(x, 3, new_snek_vector3(ints, shared, y, src));
+  size_t before = registry_count(src->objects);
+
+  snek_object_t *copy = vm_transfer(src, dst, x);
+  munit_assert_ptr_not_null(copy);
+  frame_reference_object(dst_frame, copy);
+  munit_assert_int(registry_count(src->objects), ==, before);
+  munit_assert_int(registry_count(dst->objects), ==, 6);
+  // Registered together, in the order they were copied
+  registry_cursor_t cursor = registry_begin(dst->objects);
+  munit_assert_ptr_equal(registry_next(&cursor), copy);
+
+  snek_object_t *copy_y = snek_array_get(copy, 0);
+  munit_assert_ptr_not_equal(copy_y, y);
+  munit_assert_ptr_equal(snek_array_get(copy_y, 0), copy);
+  munit_assert_ptr_equal(snek_array_get(copy, 1), snek_array_get(copy_y, 1));
+  munit_assert_float(snek_array_get(copy, 1)->data.v_float, ==, 1.5f);
+  snek_object_t *slice = snek_array_get(copy, 2);
+  munit_assert_ptr_equal(slice->data.v_slice.parent, copy_y);
+  snek_object_t *vector = snek_array_get(copy, 3);
+  munit_assert_ptr_equal(vector->data.v_vector3.z, copy_y);
+  munit_assert_int(vector->data.v_vector3.x->data.v_int_array.elements[2], ==,
+                   42);
+  munit_assert_ptr_not_equal(vector->data.v_vector3.x, ints);
+
+  vm_collect_garbage(src);
+  vm_collect_garbage(dst);
+  munit_assert_true(vm_verify_heap(src, NULL));
+  munit_assert_true(vm_verify_heap(dst, NULL));
+  munit_assert_int(registry_count(dst->objects), ==, 6);
+
+  vm_free(src);
+  vm_free(dst);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitResult test_reach_check_reads_only(const MunitParameter params[],
+                                               void *user_data)
+{
+  vm_t *src = vm_new();
+  vm_t *dst = vm_new();
+  frame_t *src_frame = vm_new_frame(src);
+  frame_t *dst_frame = vm_new_frame(dst);
+
+  // A collection would compact this slice into an array of its own
+  snek_object_t *parent = new_snek_array(2048, src);
+  frame_reference_object(src_frame, parent);
+  snek_object_t *slice = new_snek_slice(parent, 10, 4, src);
+  frame_reference_object(src_frame, slice);
+  frame_free(vm_frame_pop(src));
+  src_frame = vm_new_frame(src);
+  frame_reference_object(src_frame, slice);
+
+  snek_object_t *moved = vm_transfer(src, dst, new_snek_integer(1, src));
+  munit_assert_ptr_not_null(moved);
+  frame_reference_object(dst_frame, moved);
+  munit_assert_int(slice->kind, ==, SLICE);
+  munit_assert_ptr_equal(slice->data.v_slice.parent, parent);
+
+  vm_free(src);
+  vm_free(dst);
+  munit_assert_true(boot_all_freed());
+  return MUNIT_OK;
+}
+
+static MunitTest vmtransfer_tests[] = {
+    {"/move", test_move, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL},
+    {"/move_detaches_storage", test_move_detaches_storage, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/copy_keeps_cycles", test_copy_keeps_cycles, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {"/reach_check_reads_only", test_reach_check_reads_only, NULL, NULL,
+     MUNIT_TEST_OPTION_NONE, NULL},
+    {NULL, NULL, NULL, NULL, MUNIT_TEST_OPTION_NONE, NULL}};
+
+MunitSuite vmtransfer_suite = {"/vmtransfer", vmtransfer_tests, NULL, 1,
+                               MUNIT_SUITE_OPTION_NONE};
@@ -1,14 +1,36 @@
 #include "../munit/munit.h"
 
-// extern MunitSuite snekobject_suite;
+extern MunitSuite bootmem_suite;
+extern MunitSuite fuzz_suite;
+extern MunitSuite gcstats_suite;
+extern MunitSuite gctrace_suite;
+extern MunitSuite heapsample_suite;
+extern MunitSuite heapsnapshot_suite;
+extern MunitSuite heapverify_suite;
+extern MunitSuite largespace_suite;
+extern MunitSuite registry_suite;
+extern MunitSuite snekobject_suite;
+extern MunitSuite snekpvec_suite;
 extern MunitSuite stack_suite;
 extern MunitSuite vm_suite;
+extern MunitSuite vmtransfer_suite;
 
 int main(int argc, char *argv[])
 {
     int result = 0;
-    // result |= munit_suite_main(&snekobject_suite, NULL, argc, argv);
+    result |= munit_suite_main(&bootmem_suite, NULL, argc, argv);
+    result |= munit_suite_main(&fuzz_suite, NULL, argc, argv);
+    result |= munit_suite_main(&gcstats_suite, NULL, argc, argv);
+    result |= munit_suite_main(&gctrace_suite, NULL, argc, argv);
+    result |= munit_suite_main(&heapsample_suite, NULL, argc, argv);
+    result |= munit_suite_main(&heapsnapshot_suite, NULL, argc, argv);
+    result |= munit_suite_main(&heapverify_suite, NULL, argc, argv);
+    result |= munit_suite_main(&largespace_suite, NULL, argc, argv);
+    result |= munit_suite_main(&registry_suite, NULL, argc, argv);
+    result |= munit_suite_main(&snekobject_suite, NULL, argc, argv);
+    result |= munit_suite_main(&snekpvec_suite, NULL, argc, argv);
     result |= munit_suite_main(&stack_suite, NULL, argc, argv);
     result |= munit_suite_main(&vm_suite, NULL, argc, argv);
+    result |= munit_suite_main(&vmtransfer_suite, NULL, argc, argv);
     return result;
 }
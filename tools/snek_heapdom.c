@@ -0,0 +1,171 @@
+// Reads a heap snapshot written by vm_heap_snapshot and reports what
+// keeps memory alive: per-kind totals and the objects with the largest
+// retained size.
+//
+//   snek_heapdom <snapshot> [top]
+
+#include "../src/heapsnapshot.h"
+#include "../src/snekobject.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define DEFAULT_TOP 20
+#define KIND_COUNT (PVECTOR + 1)
+
+static const char *kind_names[KIND_COUNT] = {
+    "INTEGER",   "FLOAT",       "STRING",        "ARRAY", "VECTOR3",
+    "INT_ARRAY", "FLOAT_ARRAY", "FLOAT_VECTOR3", "SLICE", "PVECTOR",
+};
+
+static const char *kind_name(uint8_t kind) {
+  return kind < KIND_COUNT ? kind_names[kind] : "?";
+}
+
+static double now_s(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Min-heap of node ids on retained size, holds the `top` largest
+static void sift_down(uint32_t *heap, size_t count, size_t i,
+                      const uint64_t *retained) {
+  for (;;) {
+    size_t smallest = i;
+    size_t left = 2 * i + 1;
+    size_t right = left + 1;
+    if (left < count && retained[heap[left]] < retained[heap[smallest]]) {
+      smallest = left;
+    }
+    if (right < count && retained[heap[right]] < retained[heap[smallest]]) {
+      smallest = right;
+    }
+    if (smallest == i) {
+      return;
+    }
+    uint32_t swap = heap[i];
+    heap[i] = heap[smallest];
+    heap[smallest] = swap;
+    i = smallest;
+  }
+}
+
+// qsort has no context argument
+static const uint64_t *sort_retained;
+
+static int compare_retained_desc(const void *a, const void *b) {
+  uint64_t left = sort_retained[*(const uint32_t *)a];
+  uint64_t right = sort_retained[*(const uint32_t *)b];
+  return left < right ? 1 : left > right ? -1 : 0;
+}
+
+static void report(heap_snapshot_t *snapshot, heap_dominators_t *dominators,
+                   size_t top) {
+  uint64_t kind_count[KIND_COUNT + 1] = {0};
+  uint64_t kind_bytes[KIND_COUNT + 1] = {0};
+  uint64_t heap_bytes = 0;
+  uint64_t garbage = 0;
+  uint64_t garbage_bytes = 0;
+  for (uint32_t i = 0; i < snapshot->node_count; i++) {
+    heap_snapshot_node_t *node = &snapshot->nodes[i];
+    size_t kind = node->kind < KIND_COUNT ? node->kind : KIND_COUNT;
+    kind_count[kind]++;
+    kind_bytes[kind] += node->self_size;
+    heap_bytes += node->self_size;
+    if (dominators->idom[i] == HEAP_SNAPSHOT_UNREACHABLE) {
+      garbage++;
+      garbage_bytes += node->self_size;
+    }
+  }
+
+  printf("nodes %u, edges %llu, roots %llu, %llu bytes\n",
+         snapshot->node_count, (unsigned long long)snapshot->edge_count,
+         (unsigned long long)snapshot->root_count,
+         (unsigned long long)heap_bytes);
+  printf("reachable %u, unreachable %llu (%llu bytes)\n\n",
+         dominators->reachable, (unsigned long long)garbage,
+         (unsigned long long)garbage_bytes);
+
+  printf("%-14s %12s %16s\n", "kind", "count", "self bytes");
+  for (size_t kind = 0; kind <= KIND_COUNT; kind++) {
+    if (kind_count[kind] > 0) {
+      printf("%-14s %12llu %16llu\n", kind_name(kind),
+             (unsigned long long)kind_count[kind],
+             (unsigned long long)kind_bytes[kind]);
+    }
+  }
+
+  uint32_t *heap = malloc((top + 1) * sizeof(uint32_t));
+  if (heap == NULL) {
+    return;
+  }
+  size_t count = 0;
+  const uint64_t *retained = dominators->retained;
+  for (uint32_t i = 0; i < snapshot->node_count; i++) {
+    if (dominators->idom[i] == HEAP_SNAPSHOT_UNREACHABLE) {
+      continue;
+    }
+    if (count < top) {
+      heap[count++] = i;
+      if (count == top) {
+        for (size_t j = count / 2 + 1; j-- > 0;) {
+          sift_down(heap, count, j, retained);
+        }
+      }
+    } else if (top > 0 && retained[i] > retained[heap[0]]) {
+      heap[0] = i;
+      sift_down(heap, count, 0, retained);
+    }
+  }
+  sort_retained = retained;
+  qsort(heap, count, sizeof(uint32_t), compare_retained_desc);
+
+  printf("\n%-10s %-14s %14s %16s %10s\n", "node", "kind", "self",
+         "retained", "idom");
+  for (size_t i = 0; i < count; i++) {
+    uint32_t node = heap[i];
+    printf("%-10u %-14s %14llu %16llu ", node,
+           kind_name(snapshot->nodes[node].kind),
+           (unsigned long long)snapshot->nodes[node].self_size,
+           (unsigned long long)retained[node]);
+    if (dominators->idom[node] == HEAP_SNAPSHOT_ROOT) {
+      printf("%10s\n", "root");
+    } else {
+      printf("%10u\n", dominators->idom[node]);
+    }
+  }
+  free(heap);
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 2 || argc > 3) {
+    fprintf(stderr, "usage: %s <snapshot> [top]\n", argv[0]);
+    return 2;
+  }
+  size_t top = argc == 3 ? strtoul(argv[2], NULL, 10) : DEFAULT_TOP;
+
+  double start = now_s();
+  heap_snapshot_t *snapshot = heap_snapshot_load(argv[1]);
+  if (snapshot == NULL) {
+    fprintf(stderr, "%s: not a readable heap snapshot\n", argv[1]);
+    return 1;
+  }
+  double loaded = now_s();
+
+  heap_dominators_t *dominators = heap_snapshot_dominators(snapshot);
+  if (dominators == NULL) {
+    fprintf(stderr, "out of memory computing dominators\n");
+    heap_snapshot_free(snapshot);
+    return 1;
+  }
+  double analyzed = now_s();
+
+  report(snapshot, dominators, top);
+  fprintf(stderr, "\nload %.2fs, dominators %.2fs\n", loaded - start,
+          analyzed - loaded);
+
+  heap_dominators_free(dominators);
+  heap_snapshot_free(snapshot);
+  return 0;
+}